@@ -53,6 +53,31 @@ typedef enum
   LS_LOG_MEMTRACE
 } ls_loglevel;
 
+/**
+ * One call site's share of the log rate limit; see LS_LOG_LIMITED().
+ * Initialize with LS_LOG_LIMIT_INIT and treat as opaque.
+ */
+typedef struct _ls_log_limit
+{
+  /** Where the call site is, for the summary */
+  const char* file;
+  /** Line of the call site */
+  int line;
+  /** Level of the last message, for the summary */
+  ls_loglevel level;
+  /** When the bucket will next be full, in monotonic nanoseconds */
+  uint64_t full;
+  /** Messages dropped since the last one logged or summarized */
+  uint64_t suppressed;
+  /** Whether this site is on its thread's list for ls_log_limit_flush() */
+  bool listed;
+  /** The next site on the list */
+  struct _ls_log_limit* next;
+} ls_log_limit;
+
+/** Initializer for an ls_log_limit at the current source line */
+#define LS_LOG_LIMIT_INIT {__FILE__, __LINE__, LS_LOG_NONE, 0, 0, false, NULL}
+
 /**
  * Signature of the log text generator function passed to ls_log_chunked().  No
  * log message functions should be called from this function to avoid garbled
@@ -92,6 +117,8 @@ ls_log_level_name(ls_loglevel level);
  * Note: Supplied function will be called three times for each log
  * message; once for date/time/level preamble, once for the message and
  * once for a trailing newline.
+ * After ls_log_async_start(), it is called from the writer thread
+ * instead, once for each piece of text and each conversion.
  *
  * \param stream Output stream, always stderr.
  * \param format Format string like vfprintf.
@@ -115,6 +142,49 @@ typedef int (* ls_log_vararg_function)(FILE*       stream,
 LS_API void
 ls_log_set_function(ls_log_vararg_function fn);
 
+/**
+ * Start logging asynchronously.  ls_log() and ls_log_err(), and the macros
+ * built on them, then just copy the level, time, format pointer and
+ * arguments of each message into a ring belonging to the calling thread;
+ * a background thread formats them and writes them with the logging
+ * function.  A thread whose ring is full drops the message rather than
+ * wait, and the writer logs how many were dropped.  ls_log_chunked() is
+ * still synchronous.
+ *
+ * Since the formatting happens later, on another thread:
+ * - fmt must last as long as the process does; a string literal, in
+ *   practice.
+ * - %s arguments are copied, so they may be temporaries.  Nothing else
+ *   pointed to is (e.g. by %p).
+ * - %n, wide characters and positional arguments aren't supported; the
+ *   message stops where one of those is, with "...".
+ * - A message whose arguments and NDC come to more than about 200 bytes is
+ *   cut short, also ending with "...".
+ * - Messages from one thread stay in order, but different threads'
+ *   messages may come out of order.
+ *
+ * Note: Not thread-safe; start before other threads log.
+ *
+ * \param[in]  records Messages each thread can have waiting; rounded up to
+ *                     a power of two.  0 for the default, 256.
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned
+ * \return true: started, or already running.  false: see err.
+ */
+LS_API bool
+ls_log_async_start(size_t  records,
+                   ls_err* err);
+
+/**
+ * Stop logging asynchronously.  Everything already queued is written out
+ * before this returns, and logging goes back to being done on the calling
+ * thread.
+ *
+ * Note: Not thread-safe; no other thread may be logging.
+ */
+LS_API void
+ls_log_async_stop(void);
+
 /**
  * Set the current log level, defaults to LS_LOG_INFO.
  *
@@ -198,6 +268,50 @@ ls_log(ls_loglevel level,
        ...)
 __attribute__ ( ( __format__(__printf__, 2, 3) ) );
 
+/**
+ * Set the rate limit shared by every LS_LOG_LIMITED() call site.  Each site
+ * gets its own bucket of {burst} messages, refilled at {rate} per second.
+ * Defaults to 10 per second with a burst of 10.
+ *
+ * Note: Not thread-safe.
+ *
+ * \invariant burst > 0
+ * \param[in] rate  Messages per second for each call site, or 0 for no limit
+ * \param[in] burst How many messages a quiet call site can save up
+ */
+LS_API void
+ls_log_set_limit(uint32_t rate,
+                 uint32_t burst);
+
+/**
+ * Decide whether a rate-limited call site gets to log now.  If it does, and
+ * messages were suppressed since it last did, a summary saying how many is
+ * logged first.  Messages below the current log level neither log nor count
+ * as suppressed.
+ *
+ * Normally called through LS_LOG_LIMITED(), so that the message's arguments
+ * are only evaluated when it will actually be logged.
+ *
+ * \invariant lim != NULL
+ * \param[in] lim   The call site's limit
+ * \param[in] level The log level for this message
+ * \param[in] now   Monotonic nanoseconds; see ls_time_now_ns()
+ * \return true if the message should be logged
+ */
+LS_API bool
+ls_log_limit_take(ls_log_limit* lim,
+                  ls_loglevel   level,
+                  uint64_t      now);
+
+/**
+ * Log a summary for each of this thread's rate-limited call sites that has
+ * suppressed messages since it last logged, so that a site that goes quiet
+ * doesn't keep its count forever.  Meant to be called every few seconds
+ * from a loop that uses LS_LOG_LIMITED().
+ */
+LS_API void
+ls_log_limit_flush(void);
+
 /**
  * Log an error, with extra information.  If the error is NULL,
  * just use the extra information.
@@ -278,3 +392,38 @@ ls_log_format_timeval(struct timeval* tv,
                                     (what), \
                                     errno, \
                                     strerror(errno) )
+
+/**
+ * ls_log, but limited to a few messages a second from this call site, with
+ * a count of the rest logged when the site is next allowed to, or by
+ * ls_log_limit_flush().  {fmt}'s arguments are not evaluated at all for a
+ * suppressed message.  Each thread keeps its own count for each site.
+ *
+ * @param[in]  now   Monotonic nanoseconds; see ls_time_now_ns()
+ * @param[in]  level The log level for this message
+ * @param[in]  fmt   The printf-style format to log
+ */
+#define LS_LOG_LIMITED(now, level, fmt, ...) \
+  do { \
+    static __thread ls_log_limit _ls_log_site = LS_LOG_LIMIT_INIT; \
+    if ( ls_log_limit_take( &_ls_log_site, (level), (now) ) ) \
+    { \
+      ls_log( (level), fmt, __VA_ARGS__ ); \
+    } \
+  } while (0)
+
+/**
+ * LS_LOG_ERR, rate limited like LS_LOG_LIMITED.
+ *
+ * @param[in]  now     Monotonic nanoseconds; see ls_time_now_ns()
+ * @param[in]  err     The error to log
+ * @param[in]  what    A string describing what failed
+ */
+#define LS_LOG_ERR_LIMITED(now, err, what) \
+  do { \
+    static __thread ls_log_limit _ls_log_site = LS_LOG_LIMIT_INIT; \
+    if ( ls_log_limit_take( &_ls_log_site, LS_LOG_ERROR, (now) ) ) \
+    { \
+      LS_LOG_ERR( (err), (what) ); \
+    } \
+  } while (0)
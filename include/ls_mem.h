@@ -211,6 +211,21 @@ ls_pool_create(size_t    size,
 LS_API void
 ls_pool_destroy(ls_pool* pool);
 
+/**
+ * Release everything allocated from the given pool, but keep its pages so
+ * that later allocations can reuse them without calling ls_data_malloc.
+ * Useful for a pool that is filled and emptied over and over, e.g. once per
+ * received packet.
+ *
+ * Bound ls_pool_cleaner callbacks are invoked, and allocations too big for a
+ * page are freed, just as in ls_pool_destroy.
+ *
+ * \invariant pool != NULL
+ * \param pool The memory pool to reset
+ */
+LS_API void
+ls_pool_reset(ls_pool* pool);
+
 /**
  * Associate a callback to be fired when the given pointer is freed during the
  * given pool's destruction.
@@ -1,13 +1,17 @@
 /**
  * \file
  * \brief
- * Timer state management, allowing for cancellation
+ * Timer state management, allowing for cancellation.  Timers keep time as
+ * a 64-bit count of nanoseconds; the timeval functions are wrappers that
+ * convert to and from that, for compatibility.  The tube manager's timers
+ * count from CLOCK_MONOTONIC (see ls_time_now_ns()).
  *
  * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
  */
 
 #pragma once
 
+#include <stdint.h>
 #include <sys/time.h>
 
 #include "ls_basics.h"
@@ -22,10 +26,67 @@ typedef struct _ls_timer ls_timer;
  */
 typedef void (* ls_timer_func)(ls_timer* tim);
 
+/** Nanoseconds in a microsecond */
+#define LS_NS_PER_US UINT64_C(1000)
+/** Nanoseconds in a millisecond */
+#define LS_NS_PER_MS UINT64_C(1000000)
+/** Nanoseconds in a second */
+#define LS_NS_PER_SEC UINT64_C(1000000000)
+
+/**
+ * Get the current CLOCK_MONOTONIC time, which doesn't jump when the
+ * wall clock is set.
+ *
+ * \param[out] now Nanoseconds since some arbitrary point in the past
+ * \param[out] err The error information (provide NULL to ignore)
+ * \return         true if successful, false otherwise.
+ */
+LS_API bool
+ls_time_now_ns(uint64_t* now,
+               ls_err*   err);
+
+/**
+ * Convert a timeval to nanoseconds.
+ *
+ * \param[in] tv The time to convert
+ * \return       tv in nanoseconds
+ */
+LS_API uint64_t
+ls_time_from_timeval(const struct timeval* tv);
+
+/**
+ * Convert nanoseconds to a timeval, rounding down to the microsecond.
+ *
+ * \param[in]  ns The time to convert
+ * \param[out] tv ns as a timeval
+ */
+LS_API void
+ls_time_to_timeval(uint64_t        ns,
+                   struct timeval* tv);
+
+/**
+ * Create a timer that fires at a given time in nanoseconds.
+ *
+ * \param[in]  when    The time at which to fire the timer; for the tube
+ *                     manager, CLOCK_MONOTONIC time
+ * \param[in]  cb      The function to call at the given time
+ * \param[in]  context A parameter to pass into the callback
+ * \param[out] tim     The created timer
+ * \param[out] err     The error information (provide NULL to ignore)
+ * \return             true if successful, false otherwise.
+ */
+LS_API bool
+ls_timer_create_ns(uint64_t      when,
+                   ls_timer_func cb,
+                   void*         context,
+                   ls_timer**    tim,
+                   ls_err*       err);
+
 /**
- * Create a a timer that fires at a given time.
+ * Create a a timer that fires at a given time.  The same as
+ * ls_timer_create_ns(), with the time as a timeval.
  *
- * \param[in]  actual  The UTC wall-clock time at which to fire a timer
+ * \param[in]  actual  The time at which to fire a timer
  * \param[in]  cb      The function to call at the given time
  * \param[in]  context A parameter to pass into the
  * \param[out] tim     The created timer
@@ -43,7 +104,7 @@ ls_timer_create(const struct timeval* actual,
  * Createa a timer that fires at a given millisecond offset from a given time.
  * Usually the given time is "now", or an approximation thereof.
  *
- * \param[in]  now     The current UTC wall-clock time
+ * \param[in]  now     The current time, in the same clock as the timer
  * \param[in]  ms      The offset from "now" in milliseconds
  * \param[in]  cb      The function to call at the given time
  * \param[in]  context A parameter to pass into the
@@ -60,7 +121,18 @@ ls_timer_create_ms(const struct timeval* now,
                    ls_err*               err);
 
 /**
- * Destroy a timer.  Does *not* fire the callback.
+ * Take another reference to a timer, so that it isn't freed until
+ * ls_timer_destroy() has been called once more.  Safe from any thread.
+ *
+ * \param[in] tim The timer to hold on to
+ */
+LS_API void
+ls_timer_ref(ls_timer* tim);
+
+/**
+ * Destroy a timer.  Does *not* fire the callback.  If ls_timer_ref() has
+ * been called on it, this only drops a reference, and the timer is freed
+ * when the last one goes.
  *
  * \param[in] tim The timer to destroy
  */
@@ -94,11 +166,20 @@ LS_API void*
 ls_timer_get_context(ls_timer* tim);
 
 /**
- * Get the time that the timer is due to fire
+ * Get the time that the timer is due to fire, in nanoseconds.
  *
  * \param[in]  tim The timer to query
- * \return         The UTC wall-clock time the timer is due to fire.  Will be
- *                 NULL if cancelled.
+ * \return         The time the timer is due to fire.  0 if cancelled.
+ */
+LS_API uint64_t
+ls_timer_get_ns(ls_timer* tim);
+
+/**
+ * Get the time that the timer is due to fire, as a timeval.
+ *
+ * \param[in]  tim The timer to query
+ * \return         The time the timer is due to fire, in the clock it was
+ *                 created with.  Will be NULL if cancelled.
  */
 LS_API struct timeval*
 ls_timer_get_time(ls_timer* tim);
@@ -136,6 +217,17 @@ LS_API bool
 ls_timer_greater_tv(ls_timer*       a,
                     struct timeval* b);
 
+/**
+ * Is a > b ?
+ *
+ * \param[in]  a First timer
+ * \param[in]  b Comparison time, in nanoseconds
+ * \return       true if a > b
+ */
+LS_API bool
+ls_timer_greater_ns(ls_timer* a,
+                    uint64_t  b);
+
 /**
  * Execute the timer callback.
  *
@@ -105,6 +105,8 @@ typedef struct _spud_message
   spud_header* header;
   /** CBOR map */
   cn_cbor* cbor;
+  /** where cbor was allocated, or NULL for the heap */
+  cn_cbor_context* ctx;
 } spud_message;
 
 /**
@@ -133,6 +135,26 @@ spud_parse(const uint8_t* payload,
            spud_message*  msg,
            ls_err*        err);
 
+/**
+ * Decode a packet into header and parsed CBOR structure, allocating the CBOR
+ * nodes from the given context instead of the heap.  With a context backed by
+ * a pool that is reset between packets, parsing doesn't allocate at all.
+ * The CBOR nodes point into payload, so it must outlive msg.
+ *
+ * \param[in] payload The received packet
+ * \param[in] length  Bytes in payload
+ * \param[out] msg  Parsed message is placed here
+ * \param[in] ctx  Allocator for the CBOR nodes.  If NULL, the heap is used.
+ * \param[out] err  If non-NULL on input, indicates error when returning false
+ * \return true on success.
+ */
+LS_API bool
+spud_parse_ctx(const uint8_t*   payload,
+               size_t           length,
+               spud_message*    msg,
+               cn_cbor_context* ctx,
+               ls_err*          err);
+
 /**
  * Deallocate memory allocated in parsing.
  *
@@ -165,6 +187,19 @@ LS_API bool
 spud_create_id(spud_tube_id* id,
                ls_err*       err);
 
+/**
+ * Create several new tube IDs at once.
+ *
+ * \param[in] ids  Where to put them
+ * \param[in] count  How many to create
+ * \param[out] err If non-NULL on input, indicates error when returning false
+ * \return true on success.
+ */
+LS_API bool
+spud_create_ids(spud_tube_id* ids,
+                size_t        count,
+                ls_err*       err);
+
 /**
  * Compare tube IDs.
  *
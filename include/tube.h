@@ -38,6 +38,9 @@ typedef enum {
  */
 typedef struct _tube tube;
 
+/* See tube_manager.h */
+struct _tube_manager;
+
 /**
  * Allocate a new tube to be managed by this manager.
  * The new tube has no associated socket or ID and is in state UNKNOWN.
@@ -89,6 +92,31 @@ tube_data(tube*    t,
           size_t   len,
           ls_err*  err);
 
+/**
+ * Send a burst of DATA packets to the tube's peer, one per payload, in
+ * order.  Each is encoded exactly as by tube_data().  Consecutive packets
+ * that come out the same size are handed to the kernel together using UDP
+ * generic segmentation offload where the socket supports it, so a burst of
+ * same-sized payloads costs one system call per
+ * TUBE_MANAGER_MAX_SEGMENTS packets.  Otherwise the packets are sent one
+ * at a time.
+ *
+ * \invariant t != NULL
+ *
+ * \param[in] t  The tube to send on
+ * \param[in] data  The payloads
+ * \param[in] len  The length of each payload
+ * \param[in] num  Number of payloads (and packets)
+ * \param[out] err  If non-NULL on input, points to error when false is returned
+ * \return true: packets successfully sent. false: see err.
+ */
+LS_API bool
+tube_data_burst(tube*     t,
+                uint8_t** data,
+                size_t*   len,
+                size_t    num,
+                ls_err*   err);
+
 /**
  * Create a CBOR map containing the mandatory pdec keys
  */
@@ -118,6 +146,37 @@ tube_send_pdec(tube*    t,
                bool     reflect,
                ls_err*  err);
 
+/**
+ * Send a path declaration with the mandatory keys, "ipaddr", "token" and
+ * "url", on the given tube.  Sent as a DATA packet with the PDEC flag set,
+ * and comes out the same as tube_send_pdec() of the map from
+ * path_mandatory_keys_create().  The keys are encoded ahead of time and the
+ * values are sent from where they are, so nothing is allocated or copied.
+ *
+ * \invariant t != NULL
+ * \invariant ipaddr != NULL
+ * \invariant token != NULL
+ * \invariant url != NULL
+ * \param[in] t  The tube to send on
+ * \param[in] ipaddr  The sender's IPv4 or IPv6 address, in network order
+ * \param[in] iplen  The length of ipaddr, 4 or 16
+ * \param[in] token  Identifies the sending path element
+ * \param[in] tokenlen  The length of token
+ * \param[in] url  Describes the path condition
+ * \param[in] reflect  The value to place in the ADEC flag
+ * \param[out] err  If non-NULL on input, points to error when false is returned
+ * \return true: success.  false: see err.
+ */
+LS_API bool
+tube_send_path_mandatory_keys(tube*          t,
+                              const uint8_t* ipaddr,
+                              size_t         iplen,
+                              const uint8_t* token,
+                              size_t         tokenlen,
+                              const char*    url,
+                              bool           reflect,
+                              ls_err*        err);
+
 /**
  * Close a tube.  Sends an (empty) CLOSE packet and sets tube state to UNKNOWN.
  *
@@ -187,7 +246,7 @@ LS_API void*
 tube_get_data(tube* t);
 
 /**
- * Set the local address of a tube.
+ * Set the local address of a tube.  The address is copied into the tube.
  *
  * \param[in] t The tube whose address is to be set
  * \param[in] info  The local address to set
@@ -257,3 +316,26 @@ tube_set_info(tube*                  t,
               int                    socket,
               const struct sockaddr* peer,
               spud_tube_id*          id);
+
+/**
+ * Set the manager responsible for a tube.  tube_manager_add() does this;
+ * once set, the tube's packets are sent through the manager so that they
+ * can take advantage of its I/O mechanism.
+ *
+ * \invariant t != NULL
+ * \param[in] t   The tube to modify
+ * \param[in] mgr The manager, or NULL to send directly
+ */
+LS_API void
+tube_set_manager(tube*                 t,
+                 struct _tube_manager* mgr);
+
+/**
+ * Get the manager responsible for a tube.
+ *
+ * \invariant t != NULL
+ * \param[in] t The tube
+ * \return The manager, or NULL if the tube is not in one
+ */
+LS_API struct _tube_manager*
+tube_get_manager(tube* t);
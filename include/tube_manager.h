@@ -32,6 +32,11 @@
  * Data arrived
  */
 #define EV_DATA_NAME    "data"
+/**
+ * Several data packets arrived at once; only triggered once turned on with
+ * tube_manager_set_data_batch()
+ */
+#define EV_DATA_BATCH_NAME "databatch"
 /**
  * Tube closed
  */
@@ -60,6 +65,46 @@ typedef enum {
    */
   TP_WILL_RESPOND  = 1 << 1
 } tube_policies;
+
+/**
+ * How a manager waits for its sockets and timers.
+ */
+typedef enum {
+  /**
+   * The best mechanism available on this platform.
+   */
+  TUBE_IO_DEFAULT = 0,
+  /**
+   * select(2).  Portable, but limited to FD_SETSIZE descriptors.
+   */
+  TUBE_IO_SELECT,
+  /**
+   * Edge-triggered epoll(7), with a timerfd for the next timer deadline.
+   * Linux only.
+   */
+  TUBE_IO_EPOLL,
+  /**
+   * io_uring: multishot recvmsg into a provided buffer ring, with sends from
+   * the loop thread batched into one submission per loop iteration.  Linux
+   * only, and checked against the running kernel.
+   */
+  TUBE_IO_URING
+} tube_io_backend;
+
+/**
+ * How a manager keeps track of its timers.
+ */
+typedef enum {
+  /**
+   * A binary heap.  O(log n) to schedule, exact to the microsecond.
+   */
+  TUBE_TIMER_HEAP = 0,
+  /**
+   * A hierarchical timing wheel with millisecond ticks.  O(1) to schedule
+   * and cancel, for managers with many timers that mostly get cancelled.
+   */
+  TUBE_TIMER_WHEEL
+} tube_timer_backend;
 /* *INDENT-ON* */
 
 /**
@@ -82,6 +127,45 @@ typedef ssize_t (* tube_recvmsg_func)(int            socket,
                                       struct msghdr* message,
                                       int            flags);
 
+/**
+ * Batch of messages, as used by recvmmsg(2) and sendmmsg(2).  Only complete
+ * on platforms that have them; elsewhere the library supplies its own
+ * definition.
+ */
+struct mmsghdr;
+
+/**
+ * Type of the function called to receive a batch of messages when the
+ * manager is in batched receive mode.
+ * See tube_manager_set_batch_functions().
+ */
+typedef int (* tube_recvmmsg_func)(int              socket,
+                                   struct mmsghdr*  msgvec,
+                                   unsigned int     vlen,
+                                   int              flags,
+                                   struct timespec* timeout);
+
+/**
+ * Type of the function called to send a batch of messages when the manager
+ * is in batched send mode.
+ * See tube_manager_set_batch_functions().
+ */
+typedef int (* tube_sendmmsg_func)(int             socket,
+                                   struct mmsghdr* msgvec,
+                                   unsigned int    vlen,
+                                   int             flags);
+
+/**
+ * The largest number of datagrams that will be read or sent in a single
+ * batch.
+ */
+#define TUBE_MANAGER_MAX_BATCH 1024
+
+/**
+ * The most datagrams handed to the kernel in a single UDP GSO send.
+ */
+#define TUBE_MANAGER_MAX_SEGMENTS 64
+
 /**
  * Type of the function called when iterating over all tubes under the manager's
  * control.  See tube_manager_foreach.
@@ -95,6 +179,16 @@ typedef int (* tube_walker_func)(void*                       user_data,
                                  const struct _spud_tube_id* tube_id,
                                  struct _tube*               tube);
 
+/**
+ * Type of a function posted to run on the manager's loop thread.  See
+ * tube_manager_post.
+ *
+ * \param mgr The manager whose loop is running the function
+ * \param arg The argument given to tube_manager_post
+ */
+typedef void (* tube_post_func)(tube_manager* mgr,
+                                void*         arg);
+
 /**
  * Type of tube event data; passed to event handler.
  */
@@ -109,12 +203,26 @@ typedef struct _tube_event_data {
   const struct sockaddr* peer;
 } tube_event_data;
 
+/**
+ * Type of event data for EV_DATA_BATCH_NAME: every data packet from one
+ * receive, with the packets for each tube next to each other and in the
+ * order they arrived.  Only valid during the callback.
+ */
+typedef struct _tube_event_batch {
+  /** the tube manager the packets arrived on */
+  struct _tube_manager* tmgr;
+  /** one entry per packet, as for EV_DATA_NAME */
+  tube_event_data* data;
+  /** number of entries in data */
+  size_t count;
+} tube_event_batch;
+
 /**
  * Create a tube manager and initialize: set up dispatcher, event handlers.
  *
  * \invariant m != NULL
- * \param[in] buckets Number of buckets in tube hash table. If 0,
- *    a value appropriate for a server is used.
+ * \param[in] buckets Number of tubes to size the tube table for; it grows
+ *    as needed.  If 0, a value appropriate for a server is used.
  * \param[out] m  Where to put pointer to new tube manager
  * \param[out] err If non-NULL on input, describes error if false is returned
  * \return true: m points to the manager.  false: see err.
@@ -123,6 +231,35 @@ LS_API bool
 tube_manager_create(int            buckets,
                     tube_manager** m,
                     ls_err*        err);
+
+/**
+ * Create a tube manager that uses a specific I/O mechanism.
+ * tube_manager_create() is the same as passing TUBE_IO_DEFAULT.
+ *
+ * \invariant m != NULL
+ * \param[in] buckets Number of tubes to size the tube table for; it grows
+ *    as needed.  If 0, a value appropriate for a server is used.
+ * \param[in] io Which mechanism to wait with.  LS_ERR_NO_IMPL if it is not
+ *    available on this platform.
+ * \param[out] m  Where to put pointer to new tube manager
+ * \param[out] err If non-NULL on input, describes error if false is returned
+ * \return true: m points to the manager.  false: see err.
+ */
+LS_API bool
+tube_manager_create_io(int             buckets,
+                       tube_io_backend io,
+                       tube_manager**  m,
+                       ls_err*         err);
+
+/**
+ * Which I/O mechanism the manager ended up with.  Never TUBE_IO_DEFAULT.
+ *
+ * \invariant mgr != NULL
+ * \param[in] mgr The manager
+ * \return The I/O mechanism in use
+ */
+LS_API tube_io_backend
+tube_manager_get_io_backend(tube_manager* mgr);
 /**
  * Shut down and deallocate a tube manager.  All associated data structures are
  * freed.
@@ -343,6 +480,114 @@ tube_manager_schedule(tube_manager*   mgr,
                       ls_timer**      tim,
                       ls_err*         err);
 
+/**
+ * Choose how the manager keeps track of its timers.  Must be called before
+ * any timers are scheduled, and not from another thread while the loop is
+ * running.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr     The manager
+ * \param[in]  backend The timer queue to use
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned.  LS_ERR_INVALID_STATE if there are timers
+ *                     scheduled already, or the loop is running elsewhere.
+ * \return     true: backend in use.  false: see err.
+ */
+LS_API bool
+tube_manager_set_timer_backend(tube_manager*      mgr,
+                               tube_timer_backend backend,
+                               ls_err*            err);
+
+/**
+ * Schedule a timer that has already been created, for example with
+ * ls_timer_create_ns() against the CLOCK_MONOTONIC time.  The manager takes
+ * over the timer, and lets go of it once it has fired or been cancelled.
+ * From any thread but the loop's, the timer is posted to the loop, and
+ * queued the next time around.
+ *
+ * The timer may fire as soon as it is queued, so a thread other than the
+ * loop's that wants to cancel or move it later must take a reference with
+ * ls_timer_ref() before calling this, and drop it with ls_timer_destroy()
+ * once done with it.
+ *
+ * \invariant mgr != NULL
+ * \invariant tim != NULL
+ * \param[in]  mgr The manager to schedule on
+ * \param[in]  tim The timer to schedule
+ * \param[out] err If non-NULL on input, contains error if false is returned
+ * \return     true: timer scheduled.  false: see err.
+ */
+LS_API bool
+tube_manager_schedule_timer(tube_manager* mgr,
+                            ls_timer*     tim,
+                            ls_err*       err);
+
+/**
+ * Cancel a scheduled timer.  Its callback will not be called, and the
+ * manager will let go of it.  From any thread but the loop's, the cancel is
+ * posted to the loop, and takes effect the next time around, or not at all
+ * if the timer fires first.
+ *
+ * The manager lets go of a timer once it has fired or been cancelled, which
+ * frees it unless someone else holds a reference.  So a caller that might
+ * get to a timer after that, as any thread but the loop's might, should
+ * take a reference with ls_timer_ref() before scheduling it, and drop it
+ * with ls_timer_destroy() once done with it.
+ *
+ * \param[in]  mgr The manager the timer was scheduled on
+ * \param[in]  tim The timer to cancel
+ * \param[out] err If non-NULL on input, contains error if false is returned
+ * \return     true: timer cancelled.  false: see err.
+ */
+LS_API bool
+tube_manager_cancel_timer(tube_manager* mgr,
+                          ls_timer*     tim,
+                          ls_err*       err);
+
+/**
+ * Move a scheduled timer to some number of milliseconds from now, without
+ * freeing and re-creating it.  Cheaper than cancelling and scheduling again.
+ * From any thread but the loop's, the move is posted to the loop, and a
+ * timer that fires first is not reported as an error.  As with
+ * tube_manager_cancel_timer(), the timer must not have been freed when this
+ * is called; hold a reference to it for that.
+ *
+ * \param[in]  mgr The manager the timer was scheduled on
+ * \param[in]  tim The timer to move
+ * \param[in]  ms  The number of milliseconds from now to call back
+ * \param[out] err If non-NULL on input, contains error if false is returned.
+ *                 LS_ERR_INVALID_STATE if the timer has already fired or
+ *                 been cancelled.
+ * \return     true: timer moved.  false: see err.
+ */
+LS_API bool
+tube_manager_reschedule_ms(tube_manager* mgr,
+                           ls_timer*     tim,
+                           unsigned long ms,
+                           ls_err*       err);
+
+/**
+ * Run a function on the manager's loop thread, the next time around the
+ * loop.  Safe to call from any thread, and lock-free: posts go on a queue
+ * that the loop drains once per iteration, in the order they were made.
+ * Only the first post to an idle queue wakes the loop.  Timers scheduled,
+ * cancelled or moved from other threads go through the same queue.  Posts
+ * still queued when the manager is destroyed are dropped without running.
+ *
+ * \invariant mgr != NULL
+ * \invariant cb != NULL
+ * \param[in]  mgr The manager whose loop should run cb
+ * \param[in]  cb  The function to run
+ * \param[in]  arg Passed to cb
+ * \param[out] err If non-NULL on input, contains error if false is returned
+ * \return     true: cb will be run.  false: see err.
+ */
+LS_API bool
+tube_manager_post(tube_manager*  mgr,
+                  tube_post_func cb,
+                  void*          arg,
+                  ls_err*        err);
+
 /**
  * Register a callback to call when a signal is received.  The callback will
  * fire at a safe time in the tube_manager_loop, where it is safe to do
@@ -360,6 +605,67 @@ tube_manager_signal(tube_manager* mgr,
                     sig_t         cb,
                     ls_err*       err);
 
+/**
+ * Send a message on behalf of a tube in mgr.  The same as
+ * tube_manager_sendmsg(), except that when called from the thread running
+ * tube_manager_loop() on a manager that batches sends, the message is copied
+ * and sent with the rest of the batch at the end of the loop iteration.
+ * With io_uring, that happens at the next submission; otherwise, see
+ * tube_manager_set_send_batch_size().
+ *
+ * \param[in]  mgr    The manager the tube belongs to.  If NULL, the message
+ *                    is sent immediately.
+ * \param[in]  sock   The socket to send on
+ * \param[in]  source The local address to send from, or NULL
+ * \param[in]  dest   The address to send to
+ * \param[in]  iov    The pieces of the message
+ * \param[in]  count  The number of items in iov
+ * \param[out] err    If non-NULL on input, contains error if false is
+ *                    returned
+ * \return     true: sent or queued.  false: see err.
+ */
+LS_API bool
+tube_manager_send(tube_manager*    mgr,
+                  int              sock,
+                  ls_pktinfo*      source,
+                  struct sockaddr* dest,
+                  struct iovec*    iov,
+                  size_t           count,
+                  ls_err*          err);
+
+/**
+ * Send a run of datagrams that are all the same size, except that the last
+ * one may be shorter.  Where the kernel supports UDP generic segmentation
+ * offload (UDP_SEGMENT), up to TUBE_MANAGER_MAX_SEGMENTS of them go down in
+ * a single sendmsg and are split up by the kernel or the NIC.  Otherwise,
+ * or if the route turns out not to support it, each datagram is sent with
+ * tube_manager_send().
+ *
+ * \invariant dest != NULL
+ * \invariant buf != NULL
+ * \invariant segment > 0
+ * \param[in]  mgr     The manager the tube belongs to.  If NULL, GSO isn't
+ *                     used.
+ * \param[in]  sock    The socket to send on
+ * \param[in]  source  The local address to send from, or NULL
+ * \param[in]  dest    The address to send to
+ * \param[in]  buf     The datagrams, back to back
+ * \param[in]  len     The total length of buf
+ * \param[in]  segment The length of each datagram
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned
+ * \return     true: sent or queued.  false: see err.
+ */
+LS_API bool
+tube_manager_send_segments(tube_manager*    mgr,
+                           int              sock,
+                           ls_pktinfo*      source,
+                           struct sockaddr* dest,
+                           uint8_t*         buf,
+                           size_t           len,
+                           size_t           segment,
+                           ls_err*          err);
+
 /**
  * Send a UDP message.
  *
@@ -395,6 +701,195 @@ LS_API void
 tube_manager_set_socket_functions(tube_sendmsg_func send,
                                   tube_recvmsg_func recv);
 
+/**
+ * Set the default functions that handle receiving and sending batches of
+ * messages for all managers in batched mode, i.e., this has global effect.
+ * \param recv Function for batch receiving.  If NULL, recvmmsg is used where
+ *             available, otherwise repeated calls to the recvmsg function set
+ *             with tube_manager_set_socket_functions().  Like recvmmsg, it
+ *             should only return fewer than vlen messages when the socket has
+ *             nothing more to read.
+ * \param send Function for batch sending.  If NULL, sendmmsg is used where
+ *             available, otherwise repeated calls to the sendmsg function set
+ *             with tube_manager_set_socket_functions().  Like sendmmsg, it
+ *             returns the number of messages sent, or -1 if the first one
+ *             failed.
+ */
+LS_API void
+tube_manager_set_batch_functions(tube_recvmmsg_func recv,
+                                 tube_sendmmsg_func send);
+
+/**
+ * Set the number of datagrams the manager will try to read each time one of
+ * its sockets becomes readable.  Each of the datagrams in the batch is then
+ * processed as if it had been received on its own.  Allocates one receive
+ * buffer per datagram.  Must not be called while tube_manager_loop is running.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr   The manager to modify
+ * \param[in]  count The batch size.  0 or 1 turn batched receive mode off.
+ *                   Must be no larger than TUBE_MANAGER_MAX_BATCH.
+ * \param[out] err   If non-NULL on input, contains error if false is returned
+ * \return     true: batch size set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_batch_size(tube_manager* mgr,
+                            unsigned int  count,
+                            ls_err*       err);
+
+/**
+ * Turn UDP generic receive offload (UDP_GRO) on or off.  With it on, the
+ * kernel may hand up several datagrams from the same peer as one large
+ * buffer, which the loop splits back into individual SPUD messages and
+ * parses in place.  Receive buffers grow to 64k each (including one per
+ * slot in batched receive mode).  Must not be called while
+ * tube_manager_loop is running.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr    The manager to modify
+ * \param[in]  enable true to turn GRO on
+ * \param[out] err    If non-NULL on input, contains error if false is
+ *                    returned.  LS_ERR_NO_IMPL if the platform doesn't have
+ *                    UDP_GRO or the manager uses TUBE_IO_URING.
+ * \return     true: GRO set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_gro(tube_manager* mgr,
+                     bool          enable,
+                     ls_err*       err);
+
+/**
+ * Deliver data in batches.  With it on, EV_DATA_NAME is no longer
+ * triggered; instead, the data packets from each receive (one recvmmsg
+ * batch, or one datagram split by GRO) are collected and handed to
+ * EV_DATA_BATCH_NAME together at the end of it.  Any other command for a
+ * tube delivers what has been collected so far first, so data is never
+ * reordered with opens and closes.  Callbacks that remove tubes must not
+ * use the later entries for them.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr    The manager to modify
+ * \param[in]  enable true to deliver data in batches
+ * \param[out] err    If non-NULL on input, contains error if false is
+ *                    returned
+ * \return     true: set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_data_batch(tube_manager* mgr,
+                            bool          enable,
+                            ls_err*       err);
+
+/**
+ * Answer OPENs without keeping any state, so that a flood of them from
+ * spoofed addresses can't fill up memory or the tube table.  With it on,
+ * a responder answers an OPEN for an unknown tube with an ACK carrying a
+ * cookie, a keyed MAC over the tube ID, the peer's address and the time.
+ * The tube is only created (triggering EV_ADD_NAME) once the peer echoes
+ * the cookie back in an ACK of its own, within 8 to 16 seconds.  Tubes
+ * opened with tube_manager_open_tube() always echo cookies, whether this
+ * is on or not.  Anything that arrives for the tube before the echo is
+ * dropped.  Turning it on picks a new key.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr    The manager to modify
+ * \param[in]  enable true to validate OPENs with cookies
+ * \param[out] err    If non-NULL on input, contains error if false is
+ *                    returned
+ * \return     true: set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_open_cookies(tube_manager* mgr,
+                              bool          enable,
+                              ls_err*       err);
+
+/**
+ * Counts of packets dropped by the limits set with
+ * tube_manager_set_rate_limits().
+ */
+typedef struct _tube_manager_drops
+{
+  /** over the packets per second limit for their source */
+  uint64_t packets;
+  /** OPENs over the new tubes per second limit for their source */
+  uint64_t opens;
+} tube_manager_drops;
+
+/**
+ * Limit how much work any one source can make the manager do.  Sources are
+ * grouped by prefix, /24 for IPv4 and /64 for IPv6, and each prefix gets
+ * a token bucket that refills at the given rate and holds a second's
+ * worth.  A packet that finds its bucket empty is dropped and counted
+ * before it is parsed, logged or allocated for.  OPENs for unknown tubes
+ * (the ones that would create a tube, or get a cookie with
+ * tube_manager_set_open_cookies()) also have to get past the second
+ * limit.  The buckets are kept in fixed memory, about 64KB per limit, so
+ * prefixes may now and then share one.  Must not be called while
+ * tube_manager_loop is running.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr     The manager to modify
+ * \param[in]  packets Packets per second per prefix, or 0 for no limit
+ * \param[in]  opens   New tubes per second per prefix, or 0 for no limit
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned
+ * \return     true: set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_rate_limits(tube_manager* mgr,
+                             uint32_t      packets,
+                             uint32_t      opens,
+                             ls_err*       err);
+
+/**
+ * Get the number of packets dropped by the rate limits so far.  Safe to
+ * call from any thread.
+ *
+ * \invariant mgr != NULL
+ * \invariant drops != NULL
+ * \param[in]  mgr   The manager
+ * \param[out] drops The counts
+ */
+LS_API void
+tube_manager_get_drops(tube_manager*       mgr,
+                       tube_manager_drops* drops);
+
+/**
+ * Set the number of outgoing datagrams the manager will queue up from
+ * inside tube_manager_loop() before sending them with one call.  The queue
+ * is also sent at the end of each receive batch, after timers fire, before
+ * the loop waits for more input, and when the loop exits.  Sends from other
+ * threads, or outside the loop, are never queued.  Allocates one send
+ * buffer per datagram.  Must not be called while tube_manager_loop is
+ * running.  Has no effect with TUBE_IO_URING, which always batches.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr   The manager to modify
+ * \param[in]  count The queue size.  0 or 1 turn batched send mode off.
+ *                   Must be no larger than TUBE_MANAGER_MAX_BATCH.
+ * \param[out] err   If non-NULL on input, contains error if false is returned
+ * \return     true: queue size set.  false: see err.
+ */
+LS_API bool
+tube_manager_set_send_batch_size(tube_manager* mgr,
+                                 unsigned int  count,
+                                 ls_err*       err);
+
+/**
+ * Send everything in the manager's send queue now.  Only useful from the
+ * thread running tube_manager_loop(), e.g. in a callback that wants its
+ * replies on the wire before doing something slow.  A datagram that fails
+ * to send is dropped, and the rest are still sent.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr The manager
+ * \param[out] err If non-NULL on input, contains the first error if false is
+ *                 returned
+ * \return     true: all sent.  false: see err.
+ */
+LS_API bool
+tube_manager_flush(tube_manager* mgr,
+                   ls_err*       err);
+
 /**
  * Print out information about all of the tubes in the manager at the moment.
  *
@@ -0,0 +1,170 @@
+/**
+ * \file
+ * \brief
+ * SPUDlib facilities for spreading one port across several tube managers,
+ * each running its own loop on its own thread.
+ *
+ * All of the managers in a group bind the same port with SO_REUSEPORT.  A
+ * reuseport BPF program steers each incoming datagram to a shard using the
+ * tube ID in its SPUD header, so every packet of a tube is handled by the
+ * manager that owns it.  Tubes opened through the group (or through one of
+ * its managers) get IDs that steer back to the opening shard.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include "tube_manager.h"
+
+/**
+ * Handle for a group of tube managers
+ */
+typedef struct _tube_manager_group tube_manager_group;
+
+/**
+ * Create a group of tube managers.  Each gets its own tube table and timer
+ * queue.
+ *
+ * \invariant grp != NULL
+ * \param[in]  shards  Number of managers (and threads).  Must be at least 1.
+ * \param[in]  buckets Number of tubes to size each manager's tube table for.
+ *                     If 0, a value appropriate for a server is used.
+ * \param[in]  io      The I/O mechanism for each manager
+ * \param[out] grp     Where to put the new group
+ * \param[out] err     If non-NULL on input, describes error if false is
+ *                     returned
+ * \return     true: grp points to the group.  false: see err.
+ */
+LS_API bool
+tube_manager_group_create(unsigned int         shards,
+                          int                  buckets,
+                          tube_io_backend      io,
+                          tube_manager_group** grp,
+                          ls_err*              err);
+
+/**
+ * Stop the group if it is running, then destroy all of its managers.
+ *
+ * \param[in] grp The group to destroy.  NULL is a no-op.
+ */
+LS_API void
+tube_manager_group_destroy(tube_manager_group* grp);
+
+/**
+ * Create sockets for every manager in the group, all bound to the same
+ * port, and install the steering program.  As with tube_manager_socket(),
+ * a non-zero port makes the managers responders.  Needs SO_REUSEPORT and
+ * SO_ATTACH_REUSEPORT_CBPF for more than one shard; LS_ERR_NO_IMPL
+ * otherwise.
+ *
+ * \invariant grp != NULL
+ * \param[in]  grp  The group
+ * \param[in]  port The port to bind to, or 0 to pick one
+ * \param[out] err  If non-NULL on input, describes error if false is returned
+ * \return     true: sockets created.  false: see err.
+ */
+LS_API bool
+tube_manager_group_socket(tube_manager_group* grp,
+                          int                 port,
+                          ls_err*             err);
+
+/**
+ * The number of managers in the group.
+ *
+ * \invariant grp != NULL
+ * \param[in] grp The group
+ * \return The number of shards
+ */
+LS_API unsigned int
+tube_manager_group_count(tube_manager_group* grp);
+
+/**
+ * Get one of the managers in the group.
+ *
+ * \invariant grp != NULL
+ * \invariant i < tube_manager_group_count(grp)
+ * \param[in] grp The group
+ * \param[in] i   Which shard
+ * \return The manager
+ */
+LS_API tube_manager*
+tube_manager_group_get(tube_manager_group* grp,
+                       unsigned int        i);
+
+/**
+ * Bind a callback to an event on every manager in the group.  The callback
+ * runs on the thread of the shard where the event happened; the tmgr in
+ * the tube_event_data says which one.
+ *
+ * \invariant grp != NULL
+ * \invariant name != NULL
+ * \invariant cb != NULL
+ * \param[in]  grp  The group
+ * \param[in]  name The event name (see EV_*_NAME in tube_manager.h)
+ * \param[in]  cb   The callback
+ * \param[out] err  If non-NULL on input, describes error if false is returned
+ * \return     true: bound everywhere.  false: see err.
+ */
+LS_API bool
+tube_manager_group_bind_event(tube_manager_group*      grp,
+                              const char*              name,
+                              ls_event_notify_callback cb,
+                              ls_err*                  err);
+
+/**
+ * The total number of tubes across all shards.  While the group is
+ * running this is only a snapshot.
+ *
+ * \invariant grp != NULL
+ * \param[in] grp The group
+ * \return The number of tubes
+ */
+LS_API size_t
+tube_manager_group_size(tube_manager_group* grp);
+
+/**
+ * Open a tube on the next shard, in round-robin order.  Only before
+ * tube_manager_group_start(): once the shards are running, each one's
+ * tubes belong to its own thread.  To open a tube on a running group, call
+ * tube_manager_open_tube() from one of its callbacks, or tube_manager_post()
+ * a function that does so to the shard from tube_manager_group_get().
+ *
+ * \invariant grp != NULL
+ * \param[in]  grp  The group
+ * \param[in]  dest The address to open the tube to
+ * \param[out] t    The new tube
+ * \param[out] err  If non-NULL on input, describes error if false is
+ *                  returned.  LS_ERR_INVALID_STATE if the group is running.
+ * \return     true: tube opening.  false: see err.
+ */
+LS_API bool
+tube_manager_group_open_tube(tube_manager_group*    grp,
+                             const struct sockaddr* dest,
+                             tube**                 t,
+                             ls_err*                err);
+
+/**
+ * Start one thread per shard, each running tube_manager_loop().
+ *
+ * \invariant grp != NULL
+ * \param[in]  grp The group
+ * \param[out] err If non-NULL on input, describes error if false is returned
+ * \return     true: all threads started.  false: see err.
+ */
+LS_API bool
+tube_manager_group_start(tube_manager_group* grp,
+                         ls_err*             err);
+
+/**
+ * Stop every shard and wait for its thread to exit.
+ *
+ * \invariant grp != NULL
+ * \param[in]  grp The group
+ * \param[out] err If non-NULL on input, describes error if false is returned,
+ *                 including the error from the first loop that failed
+ * \return     true: all loops exited cleanly.  false: see err.
+ */
+LS_API bool
+tube_manager_group_stop(tube_manager_group* grp,
+                        ls_err*             err);
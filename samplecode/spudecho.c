@@ -161,6 +161,14 @@ main(int    argc,
     return 1;
   }
 
+  /* replies from read_cb and the timers go out in batches */
+  if ( !tube_manager_set_batch_size(mgr, 64, &err) ||
+       !tube_manager_set_send_batch_size(mgr, 64, &err) )
+  {
+    LS_LOG_ERR(err, "tube_manager_set_batch_size");
+    return 1;
+  }
+
   if ( !tube_manager_signal(mgr, SIGUSR1, print_stats, &err) )
   {
     LS_LOG_ERR(err, "tube_manager_signal");
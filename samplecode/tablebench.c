@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ *
+ * tablebench compares tube lookups in ls_htable, set up the way the tube
+ * manager used to, with tube_table.  Usage: tablebench [tubes [lookups]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ls_htable.h"
+#include "ls_log.h"
+#include "tube.h"
+#include "tube_table.h"
+
+#define DEFAULT_TUBES   1000000
+#define DEFAULT_LOOKUPS 10000000
+#define HTABLE_BUCKETS  65521
+
+static unsigned int
+hash_id(const void* id)
+{
+  uint64_t key = *(uint64_t*)id;
+
+  key = (~key) + (key << 18);
+  key = key ^ (key >> 31);
+  key = key * 21;
+  key = key ^ (key >> 11);
+  key = key + (key << 6);
+  key = key ^ (key >> 22);
+  return (unsigned int) key;
+}
+
+static int
+compare_id(const void* key1,
+           const void* key2)
+{
+  uint64_t k1 = *(uint64_t*)key1;
+  uint64_t k2 = *(uint64_t*)key2;
+  if (k1 < k2)
+  {
+    return -1;
+  }
+  return (k1 == k2) ? 0 : 1;
+}
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char* name,
+       double      start,
+       size_t      lookups,
+       size_t      found)
+{
+  printf( "%-14s %8.1f ns/lookup (%zu found)\n",
+          name, (now() - start) * 1e9 / lookups, found );
+}
+
+int
+main(int   argc,
+     char* argv[])
+{
+  size_t        ntubes  = DEFAULT_TUBES;
+  size_t        lookups = DEFAULT_LOOKUPS;
+  tube**        tubes;
+  spud_tube_id* hits;
+  spud_tube_id* misses;
+  spud_tube_id* id;
+  ls_htable*    ht;
+  tube_table*   tt;
+  ls_err        err;
+  size_t        i, found;
+  double        start;
+
+  if (argc > 1)
+  {
+    ntubes = strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2)
+  {
+    lookups = strtoul(argv[2], NULL, 10);
+  }
+  if ( (ntubes == 0) || (lookups == 0) )
+  {
+    fprintf(stderr, "Usage: %s [tubes [lookups]]\n", argv[0]);
+    return 64;
+  }
+
+  tubes  = calloc( ntubes, sizeof(tube*) );
+  hits   = calloc( lookups, sizeof(spud_tube_id) );
+  misses = calloc( lookups, sizeof(spud_tube_id) );
+  if (!tubes || !hits || !misses)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  if ( !ls_htable_create(HTABLE_BUCKETS, hash_id, compare_id, &ht, &err) ||
+       !tube_table_create(0, &tt, &err) )
+  {
+    LS_LOG_ERR(err, "create");
+    return 1;
+  }
+
+  start = now();
+  for (i = 0; i < ntubes; i++)
+  {
+    if ( !tube_create(&tubes[i], &err) ||
+         !spud_create_id(&hits[0], &err) )
+    {
+      LS_LOG_ERR(err, "tube_create");
+      return 1;
+    }
+    tube_set_info(tubes[i], -1, NULL, &hits[0]);
+  }
+  printf( "created %zu tubes in %.2f s\n", ntubes, now() - start );
+
+  start = now();
+  for (i = 0; i < ntubes; i++)
+  {
+    tube_get_id(tubes[i], &id);
+    if ( !ls_htable_put(ht, id, tubes[i], NULL, &err) )
+    {
+      LS_LOG_ERR(err, "ls_htable_put");
+      return 1;
+    }
+  }
+  printf( "%-14s %8.1f ns/insert\n", "ls_htable",
+          (now() - start) * 1e9 / ntubes );
+
+  start = now();
+  for (i = 0; i < ntubes; i++)
+  {
+    tube_get_id(tubes[i], &id);
+    if ( !tube_table_put(tt, id, tubes[i], NULL, &err) )
+    {
+      LS_LOG_ERR(err, "tube_table_put");
+      return 1;
+    }
+  }
+  printf( "%-14s %8.1f ns/insert\n", "tube_table",
+          (now() - start) * 1e9 / ntubes );
+
+  /* Look up copies of the IDs, as the receive path does, in random order */
+  /* so that neither table gets help from the cache. */
+  srandom( (unsigned int)time(NULL) );
+  for (i = 0; i < lookups; i++)
+  {
+    tube_get_id(tubes[random() % ntubes], &id);
+    hits[i] = *id;
+    if ( !spud_create_id(&misses[i], &err) )
+    {
+      LS_LOG_ERR(err, "spud_create_id");
+      return 1;
+    }
+  }
+
+  printf("\nhits:\n");
+  start = now();
+  for (i = 0, found = 0; i < lookups; i++)
+  {
+    found += ls_htable_get(ht, &hits[i]) != NULL;
+  }
+  report("ls_htable", start, lookups, found);
+  start = now();
+  for (i = 0, found = 0; i < lookups; i++)
+  {
+    found += tube_table_get(tt, &hits[i]) != NULL;
+  }
+  report("tube_table", start, lookups, found);
+
+  printf("\nmisses:\n");
+  start = now();
+  for (i = 0, found = 0; i < lookups; i++)
+  {
+    found += ls_htable_get(ht, &misses[i]) != NULL;
+  }
+  report("ls_htable", start, lookups, found);
+  start = now();
+  for (i = 0, found = 0; i < lookups; i++)
+  {
+    found += tube_table_get(tt, &misses[i]) != NULL;
+  }
+  report("tube_table", start, lookups, found);
+
+  ls_htable_destroy(ht);
+  tube_table_destroy(tt);
+  for (i = 0; i < ntubes; i++)
+  {
+    tube_destroy(tubes[i]);
+  }
+  free(tubes);
+  free(hits);
+  free(misses);
+  return 0;
+}
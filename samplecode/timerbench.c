@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ *
+ * timerbench compares timer queues under a mix of schedule, cancel and
+ * expire: the gheap queue with a full re-heapify per cancel, as the tube
+ * manager used to do, ls_timer_heap and ls_timer_wheel.  A fixed number of
+ * timers stays live; each round moves a fake clock on by a millisecond,
+ * expires whatever is due, cancels one random timer, and schedules
+ * replacements for all of them.  Usage: timerbench [timers [rounds]]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ls_log.h"
+#include "ls_timer.h"
+#include "ls_timer_heap.h"
+#include "ls_timer_wheel.h"
+#include "../vendor/gheap/gpriority_queue.h"
+
+#define DEFAULT_TIMERS 100000
+#define DEFAULT_ROUNDS 100000
+/* timers are scheduled up to this far out */
+#define SPAN_MS        10000
+/* re-heapifying is so slow that the gheap queue only runs one round in */
+/* this many */
+#define GHEAP_SHARE    1000
+
+typedef enum
+{
+  Q_GHEAP,
+  Q_HEAP,
+  Q_WHEEL
+} queue_kind;
+
+typedef struct
+{
+  queue_kind              kind;
+  struct gpriority_queue* gq;
+  ls_timer_heap*          heap;
+  ls_timer_wheel*         wheel;
+  /* the live timer in each slot; timer contexts are slot numbers */
+  ls_timer**              live;
+  size_t                  count;
+  uint64_t                now;
+  size_t                  fired;
+} bench;
+
+static const uint64_t origin = 1000 * LS_NS_PER_SEC;
+
+static int
+_timer_less(const void* const context,
+            const void* const a,
+            const void* const b)
+{
+  (void)context;
+  return ls_timer_greater(*(ls_timer**)a, *(ls_timer**)b);
+}
+
+static void
+_timer_move(void* const       dst,
+            const void* const src)
+{
+  *(ls_timer**)dst = *(ls_timer* const*)src;
+}
+
+static void
+_timer_del(void* item)
+{
+  ls_timer_destroy(*(ls_timer**)item);
+}
+
+static const struct gheap_ctx paged_binary_heap_ctx = {
+  .fanout            = 2,
+  .page_chunks       = 512,
+  .item_size         = sizeof(ls_timer*),
+  .less_comparer     = &_timer_less,
+  .less_comparer_ctx = NULL,
+  .item_mover        = &_timer_move,
+};
+
+static void
+timer_cb(ls_timer* tim)
+{
+  (void)tim;
+}
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+die(ls_err*     err,
+    const char* what)
+{
+  LS_LOG_ERR( (*err), what );
+  exit(1);
+}
+
+static void
+schedule(bench* b,
+         size_t slot)
+{
+  ls_timer* tim;
+  ls_err    err;
+
+  if ( !ls_timer_create_ns(b->now + (1 + random() % SPAN_MS) * LS_NS_PER_MS,
+                           timer_cb, (void*)(uintptr_t)slot, &tim, &err) )
+  {
+    die(&err, "ls_timer_create_ns");
+  }
+  b->live[slot] = tim;
+  switch (b->kind)
+  {
+  case Q_GHEAP:
+    if ( !gpriority_queue_push(b->gq, &tim) )
+    {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    break;
+  case Q_HEAP:
+    if ( !ls_timer_heap_push(b->heap, tim, &err) )
+    {
+      die(&err, "ls_timer_heap_push");
+    }
+    break;
+  case Q_WHEEL:
+    ls_timer_wheel_add(b->wheel, tim);
+    break;
+  }
+}
+
+static void
+cancel(bench* b,
+       size_t slot)
+{
+  ls_timer* tim = b->live[slot];
+
+  switch (b->kind)
+  {
+  case Q_GHEAP:
+    /* floats to the top, and is thrown away when it gets there */
+    ls_timer_cancel(tim);
+    gheap_make_heap(b->gq->ctx, b->gq->base, b->gq->size);
+    return;
+  case Q_HEAP:
+    ls_timer_heap_remove(b->heap, tim);
+    break;
+  case Q_WHEEL:
+    ls_timer_wheel_remove(b->wheel, tim);
+    break;
+  }
+  ls_timer_destroy(tim);
+}
+
+/* The next timer due by b->now, or NULL */
+static ls_timer*
+next_due(bench* b)
+{
+  ls_timer** top;
+  ls_timer*  tim;
+
+  switch (b->kind)
+  {
+  case Q_GHEAP:
+    top = (ls_timer**)gpriority_queue_top(b->gq);
+    if ( !top || ls_timer_greater_ns(*top, b->now) )
+    {
+      return NULL;
+    }
+    tim = *top;
+    gheap_pop_heap(b->gq->ctx, b->gq->base, b->gq->size);
+    b->gq->size--;
+    return tim;
+  case Q_HEAP:
+    tim = ls_timer_heap_top(b->heap);
+    if ( !tim || ls_timer_greater_ns(tim, b->now) )
+    {
+      return NULL;
+    }
+    return ls_timer_heap_pop(b->heap);
+  case Q_WHEEL:
+    return ls_timer_wheel_pop_due(b->wheel);
+  }
+  return NULL;
+}
+
+static void
+run(queue_kind  kind,
+    const char* name,
+    size_t      count,
+    size_t      rounds)
+{
+  bench     b = {0};
+  ls_timer* tim;
+  ls_err    err;
+  size_t    i, slot;
+  double    start;
+
+  b.kind  = kind;
+  b.count = count;
+  b.now   = origin;
+  b.live  = calloc( count, sizeof(ls_timer*) );
+  if (!b.live)
+  {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  switch (kind)
+  {
+  case Q_GHEAP:
+    b.gq = gpriority_queue_create(&paged_binary_heap_ctx, _timer_del);
+    if (!b.gq)
+    {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    break;
+  case Q_HEAP:
+    if ( !ls_timer_heap_create(&b.heap, &err) )
+    {
+      die(&err, "ls_timer_heap_create");
+    }
+    break;
+  case Q_WHEEL:
+    if ( !ls_timer_wheel_create(origin, &b.wheel, &err) )
+    {
+      die(&err, "ls_timer_wheel_create");
+    }
+    break;
+  }
+
+  /* same sequence of timeouts and cancels for every queue */
+  srandom(42);
+  for (i = 0; i < count; i++)
+  {
+    schedule(&b, i);
+  }
+
+  start = now();
+  for (i = 0; i < rounds; i++)
+  {
+    b.now += LS_NS_PER_MS;
+    if (kind == Q_WHEEL)
+    {
+      ls_timer_wheel_advance(b.wheel, b.now);
+    }
+    while ( ( tim = next_due(&b) ) != NULL )
+    {
+      if ( !ls_timer_is_cancelled(tim) )
+      {
+        slot = (uintptr_t)ls_timer_get_context(tim);
+        b.fired++;
+        ls_timer_destroy(tim);
+        schedule(&b, slot);
+      }
+      else
+      {
+        ls_timer_destroy(tim);
+      }
+    }
+
+    slot = random() % count;
+    cancel(&b, slot);
+    schedule(&b, slot);
+  }
+  printf( "%-14s %10.1f ns/round (%zu rounds, %zu fired)\n",
+          name, (now() - start) * 1e9 / rounds, rounds, b.fired );
+
+  if (b.gq)
+  {
+    gpriority_queue_delete(b.gq);
+  }
+  ls_timer_heap_destroy(b.heap);
+  ls_timer_wheel_destroy(b.wheel);
+  free(b.live);
+}
+
+int
+main(int   argc,
+     char* argv[])
+{
+  size_t count  = DEFAULT_TIMERS;
+  size_t rounds = DEFAULT_ROUNDS;
+
+  if (argc > 1)
+  {
+    count = strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2)
+  {
+    rounds = strtoul(argv[2], NULL, 10);
+  }
+  if ( (count == 0) || (rounds == 0) )
+  {
+    fprintf(stderr, "Usage: %s [timers [rounds]]\n", argv[0]);
+    return 64;
+  }
+
+  printf("%zu live timers, up to %d ms out:\n", count, SPAN_MS);
+  run(Q_GHEAP, "gheap", count,
+      rounds > GHEAP_SHARE ? rounds / GHEAP_SHARE : 1);
+  run(Q_HEAP,  "ls_timer_heap",  count, rounds);
+  run(Q_WHEEL, "ls_timer_wheel", count, rounds);
+  return 0;
+}
@@ -15,18 +15,14 @@
 static const int    DISPATCH_BUCKETS = 7;
 static const size_t MOMENT_POOLSIZE  = 0;
 
-/**
- * Event triggering data.
- */
-typedef struct _ls_event_trigger_t
-{
-  ls_event_moment_t* moment;
-  ls_pool*           pool;
-} ls_event_trigger_t;
-
 
 #define PUSH_EVENTING_NDC _ndcDepth = _push_eventing_ndc(dispatch, __func__)
 #define POP_EVENTING_NDC if (_ndcDepth > 0) {ls_log_pop_ndc(_ndcDepth); }
+/* Triggers happen once per packet, and pushing an NDC allocates; only */
+/* pay for it when there's debug output for it to prefix. */
+#define PUSH_TRIGGER_NDC \
+  _ndcDepth = (ls_log_get_level() >= LS_LOG_DEBUG) ? \
+              _push_eventing_ndc(dispatch, __func__) : 0
 static int
 _push_eventing_ndc(ls_event_dispatcher* dispatch,
                    const char*          entrypoint)
@@ -39,150 +35,237 @@ _push_eventing_ndc(ls_event_dispatcher* dispatch,
 
 /* Internal Functions */
 /**
- * Searched the notifier for an existing binding of the given callback.
- * This function updates {pmatch} and {pins} as appropriate, including
- * setting values to NULL if there is no match.
+ * Searches the notifier for an existing binding of the given callback.
  *
- * returns whether the binding was found
+ * returns the binding's index, or the number of bindings if not found
  */
-static inline bool
-_remove_binding(ls_event_notifier_t*     notifier,
-                ls_event_notify_callback cb,
-                ls_event_binding_t**     pmatch,
-                ls_event_binding_t**     pins)
+static inline size_t
+_find_binding(ls_event_notifier_t*     notifier,
+              ls_event_notify_callback cb)
 {
-  ls_event_binding_t* curr = notifier->bindings;
-  ls_event_binding_t* prev = NULL;
-  bool                head = true;
+  ls_event_bindings_t* bindings = notifier->bindings;
+  size_t               i;
 
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  /* initialize to not found */
-  *pmatch = NULL;
-  while (curr != NULL)
+  if (!bindings)
+  {
+    return 0;
+  }
+  for (i = 0; i < bindings->count; i++)
   {
-    if (curr->cb == cb)
+    if (bindings->entries[i].cb == cb)
     {
-      /* callback matches; remove from list */
-      if (head)
-      {
-        notifier->bindings = curr->next;
-      }
-      else
-      {
-        prev->next = curr->next;
-      }
-
-      /* remember found binding */
-      *pmatch = curr;
-
-      /* finish breaking the list */
-      curr->next = NULL;
-
       break;
     }
+  }
+  return i;
+}
 
-    head = false;
-    prev = curr;
-    curr = curr->next;
+static inline void
+_release_bindings(ls_event_bindings_t* bindings)
+{
+  if ( bindings && (--bindings->refs == 0) )
+  {
+    ls_data_free(bindings);
   }
+}
+
+/**
+ * Copies the notifier's bindings into a new array with room for {extra}
+ * more, which the caller fills in.  The copy replaces the notifier's
+ * bindings; a running trigger keeps the old ones alive until it finishes.
+ */
+static bool
+_copy_bindings(ls_event_notifier_t* notifier,
+               size_t               extra,
+               ls_err*              err)
+{
+  ls_event_bindings_t* old   = notifier->bindings;
+  size_t               count = old ? old->count : 0;
+  ls_event_bindings_t* ret;
 
-  /* update insert point */
-  if (pins)
+  ret = ls_data_malloc( sizeof(ls_event_bindings_t) +
+                        (count + extra) * sizeof(ls_event_binding_t) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  ret->refs  = 1;
+  ret->count = count + extra;
+  if (count)
   {
-    *pins = prev;
+    memcpy( ret->entries, old->entries, count * sizeof(ls_event_binding_t) );
   }
 
-  return (*pmatch != NULL);
+  _release_bindings(old);
+  notifier->bindings = ret;
+  return true;
+}
+
+/**
+ * Removes the binding at index {i}.  Only done when no trigger is walking
+ * the bindings, so they can be changed in place.
+ */
+static inline void
+_remove_binding(ls_event_notifier_t* notifier,
+                size_t               i)
+{
+  ls_event_bindings_t* bindings = notifier->bindings;
+
+  assert(bindings->refs == 1);
+  assert(i < bindings->count);
+
+  bindings->count--;
+  if (bindings->count == 0)
+  {
+    ls_data_free(bindings);
+    notifier->bindings = NULL;
+    return;
+  }
+  memmove( &bindings->entries[i], &bindings->entries[i + 1],
+           (bindings->count - i) * sizeof(ls_event_binding_t) );
 }
 
 static inline void
 _process_pending_unbinds(ls_event* event)
 {
-  ls_event_binding_t* prev = NULL;
-  ls_event_binding_t* cur  = event->bindings;
+  size_t i = 0;
 
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  while (cur != NULL)
+  while ( event->bindings && (i < event->bindings->count) )
   {
-    ls_event_binding_t* remove = cur;
-    if (!cur->unbound)
+    if (event->bindings->entries[i].unbound)
     {
-      prev   = cur;
-      remove = NULL;
+      _remove_binding(event, i);
     }
     else
     {
-      if (prev != NULL)
-      {
-        prev->next = cur->next;
-      }
-      else
-      {
-        event->bindings = cur->next;
-      }
+      i++;
     }
+  }
+}
+
+static void
+_moment_destroy(ls_event_moment_t* moment)
+{
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-    cur = cur->next;
+  assert(moment);
 
-    ls_data_free(remove);
-  }
+  ls_pool_destroy(moment->pool);
+  ls_data_free(moment);
 }
 
-static inline void
-_set_bind_status(ls_event* event)
+/* Take a moment off the dispatcher's free list, or allocate one if it is */
+/* empty. */
+static bool
+_moment_get(ls_event_dispatcher* dispatch,
+            ls_event_moment_t**  moment,
+            ls_err*              err)
 {
-  ls_event_binding_t* cur = event->bindings;
+  ls_event_moment_t* ret = dispatch->free_moments;
+
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  while (cur != NULL)
+  if (ret)
   {
-    cur->normal_bound = true;
-    cur               = cur->next;
+    dispatch->free_moments = ret->next;
+    ret->next              = NULL;
+    *moment                = ret;
+    return true;
   }
+
+  ret = ls_data_calloc( 1, sizeof(ls_event_moment_t) );
+  if (!ret)
+  {
+    ls_log(LS_LOG_WARN, "unable to allocate moment");
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  if ( !ls_pool_create(MOMENT_POOLSIZE, &ret->pool, err) )
+  {
+    ls_log(LS_LOG_WARN, "unable to allocate pool with block size %zd",
+           MOMENT_POOLSIZE);
+    ls_data_free(ret);
+    return false;
+  }
+  ret->dispatch = dispatch;
+  *moment       = ret;
+  return true;
 }
 
+/* Give a finished (or never used) moment back to its dispatcher's free list */
 static void
-_moment_destroy(ls_event_moment_t* moment)
+_moment_put(ls_event_moment_t* moment)
 {
-  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+  ls_event_dispatcher* dispatch = moment->dispatch;
 
-  assert(moment);
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  ls_pool_destroy(moment->evt.pool);
+  ls_pool_reset(moment->pool);
+  moment->next           = dispatch->free_moments;
+  dispatch->free_moments = moment;
 }
 
 static void
-_handle_trigger_int(ls_event_dispatcher* dispatch)
+_moment_setup(ls_event_dispatcher*     dispatch,
+              ls_event_moment_t*       moment,
+              ls_event*                event,
+              void*                    data,
+              ls_event_result_callback result_cb,
+              void*                    result_arg,
+              ls_pool*                 pool)
 {
-  ls_event_moment_t* moment = dispatch->next_moment;
-  ls_event_data*     evt;
-  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+  ls_event_data* evt;
 
-  assert(moment);
-  evt = &moment->evt;
+  ls_log(LS_LOG_DEBUG, "triggering event '%s'", event->name);
+
+  /* setup the event moment */
+  moment->result_cb  = result_cb;
+  moment->result_arg = result_arg;
+  moment->next       = NULL;
+
+  /* setup event data */
+  evt           = &moment->evt;
+  evt->source   = dispatch->source;
+  evt->name     = event->name;
+  evt->notifier = event;
+  evt->data     = data;
+  evt->selected = NULL;
+  evt->pool     = pool;
+  evt->handled  = false;
+}
+
+/* Run the callbacks for one moment */
+static void
+_run_moment(ls_event_dispatcher* dispatch,
+            ls_event_moment_t*   moment)
+{
+  ls_event_data*       evt      = &moment->evt;
+  ls_event_bindings_t* bindings = evt->notifier->bindings;
 
   ls_log(LS_LOG_DEBUG, "processing event '%s'", evt->name);
 
   assert(NULL == dispatch->running);
   dispatch->running = evt->notifier;
-  _set_bind_status(evt->notifier);
 
-  /* process callbacks */
-  for (ls_event_binding_t* binding = moment->bindings;
-       NULL != binding;
-       binding = binding->next)
+  /* process callbacks, as they were bound when the event started running */
+  if (bindings)
   {
-    if (binding->normal_bound)
+    bindings->refs++;
+    for (size_t i = 0; i < bindings->count; i++)
     {
       bool handled = evt->handled;
 
-      binding->cb(evt, binding->arg);
+      bindings->entries[i].cb(evt, bindings->entries[i].arg);
 
       /* prevent callbacks from "unhandling" */
       evt->handled = handled || evt->handled;
     }
+    _release_bindings(bindings);
   }
 
   /* report event results */
@@ -191,16 +274,44 @@ _handle_trigger_int(ls_event_dispatcher* dispatch)
     moment->result_cb(evt, evt->handled, moment->result_arg);
   }
 
-  /* clean up and prepare for next moment */
   _process_pending_unbinds(evt->notifier);
+  dispatch->running = NULL;
+}
+
+static void
+_handle_trigger_int(ls_event_dispatcher* dispatch)
+{
+  ls_event_moment_t* moment = dispatch->next_moment;
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+
+  assert(moment);
+  _run_moment(dispatch, moment);
+
+  /* clean up and prepare for next moment */
   dispatch->next_moment = moment->next;
-  _moment_destroy(moment);
+  _moment_put(moment);
 
   if (NULL == dispatch->next_moment)
   {
     dispatch->moment_queue_tail = NULL;
   }
-  dispatch->running = NULL;
+}
+
+/* Run everything queued, then finish a destroy that was deferred while */
+/* callbacks were running. */
+static void
+_drain_triggers(ls_event_dispatcher* dispatcher)
+{
+  /* handle queued triggers synchronously */
+  while (NULL != dispatcher->next_moment && !dispatcher->destroy_pending)
+  {
+    _handle_trigger_int(dispatcher);
+  }
+
+  if (dispatcher->destroy_pending)
+  {
+    ls_event_dispatcher_destroy(dispatcher);
+  }
 }
 
 /**
@@ -231,16 +342,35 @@ _dispatch_trigger(ls_event_dispatcher* dispatcher,
     return;
   }
 
-  /* handle queued triggers synchronously */
-  while (NULL != dispatcher->next_moment && !dispatcher->destroy_pending)
-  {
-    _handle_trigger_int(dispatcher);
-  }
+  _drain_triggers(dispatcher);
+}
 
-  if (dispatcher->destroy_pending)
-  {
-    ls_event_dispatcher_destroy(dispatcher);
-  }
+/**
+ * The common case: nothing is running or queued, so the callbacks can run
+ * right now from a moment on the stack, with no allocation at all.
+ */
+static void
+_trigger_sync(ls_event_dispatcher*     dispatch,
+              ls_event*                event,
+              void*                    data,
+              ls_event_result_callback result_cb,
+              void*                    result_arg)
+{
+  ls_event_moment_t moment;
+
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+
+  assert(NULL == dispatch->running);
+  assert(NULL == dispatch->next_moment);
+
+  _moment_setup(dispatch, &moment, event, data,
+                result_cb, result_arg, dispatch->sync_pool);
+  _run_moment(dispatch, &moment);
+  ls_pool_reset(dispatch->sync_pool);
+
+  /* anything the callbacks triggered was queued behind this one */
+  /* do not use the dispatcher after this line as it may have been destroyed */
+  _drain_triggers(dispatch);
 }
 
 static void
@@ -249,8 +379,7 @@ _clean_event(bool  replace,
              void* key,
              void* data)
 {
-  ls_event*           event = data;
-  ls_event_binding_t* curr  = event->bindings;
+  ls_event* event = data;
 
   UNUSED_PARAM(key);
   UNUSED_PARAM(delete_key);
@@ -263,111 +392,28 @@ _clean_event(bool  replace,
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
   /* Clean up callbacks */
-  while (curr != NULL)
-  {
-    ls_event_binding_t* remove = curr;
-    curr = curr->next;
-    ls_data_free(remove);
-    remove = NULL;
-  }
+  _release_bindings(event->bindings);
 
   ls_data_free( (char*)ls_event_get_name(event) );
   ls_data_free( event);
 }
 
-static bool
-_prepare_trigger(ls_event_dispatcher*    dispatch,
-                 ls_event_trigger_data** trigger_data,
-                 ls_err*                 err)
-{
-
-  union
-  {
-    ls_event_trigger_data* tdata;
-    void*                  tdataPtr;
-  } tdataUnion;
-
-  ls_pool* pool;
-
-  union
-  {
-    ls_event_moment_t* moment;
-    void*              momentPtr;
-  } momentUnion;
-  UNUSED_PARAM(dispatch);
-
-  LS_LOG_TRACE_FUNCTION_NO_ARGS;
-  assert(trigger_data);
-
-  if ( !ls_pool_create(MOMENT_POOLSIZE, &pool, err) )
-  {
-    ls_log(LS_LOG_WARN, "unable to allocate pool with block size %zd",
-           MOMENT_POOLSIZE);
-    return false;
-  }
-
-  if ( !ls_pool_calloc(pool,
-                       1,
-                       sizeof(struct _ls_event_moment_t),
-                       &momentUnion.momentPtr,
-                       err) )
-  {
-    ls_log(LS_LOG_WARN, "unable to allocate moment");
-    ls_pool_destroy(pool);
-    return false;
-  }
-
-  if ( !ls_pool_malloc(pool,
-                       sizeof(ls_event_trigger_t), &tdataUnion.tdataPtr, err) )
-  {
-    ls_log(LS_LOG_WARN, "unable to allocate event trigger data");
-    ls_pool_destroy(pool);
-    return false;
-  }
-
-  tdataUnion.tdata->pool   = pool;
-  tdataUnion.tdata->moment = momentUnion.moment;
-  *trigger_data            = tdataUnion.tdata;
-
-  return true;
-}
-
 static void
 _trigger_prepared(ls_event_dispatcher*     dispatch,
                   ls_event*                event,
                   void*                    data,
                   ls_event_result_callback result_cb,
                   void*                    result_arg,
-                  ls_event_trigger_data*   trigger_data)
+                  ls_event_moment_t*       moment)
 {
-  ls_event_data*     evt;
-  ls_event_moment_t* moment;
-
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
   assert(event);
-  assert(trigger_data);
-  assert(trigger_data->pool);
-  assert(trigger_data->moment);
-
-  ls_log(LS_LOG_DEBUG, "triggering event '%s'", event->name);
-
-  moment = trigger_data->moment;
-
-  /* setup the event moment */
-  moment->result_cb  = result_cb;
-  moment->result_arg = result_arg;
-  moment->bindings   = event->bindings;
+  assert(moment);
+  assert(moment->dispatch == dispatch);
 
-  /* setup event data */
-  evt           = &moment->evt;
-  evt->source   = dispatch->source;
-  evt->name     = event->name;
-  evt->notifier = event;
-  evt->data     = data;
-  evt->selected = NULL;
-  evt->pool     = trigger_data->pool;
-  evt->handled  = false;
+  _moment_setup(dispatch, moment, event, data,
+                result_cb, result_arg, moment->pool);
 
   /* enqueue, and maybe run */
   /* do not use the dispatcher after this line as it may have been destroyed */
@@ -382,6 +428,7 @@ ls_event_dispatcher_create(void*                 source,
                            ls_err*               err)
 {
   ls_htable*           events   = NULL;
+  ls_pool*             pool     = NULL;
   ls_event_dispatch_t* dispatch = NULL;
   int                  _ndcDepth;
 
@@ -399,10 +446,17 @@ ls_event_dispatcher_create(void*                 source,
     return false;
   }
 
+  if ( !ls_pool_create(MOMENT_POOLSIZE, &pool, err) )
+  {
+    ls_htable_destroy(events);
+    return false;
+  }
+
   dispatch = ls_data_calloc( 1, sizeof(ls_event_dispatch_t) );
   if (dispatch == NULL)
   {
     LS_ERROR(err, LS_ERR_NO_MEMORY);
+    ls_pool_destroy(pool);
     ls_htable_destroy(events);
     return false;
   }
@@ -411,15 +465,17 @@ ls_event_dispatcher_create(void*                 source,
   if (_ndcDepth == 0)
   {
     LS_ERROR(err, LS_ERR_NO_MEMORY);
+    ls_pool_destroy(pool);
     ls_htable_destroy(events);
     ls_data_free(dispatch);
     return false;
   }
   ls_log(LS_LOG_TRACE, "creating new event dispatcher");
 
-  dispatch->source = source;
-  dispatch->events = events;
-  *outdispatch     = dispatch;
+  dispatch->source    = source;
+  dispatch->events    = events;
+  dispatch->sync_pool = pool;
+  *outdispatch        = dispatch;
 
   POP_EVENTING_NDC;
 
@@ -454,8 +510,17 @@ ls_event_dispatcher_destroy(ls_event_dispatcher* dispatch)
     _moment_destroy(moment);
     moment = next_moment;
   }
+  moment = dispatch->free_moments;
+  while (moment)
+  {
+    ls_event_moment_t* next_moment = moment->next;
+    _moment_destroy(moment);
+    moment = next_moment;
+  }
 
+  ls_pool_destroy(dispatch->sync_pool);
   ls_htable_destroy(dispatch->events);
+  ls_data_free(dispatch->by_id);
   ls_data_free(dispatch);
 
   POP_EVENTING_NDC;
@@ -487,6 +552,7 @@ ls_event_dispatcher_create_event(ls_event_dispatcher* dispatch,
 {
   ls_event_notifier_t* notifier = NULL;
   char*                evt_name = NULL;
+  ls_event**           by_id;
   bool                 retval   = true;
   int                  _ndcDepth;
   size_t               nameLen;
@@ -510,6 +576,18 @@ ls_event_dispatcher_create_event(ls_event_dispatcher* dispatch,
     goto ls_event_dispatcher_create_event_done_label;
   }
 
+  /* growing this first means there's nothing to undo if it fails; an */
+  /* unused slot is harmless */
+  by_id = ls_data_realloc( dispatch->by_id,
+                           (dispatch->event_count + 1) * sizeof(ls_event*) );
+  if (by_id == NULL)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    retval = false;
+    goto ls_event_dispatcher_create_event_done_label;
+  }
+  dispatch->by_id = by_id;
+
   nameLen  = ls_strlen(name);
   evt_name = (char*)ls_data_malloc(nameLen + 1);
   if (evt_name == NULL)
@@ -531,6 +609,7 @@ ls_event_dispatcher_create_event(ls_event_dispatcher* dispatch,
   notifier->dispatcher = dispatch;
   notifier->source     = dispatch->source;
   notifier->name       = evt_name;
+  notifier->id         = dispatch->event_count;
 
   if ( !ls_htable_put(dispatch->events,
                       evt_name,
@@ -543,6 +622,7 @@ ls_event_dispatcher_create_event(ls_event_dispatcher* dispatch,
   }
   evt_name = NULL;
 
+  dispatch->by_id[dispatch->event_count++] = notifier;
   if (event)
   {
     *event = notifier;
@@ -586,6 +666,27 @@ ls_event_get_source(ls_event* event)
   return event->source;
 }
 
+LS_API size_t
+ls_event_get_id(ls_event* event)
+{
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+
+  assert(event);
+
+  return event->id;
+}
+
+LS_API ls_event*
+ls_event_dispatcher_get_event_by_id(ls_event_dispatcher* dispatch,
+                                    size_t               id)
+{
+  LS_LOG_TRACE_FUNCTION_NO_ARGS;
+
+  assert(dispatch);
+
+  return (id < dispatch->event_count) ? dispatch->by_id[id] : NULL;
+}
+
 LS_API bool
 ls_event_bind(ls_event*                event,
               ls_event_notify_callback cb,
@@ -593,8 +694,8 @@ ls_event_bind(ls_event*                event,
               ls_err*                  err)
 {
   ls_event_dispatcher* dispatch;
-  ls_event_binding_t*  binding = NULL;
-  ls_event_binding_t*  prev    = NULL;
+  ls_event_binding_t*  binding;
+  size_t               i;
   int                  _ndcDepth;
 
   assert(event);
@@ -605,55 +706,31 @@ ls_event_bind(ls_event*                event,
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
   /* look for existing binding first */
-  if ( !_remove_binding(event, cb, &binding, &prev) )
+  i = _find_binding(event, cb);
+  if ( !event->bindings || (i == event->bindings->count) )
   {
-    /* no match found; allocate a new one */
-    binding = ls_data_calloc( 1, sizeof(ls_event_binding_t) );
-    if (binding == NULL)
+    /* no match found; append a new one */
+    if ( !_copy_bindings(event, 1, err) )
     {
-      LS_ERROR(err, LS_ERR_NO_MEMORY);
       POP_EVENTING_NDC;
       return false;
     }
   }
-  else
-  {
-    /* Keep previous binding status so that we know whether it is
-     * bound before the current event or within the current event
-     */
-    bool normal_bound = binding->normal_bound;
-    memset( binding, 0, sizeof(ls_event_binding_t) );
-    binding->normal_bound = normal_bound;
-  }
-
-  /* update binding properties */
-  binding->cb  = cb;
-  binding->arg = arg;
-
-  /* (re-)insert into list */
-  if (event->bindings == NULL)
-  {
-    /* first binding; place on the front */
-    event->bindings = binding;
-  }
-  else if (prev != NULL)
+  else if (event->bindings->refs > 1)
   {
-    /* append the binding to the end */
-    if (prev->next == NULL)
-    {
-      prev->next = binding;
-    }
-    else
+    /* a running trigger is walking these; leave them alone */
+    if ( !_copy_bindings(event, 0, err) )
     {
-      binding->next = prev->next;
-      prev->next    = binding;
+      POP_EVENTING_NDC;
+      return false;
     }
   }
-  else   /* prev == NULL */
-  {
-    binding->next   = event->bindings;
-    event->bindings = binding;
-  }
+
+  /* update binding properties, keeping its position */
+  binding          = &event->bindings->entries[i];
+  binding->cb      = cb;
+  binding->arg     = arg;
+  binding->unbound = false;
 
   POP_EVENTING_NDC;
   return true;
@@ -664,6 +741,7 @@ ls_event_unbind(ls_event*                event,
                 ls_event_notify_callback cb)
 {
   ls_event_dispatcher* dispatch;
+  size_t               i;
   int                  _ndcDepth;
 
   assert(event);
@@ -674,34 +752,19 @@ ls_event_unbind(ls_event*                event,
   PUSH_EVENTING_NDC;
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  /* If we're currently running the event we're requesting the unbind from
-   * we need to defer the operation until the event has finished its
-   * trigger
-   */
-  if (event != event->dispatcher->running)
+  i = _find_binding(event, cb);
+  if ( event->bindings && (i < event->bindings->count) )
   {
-    ls_event_binding_t* binding;
-    if ( _remove_binding(event, cb, &binding, NULL) )
+    /* If we're currently running the event we're requesting the unbind */
+    /* from we need to defer the operation until the event has finished */
+    /* its trigger.  Marking it doesn't change what the trigger runs. */
+    if (event == event->dispatcher->running)
     {
-      /* match found; lists already updated */
-      ls_data_free(binding);
-      binding = NULL;
+      event->bindings->entries[i].unbound = true;
     }
-  }
-  else
-  {
-    /* we are guaranteed to find the event (even if it is already unbound) */
-    ls_event_binding_t* cur = event->bindings;
-    while (true)
+    else
     {
-      if (cur->cb == cb)
-      {
-        cur->unbound = true;
-        break;
-      }
-
-      cur = cur->next;
-      assert(cur);
+      _remove_binding(event, i);
     }
   }
 
@@ -719,7 +782,7 @@ ls_event_prepare_trigger(ls_event_dispatcher*    dispatch,
   PUSH_EVENTING_NDC;
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  ret = _prepare_trigger(dispatch, trigger_data, err);
+  ret = _moment_get(dispatch, trigger_data, err);
 
   POP_EVENTING_NDC;
   return ret;
@@ -728,20 +791,18 @@ ls_event_prepare_trigger(ls_event_dispatcher*    dispatch,
 LS_API void
 ls_event_unprepare_trigger(ls_event_trigger_data* trigger_data)
 {
-  ls_event*            evt;
   ls_event_dispatcher* dispatch;
   int                  _ndcDepth;
 
   assert(trigger_data);
-  assert(trigger_data->moment);
 
-  evt      = trigger_data->moment->evt.notifier;
-  dispatch = evt ? evt->dispatcher : NULL;
+  dispatch = trigger_data->dispatch;
 
   PUSH_EVENTING_NDC;
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  ls_pool_destroy(trigger_data->pool);
+  /* rare enough that it isn't worth keeping */
+  _moment_destroy(trigger_data);
 
   POP_EVENTING_NDC;
 }
@@ -760,7 +821,7 @@ ls_event_trigger_prepared(ls_event*                event,
 
   dispatch = event->dispatcher;
 
-  PUSH_EVENTING_NDC;
+  PUSH_TRIGGER_NDC;
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
   _trigger_prepared(dispatch, event, data,
@@ -776,24 +837,31 @@ ls_event_trigger(ls_event*                event,
                  void*                    result_arg,
                  ls_err*                  err)
 {
-  ls_event_dispatcher*   dispatch;
-  ls_event_trigger_data* trigger_data;
-  int                    _ndcDepth;
+  ls_event_dispatcher* dispatch;
+  ls_event_moment_t*   moment;
+  int                  _ndcDepth;
 
   assert(event);
   dispatch = event->dispatcher;
 
-  PUSH_EVENTING_NDC;
+  PUSH_TRIGGER_NDC;
   LS_LOG_TRACE_FUNCTION_NO_ARGS;
 
-  if ( !_prepare_trigger(dispatch, &trigger_data, err) )
+  if ( (NULL == dispatch->running) && (NULL == dispatch->next_moment) )
+  {
+    _trigger_sync(dispatch, event, data, result_cb, result_arg);
+    POP_EVENTING_NDC;
+    return true;
+  }
+
+  if ( !_moment_get(dispatch, &moment, err) )
   {
     POP_EVENTING_NDC;
     return false;
   }
 
   _trigger_prepared(dispatch, event, data,
-                    result_cb, result_arg, trigger_data);
+                    result_cb, result_arg, moment);
 
   POP_EVENTING_NDC;
 
@@ -86,10 +86,25 @@ LS_API ls_event*
 ls_event_dispatcher_get_event(ls_event_dispatcher* dispatch,
                               const char*          name);
 
+/**
+ * Retrieves the event notifier from the dispatcher for the given ID, as
+ * returned by ls_event_get_id().  Cheaper than looking events up by name.
+ *
+ * \invariant dispatch != NULL
+ * \param[in] dispatch The event dispatcher
+ * \param[in] id The event ID
+ * \retval ls_event_notifier The event notifier, or NULL if not found
+ */
+LS_API ls_event*
+ls_event_dispatcher_get_event_by_id(ls_event_dispatcher* dispatch,
+                                    size_t               id);
+
 /**
  * Create a new event for the given dispatcher and event name. When
  * created, this event is registered with the given dispatcher and can be
- * accessed via ls_event_dispatcher_get_event().
+ * accessed via ls_event_dispatcher_get_event(), or by its ID with
+ * ls_event_dispatcher_get_event_by_id().  Events are given IDs 0, 1, 2...
+ * in the order they are created.
  *
  * \b NOTE: The event name is case-insensitive; while the original value may
  * be retained, most uses use a "lower-case" variant.
@@ -137,6 +152,16 @@ ls_event_get_name(ls_event* event);
 LS_API const void*
 ls_event_get_source(ls_event* event);
 
+/**
+ * Retrieves the ID of this event, unique within its dispatcher.
+ *
+ * \invariant event != NULL
+ * \param[in] event The event
+ * \retval size_t The event ID
+ */
+LS_API size_t
+ls_event_get_id(ls_event* event);
+
 /**
  * Binds the given callback to the event.
  *
@@ -180,6 +205,11 @@ ls_event_unbind(ls_event*                event,
  * within an event callback are added to an event queue and processed when the
  * triggering callback returns. Each source has its own event queue.
  *
+ * When nothing is running or queued on the dispatcher, the callbacks run
+ * straight away and nothing is allocated.  Queued triggers reuse the
+ * dispatcher's finished ones, so allocation only happens when the queue is
+ * deeper than it has been before.
+ *
  * This function can generate the following errors (set when returning false):
  * \li \c LS_ERR_NO_MEMORY if the triggering info could not be allocated
  *
@@ -220,7 +250,8 @@ ls_event_trigger_prepared(ls_event*                event,
 
 /**
  * Pre-allocates the data structures for a single call to
- * ls_event_trigger_prepared.
+ * ls_event_trigger_prepared.  The trigger data belongs to {dispatch}, and
+ * must be triggered or unprepared before it is destroyed.
  *
  * This function can generate the following errors (set when returning false):
  * \li \c LS_ERR_NO_MEMORY if the triggering info could not be allocated
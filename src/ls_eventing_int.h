@@ -14,36 +14,48 @@
 #include "ls_htable.h"
 
 /**
- * Event binding information. This structure is created for each call to
+ * Event binding information. There is one of these for each call to
  * ls_event_bind with a unique callback.
  */
 typedef struct _ls_event_binding_t
 {
-  ls_event_notify_callback    cb;
-  void*                       arg;
-  struct _ls_event_binding_t* next;
-  bool                        unbound;
+  ls_event_notify_callback cb;
+  void*                    arg;
   /**
-   * Binding status. True if it is already bound before an event is
-   * triggered. It is false by default and marked as true at the very
-   * beginning of an event trigger. Within an event trigger, false
-   * implies a callback that is bound in the current event and should
-   * not be executed until the next time this event is triggered.
+   * Set when the callback is unbound while its event is running.  The
+   * binding is dropped once the event finishes.
    */
-  bool normal_bound;
+  bool unbound;
 } ls_event_binding_t;
 
+/**
+ * An event's bindings, in the order they were bound, in one array.  Adding
+ * a binding builds a new array, so that a running trigger can walk the one
+ * it started with while its callbacks bind more; the new bindings don't run
+ * until the next trigger.
+ */
+typedef struct _ls_event_bindings_t
+{
+  /** the event's reference, plus one while a trigger is walking it */
+  unsigned int       refs;
+  size_t             count;
+  ls_event_binding_t entries[];
+} ls_event_bindings_t;
+
 /**
  * Event triggering information. This describes a "moment in time" of an
- * event.
+ * event.  Prepared trigger data is a moment taken ahead of time, so
+ * ls_event_trigger_data is the same structure.
  */
-typedef struct _ls_event_moment_t
+typedef struct _ls_event_trigger_t
 {
-  struct _ls_event_data_t    evt;
-  ls_event_result_callback   result_cb;
-  void*                      result_arg;
-  ls_event_binding_t*        bindings;
-  struct _ls_event_moment_t* next;
+  struct _ls_event_data_t      evt;
+  ls_event_result_callback     result_cb;
+  void*                        result_arg;
+  /** owned by the moment, and reset each time it is recycled */
+  ls_pool*                     pool;
+  struct _ls_event_dispatch_t* dispatch;
+  struct _ls_event_trigger_t*  next;
 } ls_event_moment_t;
 
 /**
@@ -52,10 +64,18 @@ typedef struct _ls_event_moment_t
 typedef struct _ls_event_dispatch_t
 {
   void*              source;
+  /** name lookup only; events are owned through here */
   ls_htable*         events;
+  /** every event, indexed by its ID */
+  ls_event**         by_id;
+  size_t             event_count;
   ls_event*          running;
   ls_event_moment_t* moment_queue_tail;
   ls_event_moment_t* next_moment;
+  /** finished moments, kept for reuse so triggers don't allocate */
+  ls_event_moment_t* free_moments;
+  /** evt.pool for triggers run straight away, when nothing is queued */
+  ls_pool*           sync_pool;
   bool               destroy_pending;
 } ls_event_dispatch_t;
 
@@ -67,5 +87,7 @@ typedef struct _ls_event_t
   ls_event_dispatch_t* dispatcher;
   const void*          source;
   const char*          name;
-  ls_event_binding_t*  bindings;
+  size_t               id;
+  /** NULL when nothing is bound */
+  ls_event_bindings_t* bindings;
 } ls_event_notifier_t;
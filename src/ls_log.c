@@ -8,10 +8,14 @@
 #include "./ls_log_int.h"
 #include "ls_log.h"
 #include "ls_mem.h"
+#include "ls_timer.h"
+#include "ls_spsc.h"
 
 #include <time.h>
 #include <string.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
 
 /*****************************************************************************
  * Internal type definitions
@@ -42,6 +46,14 @@ static const int level_colors[] = {
 static ls_loglevel            _ls_loglevel            = LS_LOG_INFO;
 static ls_log_vararg_function _ls_log_vararg_function = vfprintf;
 
+/* LS_LOG_LIMITED: nanoseconds per message, and how far ahead of now a */
+/* site's bucket may be full and still have one.  Zero interval is no limit. */
+static uint64_t _limit_interval  = LS_NS_PER_SEC / 10;
+static uint64_t _limit_tolerance = LS_NS_PER_SEC / 10 * 9;
+
+/* the sites that have suppressed anything on this thread */
+static __thread ls_log_limit* _limit_head = NULL;
+
 typedef struct _ndc_node_int_t
 {
   uint32_t                id;
@@ -50,12 +62,10 @@ typedef struct _ndc_node_int_t
 } _ndc_node_t;
 
 static bool _ndc_enabled = true;
-/* TODO: once we support threading, these will have to be thread-local
- * instead */
-/* TODO:   of static */
-static int          _ndc_depth = 0;
-static _ndc_node_t* _ndc_head  = NULL;
-static uint32_t     _ndc_count = 0;
+/* thread-local, since each manager in a group logs from its own thread */
+static __thread int          _ndc_depth = 0;
+static __thread _ndc_node_t* _ndc_head  = NULL;
+static __thread uint32_t     _ndc_count = 0;
 
 
 static int
@@ -121,6 +131,75 @@ ls_log_get_level()
   return _ls_loglevel;
 }
 
+LS_API void
+ls_log_set_limit(uint32_t rate,
+                 uint32_t burst)
+{
+  assert(burst > 0);
+
+  _limit_interval  = rate ? LS_NS_PER_SEC / rate : 0;
+  _limit_tolerance = _limit_interval * (burst - 1);
+}
+
+static void
+_log_suppressed(ls_log_limit* lim)
+{
+  ls_log(lim->level, "%s:%d: %" PRIu64 " similar messages suppressed",
+         lim->file, lim->line, lim->suppressed);
+  lim->suppressed = 0;
+}
+
+LS_API bool
+ls_log_limit_take(ls_log_limit* lim,
+                  ls_loglevel   level,
+                  uint64_t      now)
+{
+  assert(lim);
+  assert(LS_LOG_ERROR <= level);
+  assert(LS_LOG_MEMTRACE >= level);
+
+  if (level > _ls_loglevel)
+  {
+    return false;
+  }
+  if (_limit_interval == 0)
+  {
+    return true;
+  }
+  lim->level = level;
+  if (lim->full > now + _limit_tolerance)
+  {
+    if (!lim->listed)
+    {
+      lim->listed = true;
+      lim->next   = _limit_head;
+      _limit_head = lim;
+    }
+    lim->suppressed++;
+    return false;
+  }
+  lim->full = (lim->full > now ? lim->full : now) + _limit_interval;
+  if (lim->suppressed > 0)
+  {
+    _log_suppressed(lim);
+  }
+  return true;
+}
+
+LS_API void
+ls_log_limit_flush(void)
+{
+  ls_log_limit* lim;
+
+  for (lim = _limit_head; lim; lim = lim->next)
+  {
+    if (lim->suppressed > 0)
+    {
+      _log_suppressed(lim);
+    }
+  }
+}
+
 static void
 _log_ndc_stack(_ndc_node_t* ndcNode)
 {
@@ -138,22 +217,13 @@ _log_ndc_stack(_ndc_node_t* ndcNode)
                          ndcNode->id, ndcNode->message);
 }
 
+/* The date/time and level that start each line */
 static bool
-_log_prefix(ls_loglevel level)
+_log_header(ls_loglevel level,
+            time_t      t)
 {
-  time_t    t;
   struct tm local;
 
-  assert(LS_LOG_ERROR <= level);
-  assert(LS_LOG_MEMTRACE >= level);
-
-  if (level > _ls_loglevel)
-  {
-    return false;
-  }
-
-  /* TODO: cache time and update it asyncronously with a timer? */
-  t = time(NULL);
   if ( (t == (time_t)-1) || !localtime_r(&t, &local) )
   {
     /* Note: both time() and localtime_r() only fail for */
@@ -172,6 +242,25 @@ _log_prefix(ls_loglevel level)
                           local.tm_sec,
                           level_colors[level],
                           ls_log_level_name(level) );
+  return true;
+}
+
+static bool
+_log_prefix(ls_loglevel level)
+{
+  assert(LS_LOG_ERROR <= level);
+  assert(LS_LOG_MEMTRACE >= level);
+
+  if (level > _ls_loglevel)
+  {
+    return false;
+  }
+
+  /* TODO: cache time and update it asyncronously with a timer? */
+  if ( !_log_header( level, time(NULL) ) )
+  {
+    return false;
+  }
 
   if (_ndc_enabled)
   {
@@ -253,15 +342,879 @@ ls_log_pop_ndc(int ndc_depth)
   }
 }
 
+/*****************************************************************************
+ * Asynchronous logging: each thread copies its messages, unformatted, into
+ * its own ring, and one writer thread formats them all.
+ */
+
+/* Bytes in a record, and records in each thread's ring by default */
+#define ASYNC_RECORD_SIZE 256
+#define ASYNC_RECORDS 256
+/* NDC entries carried with each message, innermost first */
+#define ASYNC_NDC_MAX 4
+/* Longest conversion spec the writer will pass on, e.g. "%-+#012.*llx" */
+#define ASYNC_SPEC_MAX 32
+/* How long the writer sleeps, at most, when there's nothing to write */
+#define ASYNC_IDLE_MAX_NS (10 * LS_NS_PER_MS)
+/* A string length meaning the pointer was NULL */
+#define ASYNC_NULL_STR UINT16_MAX
+
+/* the message didn't all fit */
+#define REC_TRUNCATED 0x01
+/* an ls_err's message is packed ahead of the arguments */
+#define REC_REASON    0x02
+
+typedef struct _async_record
+{
+  /* the caller's format string, which outlives the record */
+  const char* fmt;
+  /* CLOCK_REALTIME nanoseconds */
+  uint64_t when;
+  uint16_t len;
+  uint8_t  level;
+  uint8_t  flags;
+  uint8_t  ndc;
+  /* NDC entries, then the reason, then the arguments, packed in order */
+  uint8_t data[ASYNC_RECORD_SIZE - sizeof(const char*) -
+               sizeof(uint64_t) - 8];
+} _async_record;
+
+typedef struct _async_ring
+{
+  ls_spsc* spsc;
+  /* messages that didn't fit, counted by the producer; and how many of */
+  /* those the writer has said were dropped */
+  uint64_t dropped;
+  uint64_t reported;
+  /* the producing thread has exited; free the ring once it's empty */
+  bool                orphaned;
+  struct _async_ring* next;
+} _async_ring;
+
+typedef enum
+{
+  ARG_NONE = 0,
+  ARG_PERCENT,
+  ARG_INT,
+  ARG_LONG,
+  ARG_LLONG,
+  ARG_INTMAX,
+  ARG_SIZE,
+  ARG_PTRDIFF,
+  ARG_DOUBLE,
+  ARG_LDOUBLE,
+  ARG_PTR,
+  ARG_STR
+} _arg_class;
+
+/* One conversion in a format string */
+typedef struct _conv
+{
+  /* through the conversion character */
+  size_t len;
+  /* '*' width and precision, each an int argument ahead of the value */
+  int  stars;
+  bool prec_star;
+  /* a written-out precision, or -1 */
+  int        prec;
+  _arg_class cls;
+} _conv;
+
+static bool            _async_on      = false;
+static bool            _async_quit    = false;
+static unsigned int    _async_gen     = 0;
+static size_t          _async_records = ASYNC_RECORDS;
+static pthread_t       _async_thread;
+static pthread_key_t   _async_key;
+static pthread_mutex_t _async_lock  = PTHREAD_MUTEX_INITIALIZER;
+static _async_ring*    _async_rings = NULL;
+
+/* this thread's ring, and which ls_log_async_start() it's from */
+static __thread _async_ring* _my_ring = NULL;
+static __thread unsigned int _my_gen  = 0;
+
+static bool
+_is_digit(char c)
+{
+  return (c >= '0') && (c <= '9');
+}
+
+/* Work out what the conversion at p (a '%') takes.  Anything this can't */
+/* carry across threads (%n, wide characters, positional arguments) is */
+/* ARG_NONE, and the message stops there. */
+static void
+_parse_conv(const char* p,
+            _conv*      c)
+{
+  const char* s   = p + 1;
+  char        mod = 0;
+
+  c->stars     = 0;
+  c->prec_star = false;
+  c->prec      = -1;
+  c->cls       = ARG_NONE;
+  c->len       = 0;
+
+  if (*s == '%')
+  {
+    c->cls = ARG_PERCENT;
+    c->len = 2;
+    return;
+  }
+  while ( *s && strchr("-+ #0'", *s) )
+  {
+    s++;
+  }
+  if (*s == '*')
+  {
+    c->stars++;
+    s++;
+  }
+  else
+  {
+    while ( _is_digit(*s) )
+    {
+      s++;
+    }
+    if (*s == '$')
+    {
+      return;
+    }
+  }
+  if (*s == '.')
+  {
+    s++;
+    if (*s == '*')
+    {
+      c->stars++;
+      c->prec_star = true;
+      s++;
+    }
+    else
+    {
+      c->prec = 0;
+      while ( _is_digit(*s) )
+      {
+        c->prec = c->prec * 10 + (*s++ - '0');
+      }
+    }
+  }
+  switch (*s)
+  {
+  case 'h':
+    s += (s[1] == 'h') ? 2 : 1;
+    mod = 'h';
+    break;
+  case 'l':
+    if (s[1] == 'l')
+    {
+      s++;
+      mod = 'q';
+    }
+    else
+    {
+      mod = 'l';
+    }
+    s++;
+    break;
+  case 'j':
+  case 'z':
+  case 't':
+  case 'L':
+    mod = *s++;
+    break;
+  default:
+    break;
+  }
+
+  switch (*s)
+  {
+  case 'd':
+  case 'i':
+  case 'o':
+  case 'u':
+  case 'x':
+  case 'X':
+    switch (mod)
+    {
+    case 'l':
+      c->cls = ARG_LONG;
+      break;
+    case 'q':
+      c->cls = ARG_LLONG;
+      break;
+    case 'j':
+      c->cls = ARG_INTMAX;
+      break;
+    case 'z':
+      c->cls = ARG_SIZE;
+      break;
+    case 't':
+      c->cls = ARG_PTRDIFF;
+      break;
+    case 'L':
+      return;
+    default:
+      c->cls = ARG_INT;
+      break;
+    }
+    break;
+  case 'c':
+    if (mod)
+    {
+      return;
+    }
+    c->cls = ARG_INT;
+    break;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    c->cls = (mod == 'L') ? ARG_LDOUBLE : ARG_DOUBLE;
+    break;
+  case 's':
+    if (mod)
+    {
+      return;
+    }
+    c->cls = ARG_STR;
+    break;
+  case 'p':
+    c->cls = ARG_PTR;
+    break;
+  default:
+    return;
+  }
+  c->len = s - p + 1;
+}
+
+static bool
+_pack(_async_record* rec,
+      const void*    v,
+      size_t         n)
+{
+  if (rec->len + n > sizeof(rec->data) )
+  {
+    rec->flags |= REC_TRUNCATED;
+    return false;
+  }
+  memcpy(rec->data + rec->len, v, n);
+  rec->len += n;
+  return true;
+}
+
+/* Copy a string in, as its length and then its bytes and a NUL; as much */
+/* of it as will fit, if it won't */
+static bool
+_pack_str(_async_record* rec,
+          const char*    str,
+          int            prec)
+{
+  uint16_t n = ASYNC_NULL_STR;
+  size_t   len, room;
+
+  if (!str)
+  {
+    return _pack( rec, &n, sizeof(n) );
+  }
+  len = (prec >= 0) ? strnlen(str, prec) : strlen(str);
+  if (rec->len + sizeof(n) + 1 > sizeof(rec->data) )
+  {
+    rec->flags |= REC_TRUNCATED;
+    return false;
+  }
+  room = sizeof(rec->data) - rec->len - sizeof(n) - 1;
+  if (len > room)
+  {
+    len         = room;
+    rec->flags |= REC_TRUNCATED;
+  }
+  n = (uint16_t)len;
+  _pack( rec, &n, sizeof(n) );
+  _pack(rec, str, len);
+  rec->data[rec->len++] = '\0';
+  return !(rec->flags & REC_TRUNCATED);
+}
+
+#define PACK_ARG(rec, ap, type) \
+  do { \
+    type _v = va_arg(ap, type); \
+    if ( !_pack( rec, &_v, sizeof(_v) ) ) \
+    { \
+      return; \
+    } \
+  } while (0)
+
+/* Copy the NDC, the reason and every argument fmt calls for into rec */
+static void
+_pack_args(_async_record* rec,
+           const ls_err*  err,
+           va_list        ap)
+{
+  const char*  p;
+  _ndc_node_t* nodes[ASYNC_NDC_MAX];
+  _ndc_node_t* node;
+  _conv        c;
+  int          i, prec, star;
+
+  if (_ndc_enabled)
+  {
+    for (node = _ndc_head; node && rec->ndc < ASYNC_NDC_MAX;
+         node = node->next)
+    {
+      nodes[rec->ndc++] = node;
+    }
+    /* outermost first, as they'd be printed */
+    for (i = rec->ndc - 1; i >= 0; i--)
+    {
+      if ( !_pack( rec, &nodes[i]->id, sizeof(nodes[i]->id) ) ||
+           !_pack_str(rec, nodes[i]->message, -1) )
+      {
+        return;
+      }
+    }
+  }
+  if (err && err->message)
+  {
+    rec->flags |= REC_REASON;
+    if ( !_pack_str(rec, err->message, -1) )
+    {
+      return;
+    }
+  }
+
+  for (p = strchr(rec->fmt, '%'); p; p = strchr(p + c.len, '%') )
+  {
+    _parse_conv(p, &c);
+    if (c.cls == ARG_NONE)
+    {
+      return;
+    }
+    prec = c.prec;
+    for (i = 0; i < c.stars; i++)
+    {
+      star = va_arg(ap, int);
+      if ( !_pack( rec, &star, sizeof(star) ) )
+      {
+        return;
+      }
+      if (c.prec_star && (i == c.stars - 1) )
+      {
+        prec = star;
+      }
+    }
+    switch (c.cls)
+    {
+    case ARG_INT:
+      PACK_ARG(rec, ap, int);
+      break;
+    case ARG_LONG:
+      PACK_ARG(rec, ap, long);
+      break;
+    case ARG_LLONG:
+      PACK_ARG(rec, ap, long long);
+      break;
+    case ARG_INTMAX:
+      PACK_ARG(rec, ap, intmax_t);
+      break;
+    case ARG_SIZE:
+      PACK_ARG(rec, ap, size_t);
+      break;
+    case ARG_PTRDIFF:
+      PACK_ARG(rec, ap, ptrdiff_t);
+      break;
+    case ARG_DOUBLE:
+      PACK_ARG(rec, ap, double);
+      break;
+    case ARG_LDOUBLE:
+      PACK_ARG(rec, ap, long double);
+      break;
+    case ARG_PTR:
+      PACK_ARG(rec, ap, void*);
+      break;
+    case ARG_STR:
+      if ( !_pack_str(rec, va_arg(ap, const char*), prec) )
+      {
+        return;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/* Called as a thread that has logged exits */
+static void
+_async_orphan(void* arg)
+{
+  _async_ring* r = arg;
+
+  __atomic_store_n(&r->orphaned, true, __ATOMIC_RELEASE);
+}
+
+static _async_ring*
+_async_get_ring(void)
+{
+  _async_ring* r;
+  unsigned int gen = __atomic_load_n(&_async_gen, __ATOMIC_ACQUIRE);
+
+  if ( _my_ring && (_my_gen == gen) )
+  {
+    return _my_ring;
+  }
+  r = ls_data_calloc( 1, sizeof(*r) );
+  if (!r)
+  {
+    return NULL;
+  }
+  if ( !ls_spsc_create(sizeof(_async_record), _async_records, &r->spsc,
+                       NULL) )
+  {
+    ls_data_free(r);
+    return NULL;
+  }
+  pthread_mutex_lock(&_async_lock);
+  r->next = _async_rings;
+  __atomic_store_n(&_async_rings, r, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&_async_lock);
+  pthread_setspecific(_async_key, r);
+  _my_ring = r;
+  _my_gen  = gen;
+  return r;
+}
+
+/* Queue a message for the writer.  false if it has to be logged here. */
+static bool
+_async_log(ls_loglevel   level,
+           const ls_err* err,
+           const char*   fmt,
+           va_list       ap)
+{
+  _async_ring*    r;
+  _async_record*  rec;
+  struct timespec ts;
+
+  assert(LS_LOG_ERROR <= level);
+  assert(LS_LOG_MEMTRACE >= level);
+
+  r = _async_get_ring();
+  if (!r)
+  {
+    return false;
+  }
+  rec = ls_spsc_reserve(r->spsc);
+  if (!rec)
+  {
+    /* bounded: rather lose a message than hold up the caller */
+    __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+    return true;
+  }
+  clock_gettime(CLOCK_REALTIME, &ts);
+  rec->fmt   = fmt;
+  rec->when  = (uint64_t)ts.tv_sec * LS_NS_PER_SEC + ts.tv_nsec;
+  rec->len   = 0;
+  rec->level = level;
+  rec->flags = 0;
+  rec->ndc   = 0;
+  _pack_args(rec, err, ap);
+  ls_spsc_push(r->spsc);
+  return true;
+}
+
+static bool
+_async_wanted(ls_loglevel level)
+{
+  return (level <= _ls_loglevel) &&
+         __atomic_load_n(&_async_on, __ATOMIC_ACQUIRE);
+}
+
+/* Print one conversion.  spec came from a format string that the */
+/* compiler checked against these arguments where ls_log() was called. */
+static int
+_emit(const char* spec,
+      ...)
+{
+  va_list ap;
+  int     ret;
+
+  va_start(ap, spec);
+  ret = _ls_log_vararg_function(stderr, spec, ap);
+  va_end(ap);
+  return ret;
+}
+
+#define EMIT_ARG(spec, c, star, type, d, used, end) \
+  do { \
+    type _v; \
+    if ( !_unpack( d, used, end, &_v, sizeof(_v) ) ) \
+    { \
+      return false; \
+    } \
+    switch ( (c).stars ) \
+    { \
+    case 0: \
+      _emit(spec, _v); \
+      break; \
+    case 1: \
+      _emit(spec, star[0], _v); \
+      break; \
+    default: \
+      _emit(spec, star[0], star[1], _v); \
+      break; \
+    } \
+  } while (0)
+
+static bool
+_unpack(const uint8_t* d,
+        size_t*        used,
+        size_t         end,
+        void*          v,
+        size_t         n)
+{
+  if (*used + n > end)
+  {
+    return false;
+  }
+  memcpy(v, d + *used, n);
+  *used += n;
+  return true;
+}
+
+static bool
+_unpack_str(const uint8_t* d,
+            size_t*        used,
+            size_t         end,
+            const char**   str)
+{
+  uint16_t n;
+
+  if ( !_unpack( d, used, end, &n, sizeof(n) ) )
+  {
+    return false;
+  }
+  if (n == ASYNC_NULL_STR)
+  {
+    *str = NULL;
+    return true;
+  }
+  if (*used + n + 1 > end)
+  {
+    return false;
+  }
+  *str   = (const char*)d + *used;
+  *used += n + 1;
+  return true;
+}
+
+/* Print the message part of a record; false if it ran out of arguments */
+static bool
+_async_format(const _async_record* rec,
+              const uint8_t*       d,
+              size_t*              used)
+{
+  const char* p = rec->fmt;
+  const char* q;
+  const char* str;
+  char        spec[ASYNC_SPEC_MAX];
+  int         star[2];
+  int         i;
+  _conv       c;
+
+  while (*p)
+  {
+    q = strchr(p, '%');
+    if (!q)
+    {
+      _ls_log_fixed_function(stderr, "%s", p);
+      break;
+    }
+    if (q > p)
+    {
+      _ls_log_fixed_function(stderr, "%.*s", (int)(q - p), p);
+    }
+    _parse_conv(q, &c);
+    if ( (c.cls == ARG_NONE) || (c.len >= sizeof(spec) ) )
+    {
+      return false;
+    }
+    p = q + c.len;
+    if (c.cls == ARG_PERCENT)
+    {
+      _ls_log_fixed_function(stderr, "%%");
+      continue;
+    }
+    memcpy(spec, q, c.len);
+    spec[c.len] = '\0';
+    for (i = 0; i < c.stars; i++)
+    {
+      if ( !_unpack( d, used, rec->len, &star[i], sizeof(star[i]) ) )
+      {
+        return false;
+      }
+    }
+    switch (c.cls)
+    {
+    case ARG_INT:
+      EMIT_ARG(spec, c, star, int, d, used, rec->len);
+      break;
+    case ARG_LONG:
+      EMIT_ARG(spec, c, star, long, d, used, rec->len);
+      break;
+    case ARG_LLONG:
+      EMIT_ARG(spec, c, star, long long, d, used, rec->len);
+      break;
+    case ARG_INTMAX:
+      EMIT_ARG(spec, c, star, intmax_t, d, used, rec->len);
+      break;
+    case ARG_SIZE:
+      EMIT_ARG(spec, c, star, size_t, d, used, rec->len);
+      break;
+    case ARG_PTRDIFF:
+      EMIT_ARG(spec, c, star, ptrdiff_t, d, used, rec->len);
+      break;
+    case ARG_DOUBLE:
+      EMIT_ARG(spec, c, star, double, d, used, rec->len);
+      break;
+    case ARG_LDOUBLE:
+      EMIT_ARG(spec, c, star, long double, d, used, rec->len);
+      break;
+    case ARG_PTR:
+      EMIT_ARG(spec, c, star, void*, d, used, rec->len);
+      break;
+    case ARG_STR:
+      if ( !_unpack_str(d, used, rec->len, &str) )
+      {
+        return false;
+      }
+      switch (c.stars)
+      {
+      case 0:
+        _emit(spec, str);
+        break;
+      case 1:
+        _emit(spec, star[0], str);
+        break;
+      default:
+        _emit(spec, star[0], star[1], str);
+        break;
+      }
+      break;
+    default:
+      break;
+    }
+    if ( (rec->flags & REC_TRUNCATED) && (*used >= rec->len) )
+    {
+      /* that was as far as it got */
+      return false;
+    }
+  }
+  return !(rec->flags & REC_TRUNCATED);
+}
+
+static void
+_async_write(const _async_record* rec)
+{
+  const uint8_t* d    = rec->data;
+  size_t         used = 0;
+  const char*    str  = NULL;
+  uint32_t       id;
+  int            i;
+
+  if ( !_log_header( (ls_loglevel)rec->level,
+                     (time_t)(rec->when / LS_NS_PER_SEC) ) )
+  {
+    return;
+  }
+  for (i = 0; i < rec->ndc; i++)
+  {
+    if ( !_unpack( d, &used, rec->len, &id, sizeof(id) ) ||
+         !_unpack_str(d, &used, rec->len, &str) )
+    {
+      goto truncated;
+    }
+    _ls_log_fixed_function(stderr, "{ndcid=%u; %s} ", id, str);
+  }
+  if (rec->flags & REC_REASON)
+  {
+    if ( !_unpack_str(d, &used, rec->len, &str) )
+    {
+      goto truncated;
+    }
+    _ls_log_fixed_function(stderr, "reason(%s): ", str);
+  }
+  if ( _async_format(rec, d, &used) )
+  {
+    _ls_log_fixed_function(stderr, "\n");
+    return;
+  }
+truncated:
+  _ls_log_fixed_function(stderr, "...\n");
+}
+
+/* Write out everything queued so far; how many messages that was */
+static size_t
+_async_drain(void)
+{
+  _async_ring*   r;
+  _async_ring*   next;
+  _async_ring**  prev;
+  _async_record* rec;
+  uint64_t       dropped;
+  bool           orphaned;
+  size_t         count = 0;
+
+  /* rings are only ever added at the head, and only removed here, so the */
+  /* list can be walked without the lock */
+  for (r = __atomic_load_n(&_async_rings, __ATOMIC_ACQUIRE); r; r = next)
+  {
+    next = r->next;
+    /* before looking, so that an orphan's last messages are seen */
+    orphaned = __atomic_load_n(&r->orphaned, __ATOMIC_ACQUIRE);
+    while ( ( rec = ls_spsc_peek(r->spsc) ) != NULL )
+    {
+      _async_write(rec);
+      ls_spsc_pop(r->spsc);
+      count++;
+    }
+    dropped = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    if (dropped != r->reported)
+    {
+      if ( _log_header( LS_LOG_WARN, time(NULL) ) )
+      {
+        _ls_log_fixed_function(stderr, "%" PRIu64 " log messages dropped\n",
+                               dropped - r->reported);
+      }
+      r->reported = dropped;
+    }
+    if (orphaned)
+    {
+      /* a new ring may have gone in ahead of it since */
+      pthread_mutex_lock(&_async_lock);
+      for (prev = &_async_rings; *prev != r; prev = &(*prev)->next)
+      {
+      }
+      *prev = next;
+      pthread_mutex_unlock(&_async_lock);
+      ls_spsc_destroy(r->spsc);
+      ls_data_free(r);
+    }
+  }
+  return count;
+}
+
+static void*
+_async_run(void* arg)
+{
+  struct timespec nap  = {0, 0};
+  uint64_t        idle = 0;
+  bool            quit;
+  UNUSED_PARAM(arg);
+
+  while (true)
+  {
+    /* read first, so that the drain after it gets everything */
+    quit = __atomic_load_n(&_async_quit, __ATOMIC_ACQUIRE);
+    if (_async_drain() > 0)
+    {
+      idle = 0;
+      continue;
+    }
+    if (quit)
+    {
+      break;
+    }
+    /* back off while it's quiet, up to a limit */
+    idle         = idle ? idle * 2 : LS_NS_PER_MS / 8;
+    idle         = (idle > ASYNC_IDLE_MAX_NS) ? ASYNC_IDLE_MAX_NS : idle;
+    nap.tv_nsec  = (long)idle;
+    nanosleep(&nap, NULL);
+  }
+  return NULL;
+}
+
+LS_API bool
+ls_log_async_start(size_t  records,
+                   ls_err* err)
+{
+  int r;
+
+  if (_async_on)
+  {
+    return true;
+  }
+  _async_records = 2;
+  while ( _async_records < (records ? records : ASYNC_RECORDS) )
+  {
+    _async_records *= 2;
+  }
+  r = pthread_key_create(&_async_key, _async_orphan);
+  if (r != 0)
+  {
+    LS_ERROR(err, -r);
+    return false;
+  }
+  _async_quit = false;
+  __atomic_store_n(&_async_gen, _async_gen + 1, __ATOMIC_RELEASE);
+  r = pthread_create(&_async_thread, NULL, _async_run, NULL);
+  if (r != 0)
+  {
+    pthread_key_delete(_async_key);
+    LS_ERROR(err, -r);
+    return false;
+  }
+  __atomic_store_n(&_async_on, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+LS_API void
+ls_log_async_stop(void)
+{
+  _async_ring* r;
+
+  if (!_async_on)
+  {
+    return;
+  }
+  __atomic_store_n(&_async_on,   false, __ATOMIC_RELEASE);
+  __atomic_store_n(&_async_quit, true,  __ATOMIC_RELEASE);
+  pthread_join(_async_thread, NULL);
+  /* no more orphan calls for these rings */
+  pthread_key_delete(_async_key);
+  while (_async_rings)
+  {
+    r            = _async_rings;
+    _async_rings = r->next;
+    ls_spsc_destroy(r->spsc);
+    ls_data_free(r);
+  }
+}
+
 LS_API void
 ls_log(ls_loglevel level,
        const char* fmt,
        ...)
 {
   va_list ap;
+  bool    queued;
 
   assert(fmt);
 
+  if ( _async_wanted(level) )
+  {
+    va_start(ap, fmt);
+    queued = _async_log(level, NULL, fmt, ap);
+    va_end(ap);
+    if (queued)
+    {
+      return;
+    }
+  }
+
   if ( !_log_prefix(level) )
   {
     return;
@@ -280,9 +1233,21 @@ ls_log_err(ls_loglevel level,
            ...)
 {
   va_list ap;
+  bool    queued;
 
   assert(fmt);
 
+  if ( _async_wanted(level) )
+  {
+    va_start(ap, fmt);
+    queued = _async_log(level, err, fmt, ap);
+    va_end(ap);
+    if (queued)
+    {
+      return;
+    }
+  }
+
   if ( !_log_prefix(level) )
   {
     return;
@@ -116,6 +116,34 @@ _add_page(ls_pool* pool,
   return true;
 }
 
+/* Move an empty page (left over from ls_pool_reset) to the front of the */
+/* list, so that allocation can continue there.  returns false if there */
+/* isn't one. */
+static bool
+_reuse_page(ls_pool* pool)
+{
+  _pool_page* prev;
+  _pool_page* page;
+
+  if (!pool->pages)
+  {
+    return false;
+  }
+  for (prev = pool->pages, page = prev->next;
+       page;
+       prev = page, page = page->next)
+  {
+    if (page->used == 0)
+    {
+      prev->next  = page->next;
+      page->next  = pool->pages;
+      pool->pages = page;
+      return true;
+    }
+  }
+  return false;
+}
+
 static bool _paging_enabled = true;
 void
 ls_pool_enable_paging(bool enable)
@@ -305,6 +333,42 @@ ls_pool_destroy(ls_pool* pool)
   ls_data_free(pool);
 }
 
+LS_API void
+ls_pool_reset(ls_pool* pool)
+{
+  _pool_cleaner_ctx*  cur, * next;
+  _pool_cleaner_ctx** link;
+  _pool_page*         page;
+
+  assert(pool);
+
+  /* keep the pages (and the cleaners that will free them at destroy time), */
+  /* and fire everything else */
+  link       = &pool->cleaners;
+  pool->tail = NULL;
+  for (cur = pool->cleaners; cur != NULL; cur = next)
+  {
+    next = cur->next;
+    if (cur->cleaner == _free_page)
+    {
+      *link      = cur;
+      link       = &cur->next;
+      pool->tail = cur;
+      continue;
+    }
+    (*cur->cleaner)(cur->arg);
+    ls_data_free(cur);
+  }
+  *link = NULL;
+
+  pool->size = 0;
+  for (page = pool->pages; page != NULL; page = page->next)
+  {
+    page->used  = 0;
+    pool->size += page->size;
+  }
+}
+
 LS_API bool
 ls_pool_add_cleaner(ls_pool*        pool,
                     ls_pool_cleaner callback,
@@ -361,7 +425,7 @@ ls_pool_malloc(ls_pool* pool,
     /* try to allocate from current page */
     else if ( !_page_malloc(pool->pages, size, &ret) )
     {
-      if ( !_add_page(pool, err) )
+      if ( !_reuse_page(pool) && !_add_page(pool, err) )
       {
         return false;
       }
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+
+#include "ls_mpsc.h"
+
+LS_API void
+ls_mpsc_init(ls_mpsc* q)
+{
+  assert(q);
+  q->head = NULL;
+}
+
+LS_API bool
+ls_mpsc_push(ls_mpsc*      q,
+             ls_mpsc_node* node)
+{
+  ls_mpsc_node* old;
+
+  assert(q);
+  assert(node);
+
+  old = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  do
+  {
+    node->next = old;
+  } while ( !__atomic_compare_exchange_n(&q->head, &old, node, true,
+                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED) );
+  return old == NULL;
+}
+
+LS_API ls_mpsc_node*
+ls_mpsc_take(ls_mpsc* q)
+{
+  ls_mpsc_node* node;
+  ls_mpsc_node* next;
+  ls_mpsc_node* ret = NULL;
+
+  assert(q);
+  /* taking the whole list at once means there's no ABA to worry about */
+  node = __atomic_exchange_n(&q->head, NULL, __ATOMIC_ACQUIRE);
+
+  /* newest first, so turn it around */
+  for (; node; node = next)
+  {
+    next       = node->next;
+    node->next = ret;
+    ret        = node;
+  }
+  return ret;
+}
+
+LS_API bool
+ls_mpsc_empty(ls_mpsc* q)
+{
+  assert(q);
+  return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == NULL;
+}
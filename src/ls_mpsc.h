@@ -0,0 +1,73 @@
+/**
+ * \file
+ * \brief
+ * Lock-free multiple-producer, single-consumer queue.  Nodes are embedded
+ * in the items being queued, so pushing never allocates.  Any number of
+ * threads may push at once; only one thread may take.
+ * private, not for use outside library and unit tests.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ls_basics.h"
+
+/** Link embedded in each queued item */
+typedef struct _ls_mpsc_node
+{
+  /** next item, in the order they were pushed once taken */
+  struct _ls_mpsc_node* next;
+} ls_mpsc_node;
+
+/** A queue.  Embed it, and ls_mpsc_init() it before use. */
+typedef struct _ls_mpsc
+{
+  /* the most recently pushed node; the list runs newest to oldest */
+  ls_mpsc_node* head;
+} ls_mpsc;
+
+/**
+ * Initialize an empty queue.
+ *
+ * \invariant q != NULL
+ * \param[in] q The queue
+ */
+LS_API void
+ls_mpsc_init(ls_mpsc* q);
+
+/**
+ * Add a node.  Safe to call from any thread.
+ *
+ * \invariant q != NULL
+ * \invariant node != NULL
+ * \param[in] q    The queue
+ * \param[in] node The node to add; must not already be queued
+ * \return true if the queue was empty, so the consumer may need waking
+ */
+LS_API bool
+ls_mpsc_push(ls_mpsc*      q,
+             ls_mpsc_node* node);
+
+/**
+ * Take every node in the queue at once.  Only one thread may call this.
+ *
+ * \invariant q != NULL
+ * \param[in] q The queue
+ * \return The nodes, oldest first, linked through next; NULL if empty
+ */
+LS_API ls_mpsc_node*
+ls_mpsc_take(ls_mpsc* q);
+
+/**
+ * Is the queue empty?  Only a hint while other threads are pushing.
+ *
+ * \invariant q != NULL
+ * \param[in] q The queue
+ * \return true if nothing is queued
+ */
+LS_API bool
+ls_mpsc_empty(ls_mpsc* q);
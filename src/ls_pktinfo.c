@@ -2,7 +2,7 @@
  * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
  */
 
-#include "ls_pktinfo.h"
+#include "ls_pktinfo_int.h"
 #include "ls_mem.h"
 
 #include <assert.h>
@@ -11,14 +11,6 @@
 #define HAS_INFO_4 (1 << 0)
 #define HAS_INFO_6 (1 << 1)
 
-struct _ls_pktinfo {
-  union {
-    struct in6_pktinfo i6;
-    struct in_pktinfo  i4;
-  } info;
-  char kind;
-};
-
 LS_API bool
 ls_pktinfo_create(ls_pktinfo** p,
                   ls_err*      err)
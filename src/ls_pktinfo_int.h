@@ -0,0 +1,21 @@
+/**
+ * \file
+ * \brief
+ * Packet info typedefs, so that a pktinfo can be embedded in another
+ * structure.  private, not for use outside library and unit tests.
+ * \see ls_pktinfo.h
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include "ls_pktinfo.h"
+
+struct _ls_pktinfo {
+  union {
+    struct in6_pktinfo i6;
+    struct in_pktinfo  i4;
+  } info;
+  char kind;
+};
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+
+#include "ls_spsc.h"
+#include "ls_mem.h"
+
+#define CACHE_LINE 64
+
+struct _ls_spsc
+{
+  size_t   size;
+  size_t   mask;
+  uint8_t* slots;
+  /* the two ends are kept a cache line apart, so that they don't fight */
+  /* over it; padded rather than aligned, since calloc won't align */
+  uint8_t  pad0[CACHE_LINE];
+  /* the producer's end, and what it last saw of the consumer's */
+  size_t   head;
+  size_t   tail_seen;
+  uint8_t  pad1[CACHE_LINE];
+  /* the consumer's end, and what it last saw of the producer's */
+  size_t   tail;
+  size_t   head_seen;
+  uint8_t  pad2[CACHE_LINE];
+};
+
+LS_API bool
+ls_spsc_create(size_t    size,
+               size_t    count,
+               ls_spsc** ring,
+               ls_err*   err)
+{
+  ls_spsc* ret;
+
+  assert(size > 0);
+  assert( count > 0 && ( (count & (count - 1) ) == 0 ) );
+  assert(ring);
+
+  /* keep every slot aligned for whatever goes in it */
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  ret  = ls_data_calloc(1, sizeof(*ret) + size * count);
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  ret->size  = size;
+  ret->mask  = count - 1;
+  ret->slots = (uint8_t*)(ret + 1);
+  *ring      = ret;
+  return true;
+}
+
+LS_API void
+ls_spsc_destroy(ls_spsc* ring)
+{
+  ls_data_free(ring);
+}
+
+LS_API void*
+ls_spsc_reserve(ls_spsc* ring)
+{
+  assert(ring);
+  if (ring->head - ring->tail_seen > ring->mask)
+  {
+    /* only go to the consumer's line when it looks full */
+    ring->tail_seen = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (ring->head - ring->tail_seen > ring->mask)
+    {
+      return NULL;
+    }
+  }
+  return ring->slots + (ring->head & ring->mask) * ring->size;
+}
+
+LS_API void
+ls_spsc_push(ls_spsc* ring)
+{
+  assert(ring);
+  assert(ring->head - ring->tail_seen <= ring->mask);
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+LS_API void*
+ls_spsc_peek(ls_spsc* ring)
+{
+  assert(ring);
+  if (ring->tail == ring->head_seen)
+  {
+    ring->head_seen = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (ring->tail == ring->head_seen)
+    {
+      return NULL;
+    }
+  }
+  return ring->slots + (ring->tail & ring->mask) * ring->size;
+}
+
+LS_API void
+ls_spsc_pop(ls_spsc* ring)
+{
+  assert(ring);
+  assert(ring->tail != ring->head_seen);
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
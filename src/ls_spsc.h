@@ -0,0 +1,89 @@
+/**
+ * \file
+ * \brief
+ * Lock-free single-producer, single-consumer ring of fixed-size slots.
+ * The producer fills a slot in place and then publishes it, and the
+ * consumer reads it in place and then gives it back, so nothing is copied
+ * twice or allocated after creation.  One thread may produce and one
+ * (other) thread may consume at a time.
+ * private, not for use outside library and unit tests.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ls_basics.h"
+#include "ls_error.h"
+
+/** A ring */
+typedef struct _ls_spsc ls_spsc;
+
+/**
+ * Create a ring.
+ *
+ * \invariant size > 0
+ * \invariant count is a power of two
+ * \invariant ring != NULL
+ * \param[in]  size  Bytes in each slot
+ * \param[in]  count How many slots
+ * \param[out] ring  The created ring
+ * \param[out] err   If non-NULL on input, contains error if false is
+ *                   returned
+ * \return true: created.  false: see err.
+ */
+LS_API bool
+ls_spsc_create(size_t    size,
+               size_t    count,
+               ls_spsc** ring,
+               ls_err*   err);
+
+/**
+ * Destroy a ring, and anything still in it.
+ *
+ * \param[in] ring The ring to destroy.  NULL is a no-op.
+ */
+LS_API void
+ls_spsc_destroy(ls_spsc* ring);
+
+/**
+ * Get the next free slot to fill in.  Producer only.  Calling this again
+ * before ls_spsc_push() returns the same slot.
+ *
+ * \invariant ring != NULL
+ * \param[in] ring The ring
+ * \return The slot, or NULL if the ring is full
+ */
+LS_API void*
+ls_spsc_reserve(ls_spsc* ring);
+
+/**
+ * Hand the slot from ls_spsc_reserve() to the consumer.  Producer only.
+ *
+ * \invariant ring != NULL
+ * \param[in] ring The ring
+ */
+LS_API void
+ls_spsc_push(ls_spsc* ring);
+
+/**
+ * Look at the oldest slot pushed.  Consumer only.
+ *
+ * \invariant ring != NULL
+ * \param[in] ring The ring
+ * \return The slot, or NULL if the ring is empty
+ */
+LS_API void*
+ls_spsc_peek(ls_spsc* ring);
+
+/**
+ * Give the slot from ls_spsc_peek() back to the producer.  Consumer only.
+ *
+ * \invariant ring != NULL
+ * \param[in] ring The ring
+ */
+LS_API void
+ls_spsc_pop(ls_spsc* ring);
@@ -3,30 +3,57 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <stddef.h>
+#include <time.h>
 
 #include "ls_mem.h"
-#include "ls_timer.h"
+#include "ls_timer_int.h"
 
-struct _ls_timer
+/* ls_timer.ns of a cancelled timer */
+#define CANCELLED 0
+
+LS_API bool
+ls_time_now_ns(uint64_t* now,
+               ls_err*   err)
+{
+  struct timespec ts;
+
+  assert(now);
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  *now = (uint64_t)ts.tv_sec * LS_NS_PER_SEC + ts.tv_nsec;
+  return true;
+}
+
+LS_API uint64_t
+ls_time_from_timeval(const struct timeval* tv)
 {
-  ls_timer_func  cb;
-  void*          context;
-  struct timeval tv;
-};
+  assert(tv);
+  return (uint64_t)tv->tv_sec * LS_NS_PER_SEC + tv->tv_usec * LS_NS_PER_US;
+}
 
-static const struct timeval epoch = {0, 0};
+LS_API void
+ls_time_to_timeval(uint64_t        ns,
+                   struct timeval* tv)
+{
+  assert(tv);
+  tv->tv_sec  = ns / LS_NS_PER_SEC;
+  tv->tv_usec = (ns % LS_NS_PER_SEC) / LS_NS_PER_US;
+}
 
 LS_API bool
-ls_timer_create(const struct timeval* actual,
-                ls_timer_func         cb,
-                void*                 context,
-                ls_timer**            tim,
-                ls_err*               err)
+ls_timer_create_ns(uint64_t      when,
+                   ls_timer_func cb,
+                   void*         context,
+                   ls_timer**    tim,
+                   ls_err*       err)
 {
   ls_timer* ret = NULL;
-  assert(actual);
   assert(cb);
   assert(tim);
 
@@ -39,11 +66,24 @@ ls_timer_create(const struct timeval* actual,
 
   ret->cb      = cb;
   ret->context = context;
-  ret->tv      = *actual;
+  ret->ns      = when;
+  ret->refs    = 1;
   *tim         = ret;
   return true;
 }
 
+LS_API bool
+ls_timer_create(const struct timeval* actual,
+                ls_timer_func         cb,
+                void*                 context,
+                ls_timer**            tim,
+                ls_err*               err)
+{
+  assert(actual);
+  return ls_timer_create_ns(ls_time_from_timeval(actual), cb, context,
+                            tim, err);
+}
+
 LS_API bool
 ls_timer_create_ms(const struct timeval* now,
                    unsigned long         ms,
@@ -52,32 +92,40 @@ ls_timer_create_ms(const struct timeval* now,
                    ls_timer**            tim,
                    ls_err*               err)
 {
-  struct timeval delta = {ms / 1000, (ms % 1000) * 1000};
-  struct timeval then;
   assert(now);
-  timeradd(now, &delta, &then);
-  return ls_timer_create(&then, cb, context, tim, err);
+  return ls_timer_create_ns(ls_time_from_timeval(now) + ms * LS_NS_PER_MS,
+                            cb, context, tim, err);
+}
+
+LS_API void
+ls_timer_ref(ls_timer* tim)
+{
+  assert(tim);
+  __atomic_add_fetch(&tim->refs, 1, __ATOMIC_RELAXED);
 }
 
 LS_API void
 ls_timer_destroy(ls_timer* tim)
 {
   assert(tim);
-  ls_data_free(tim);
+  if (__atomic_sub_fetch(&tim->refs, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    ls_data_free(tim);
+  }
 }
 
 LS_API void
 ls_timer_cancel(ls_timer* tim)
 {
   assert(tim);
-  tim->tv = epoch;
+  tim->ns = CANCELLED;
 }
 
 LS_API bool
 ls_timer_is_cancelled(ls_timer* tim)
 {
   assert(tim);
-  return timercmp(&tim->tv, &epoch, ==);
+  return tim->ns == CANCELLED;
 }
 
 LS_API void*
@@ -87,6 +135,13 @@ ls_timer_get_context(ls_timer* tim)
   return tim->context;
 }
 
+LS_API uint64_t
+ls_timer_get_ns(ls_timer* tim)
+{
+  assert(tim);
+  return tim->ns;
+}
+
 LS_API struct timeval*
 ls_timer_get_time(ls_timer* tim)
 {
@@ -95,6 +150,7 @@ ls_timer_get_time(ls_timer* tim)
   {
     return NULL;
   }
+  ls_time_to_timeval(tim->ns, &tim->tv);
   return &tim->tv;
 }
 
@@ -104,7 +160,7 @@ ls_timer_less(ls_timer* a,
 {
   assert(a);
   assert(b);
-  return timercmp(&a->tv, &b->tv, <);
+  return a->ns < b->ns;
 }
 
 LS_API bool
@@ -113,7 +169,7 @@ ls_timer_greater(ls_timer* a,
 {
   assert(a);
   assert(b);
-  return timercmp(&a->tv, &b->tv, >);
+  return a->ns > b->ns;
 }
 
 LS_API bool
@@ -122,7 +178,15 @@ ls_timer_greater_tv(ls_timer*       a,
 {
   assert(a);
   assert(b);
-  return timercmp(&a->tv, b, >);
+  return a->ns > ls_time_from_timeval(b);
+}
+
+LS_API bool
+ls_timer_greater_ns(ls_timer* a,
+                    uint64_t  b)
+{
+  assert(a);
+  return a->ns > b;
 }
 
 LS_API void
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "ls_timer_heap.h"
+#include "ls_timer_int.h"
+#include "ls_mem.h"
+
+#define MIN_CAPACITY 64
+
+struct _ls_timer_heap
+{
+  ls_timer** items;
+  size_t     size;
+  size_t     capacity;
+};
+
+static inline bool
+_less(const ls_timer* a,
+      const ls_timer* b)
+{
+  return a->ns < b->ns;
+}
+
+static inline void
+_set(ls_timer_heap* h,
+     size_t         i,
+     ls_timer*      tim)
+{
+  h->items[i]   = tim;
+  tim->heap_idx = i + 1;
+}
+
+/* Move the timer at i up until its parent is due before it */
+static void
+_sift_up(ls_timer_heap* h,
+         size_t         i)
+{
+  ls_timer* tim = h->items[i];
+  size_t    parent;
+
+  while (i > 0)
+  {
+    parent = (i - 1) / 2;
+    if ( !_less(tim, h->items[parent]) )
+    {
+      break;
+    }
+    _set(h, i, h->items[parent]);
+    i = parent;
+  }
+  _set(h, i, tim);
+}
+
+/* Move the timer at i down until its children are due after it */
+static void
+_sift_down(ls_timer_heap* h,
+           size_t         i)
+{
+  ls_timer* tim = h->items[i];
+  size_t    child;
+
+  while ( (child = 2 * i + 1) < h->size )
+  {
+    if ( (child + 1 < h->size) &&
+         _less(h->items[child + 1], h->items[child]) )
+    {
+      child++;
+    }
+    if ( !_less(h->items[child], tim) )
+    {
+      break;
+    }
+    _set(h, i, h->items[child]);
+    i = child;
+  }
+  _set(h, i, tim);
+}
+
+/* Re-sift whichever way the timer at i needs to go */
+static void
+_fix(ls_timer_heap* h,
+     size_t         i)
+{
+  if ( (i > 0) && _less(h->items[i], h->items[(i - 1) / 2]) )
+  {
+    _sift_up(h, i);
+  }
+  else
+  {
+    _sift_down(h, i);
+  }
+}
+
+LS_API bool
+ls_timer_heap_create(ls_timer_heap** h,
+                     ls_err*         err)
+{
+  ls_timer_heap* ret;
+
+  assert(h);
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  *h = ret;
+  return true;
+}
+
+LS_API void
+ls_timer_heap_destroy(ls_timer_heap* h)
+{
+  size_t i;
+
+  if (!h)
+  {
+    return;
+  }
+  for (i = 0; i < h->size; i++)
+  {
+    ls_timer_destroy(h->items[i]);
+  }
+  ls_data_free(h->items);
+  ls_data_free(h);
+}
+
+LS_API size_t
+ls_timer_heap_count(ls_timer_heap* h)
+{
+  assert(h);
+  return h->size;
+}
+
+LS_API bool
+ls_timer_heap_push(ls_timer_heap* h,
+                   ls_timer*      tim,
+                   ls_err*        err)
+{
+  ls_timer** items;
+  size_t     capacity;
+
+  assert(h);
+  assert(tim);
+  assert(tim->heap_idx == 0);
+
+  if (h->size == h->capacity)
+  {
+    capacity = h->capacity ? h->capacity * 2 : MIN_CAPACITY;
+    items    = ls_data_realloc( h->items, capacity * sizeof(ls_timer*) );
+    if (!items)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      return false;
+    }
+    h->items    = items;
+    h->capacity = capacity;
+  }
+  h->items[h->size] = tim;
+  _sift_up(h, h->size++);
+  return true;
+}
+
+LS_API ls_timer*
+ls_timer_heap_top(ls_timer_heap* h)
+{
+  assert(h);
+  return h->size ? h->items[0] : NULL;
+}
+
+LS_API ls_timer*
+ls_timer_heap_pop(ls_timer_heap* h)
+{
+  ls_timer* ret;
+
+  assert(h);
+  if (h->size == 0)
+  {
+    return NULL;
+  }
+  ret = h->items[0];
+  ls_timer_heap_remove(h, ret);
+  return ret;
+}
+
+LS_API bool
+ls_timer_heap_remove(ls_timer_heap* h,
+                     ls_timer*      tim)
+{
+  size_t i;
+
+  assert(h);
+  assert(tim);
+  if (tim->heap_idx == 0)
+  {
+    return false;
+  }
+  i = tim->heap_idx - 1;
+  assert(i < h->size);
+  assert(h->items[i] == tim);
+
+  tim->heap_idx = 0;
+  if (i != --h->size)
+  {
+    /* the last one takes its place, then finds its own */
+    _set(h, i, h->items[h->size]);
+    _fix(h, i);
+  }
+  return true;
+}
+
+LS_API bool
+ls_timer_heap_update(ls_timer_heap* h,
+                     ls_timer*      tim)
+{
+  assert(h);
+  assert(tim);
+  if (tim->heap_idx == 0)
+  {
+    return false;
+  }
+  _fix(h, tim->heap_idx - 1);
+  return true;
+}
@@ -0,0 +1,114 @@
+/**
+ * \file
+ * \brief
+ * Binary min-heap of timers, ordered by when they are due.  Each timer
+ * remembers its position in the heap, so one can be removed or moved in
+ * O(log n) without searching for it.
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.  Users MUST ensure access to all
+ * instances of a heap is limited to a single thread, or locked.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "ls_timer.h"
+
+/** An instance of a timer heap */
+typedef struct _ls_timer_heap ls_timer_heap;
+
+/**
+ * Create a heap.
+ *
+ * \invariant h != NULL
+ * \param[out] h   The created heap
+ * \param[out] err The error information (provide NULL to ignore)
+ * \return bool    true if successful, false otherwise.
+ */
+LS_API bool
+ls_timer_heap_create(ls_timer_heap** h,
+                     ls_err*         err);
+
+/**
+ * Destroy a heap, and every timer still in it.
+ *
+ * \param[in] h The heap to destroy.  NULL is a no-op.
+ */
+LS_API void
+ls_timer_heap_destroy(ls_timer_heap* h);
+
+/**
+ * Number of timers in the heap.
+ *
+ * \invariant h != NULL
+ * \param[in] h The heap
+ * \return The count
+ */
+LS_API size_t
+ls_timer_heap_count(ls_timer_heap* h);
+
+/**
+ * Add a timer.
+ *
+ * \invariant h != NULL
+ * \invariant tim != NULL, and not in any heap
+ * \param[in]  h   The heap
+ * \param[in]  tim The timer to add
+ * \param[out] err The error information (provide NULL to ignore)
+ * \return bool    true if successful, false otherwise.
+ */
+LS_API bool
+ls_timer_heap_push(ls_timer_heap* h,
+                   ls_timer*      tim,
+                   ls_err*        err);
+
+/**
+ * The timer that is due first.
+ *
+ * \invariant h != NULL
+ * \param[in] h The heap
+ * \return The timer, or NULL if the heap is empty
+ */
+LS_API ls_timer*
+ls_timer_heap_top(ls_timer_heap* h);
+
+/**
+ * Take the timer that is due first out of the heap.  The caller owns it.
+ *
+ * \invariant h != NULL
+ * \param[in] h The heap
+ * \return The timer, or NULL if the heap is empty
+ */
+LS_API ls_timer*
+ls_timer_heap_pop(ls_timer_heap* h);
+
+/**
+ * Take a timer out of the heap, without destroying it.
+ *
+ * \invariant h != NULL
+ * \invariant tim != NULL
+ * \param[in] h   The heap
+ * \param[in] tim The timer to remove
+ * \return true if it was in the heap, false if it wasn't (e.g. it has
+ *         already been popped)
+ */
+LS_API bool
+ls_timer_heap_remove(ls_timer_heap* h,
+                     ls_timer*      tim);
+
+/**
+ * Put a timer back in order after the time it is due has changed.
+ *
+ * \invariant h != NULL
+ * \invariant tim != NULL
+ * \param[in] h   The heap
+ * \param[in] tim The timer that changed
+ * \return true if it was in the heap, false if it wasn't
+ */
+LS_API bool
+ls_timer_heap_update(ls_timer_heap* h,
+                     ls_timer*      tim);
@@ -0,0 +1,36 @@
+/**
+ * \file
+ * \brief
+ * Timer typedefs, so that timer queues can keep track of where each timer
+ * is.
+ * private, not for use outside library and unit tests.
+ * \see ls_timer.h
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ls_timer.h"
+
+struct _ls_timer
+{
+  ls_timer_func      cb;
+  void*              context;
+  /* when it fires, in nanoseconds; 0 once cancelled */
+  uint64_t           ns;
+  /* ns as a timeval, filled in by ls_timer_get_time() */
+  struct timeval     tv;
+  /* linkage for ls_timer_wheel; pprev is NULL when not in a wheel */
+  struct _ls_timer*  next;
+  struct _ls_timer** pprev;
+  uint64_t           tick;
+  int                slot;
+  /* 1 + position in an ls_timer_heap, or 0 when not in a heap */
+  size_t             heap_idx;
+  /* freed when the last of these is dropped; changed from any thread */
+  unsigned int       refs;
+};
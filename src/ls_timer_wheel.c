@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "ls_timer_wheel.h"
+#include "ls_timer_int.h"
+#include "ls_mem.h"
+
+#define WHEEL_BITS   8
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_WORDS  (WHEEL_SLOTS / 64)
+/* furthest out a timer can be placed */
+#define WHEEL_MAX_DELTA ( (UINT64_C(1) << (WHEEL_BITS * WHEEL_LEVELS) ) - 1 )
+/* ls_timer.slot for a timer on the due list */
+#define SLOT_DUE -1
+
+struct _ls_timer_wheel
+{
+  uint64_t   origin;
+  /* next tick to be processed */
+  uint64_t   now;
+  /* timers in slots, not counting the due list */
+  size_t     pending;
+  size_t     due_count;
+  ls_timer*  due;
+  ls_timer** due_tail;
+  uint64_t   used[WHEEL_LEVELS][WHEEL_WORDS];
+  ls_timer*  slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+/* Milliseconds from the origin, rounded up so that timers never fire early */
+static uint64_t
+_tick(const ls_timer_wheel* w,
+      uint64_t              ns,
+      bool                  round_up)
+{
+  uint64_t d;
+  uint64_t ms;
+
+  if (ns < w->origin)
+  {
+    return 0;
+  }
+  d  = ns - w->origin;
+  ms = d / LS_NS_PER_MS;
+  if ( round_up && (d % LS_NS_PER_MS) )
+  {
+    ms++;
+  }
+  return ms;
+}
+
+/* First used slot at or after from, or WHEEL_SLOTS */
+static unsigned int
+_next_used(const uint64_t* used,
+           unsigned int    from)
+{
+  unsigned int word = from / 64;
+  uint64_t     bits;
+
+  if (from >= WHEEL_SLOTS)
+  {
+    return WHEEL_SLOTS;
+  }
+  bits = used[word] & ( ~UINT64_C(0) << (from % 64) );
+  while (!bits)
+  {
+    if (++word == WHEEL_WORDS)
+    {
+      return WHEEL_SLOTS;
+    }
+    bits = used[word];
+  }
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+static void
+_append_due(ls_timer_wheel* w,
+            ls_timer*       tim)
+{
+  tim->slot   = SLOT_DUE;
+  tim->next   = NULL;
+  tim->pprev  = w->due_tail;
+  *w->due_tail = tim;
+  w->due_tail  = &tim->next;
+  w->due_count++;
+}
+
+static void
+_place(ls_timer_wheel* w,
+       ls_timer*       tim)
+{
+  uint64_t     delta = tim->tick - w->now;
+  uint64_t     at;
+  unsigned int level = 0;
+  unsigned int idx;
+
+  if (delta > WHEEL_MAX_DELTA)
+  {
+    delta = WHEEL_MAX_DELTA;
+  }
+  while ( (level < WHEEL_LEVELS - 1) &&
+          ( delta >= (UINT64_C(1) << (WHEEL_BITS * (level + 1) ) ) ) )
+  {
+    level++;
+  }
+  at  = w->now + delta;
+  idx = (at >> (WHEEL_BITS * level) ) & WHEEL_MASK;
+
+  tim->slot  = level * WHEEL_SLOTS + idx;
+  tim->next  = w->slots[level][idx];
+  tim->pprev = &w->slots[level][idx];
+  if (tim->next)
+  {
+    tim->next->pprev = &tim->next;
+  }
+  w->slots[level][idx]          = tim;
+  w->used[level][idx / 64]     |= UINT64_C(1) << (idx % 64);
+  w->pending++;
+}
+
+/* Detach a whole slot, returning its list */
+static ls_timer*
+_take_slot(ls_timer_wheel* w,
+           unsigned int    level,
+           unsigned int    idx)
+{
+  ls_timer* head = w->slots[level][idx];
+  ls_timer* t;
+
+  w->slots[level][idx]       = NULL;
+  w->used[level][idx / 64] &= ~(UINT64_C(1) << (idx % 64) );
+  for (t = head; t; t = t->next)
+  {
+    w->pending--;
+  }
+  return head;
+}
+
+static void
+_cascade(ls_timer_wheel* w,
+         unsigned int    level,
+         unsigned int    idx)
+{
+  ls_timer* t = _take_slot(w, level, idx);
+  ls_timer* next;
+
+  for (; t; t = next)
+  {
+    next = t->next;
+    if (t->tick < w->now)
+    {
+      _append_due(w, t);
+    }
+    else
+    {
+      _place(w, t);
+    }
+  }
+}
+
+/* The first tick at which a used slot will be expired or cascaded */
+static uint64_t
+_next_tick(const ls_timer_wheel* w)
+{
+  uint64_t     best = UINT64_MAX;
+  uint64_t     turn, tick;
+  unsigned int level, shift, idx, from, i;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+  {
+    shift = WHEEL_BITS * level;
+    turn  = (w->now >> shift) & ~(uint64_t)WHEEL_MASK;
+    idx   = (w->now >> shift) & WHEEL_MASK;
+    /* above level 0, the current slot was emptied when we entered it, */
+    /* unless we're right on its boundary and haven't processed it yet */
+    from = idx;
+    if ( level && ( w->now & ( (UINT64_C(1) << shift) - 1 ) ) )
+    {
+      from++;
+    }
+    i = _next_used(w->used[level], from);
+    if (i == WHEEL_SLOTS)
+    {
+      i = _next_used(w->used[level], 0);
+      if (i == WHEEL_SLOTS)
+      {
+        continue;
+      }
+      turn += WHEEL_SLOTS;
+    }
+    tick = (turn + i) << shift;
+    if (tick < best)
+    {
+      best = tick;
+    }
+  }
+  return best;
+}
+
+LS_API bool
+ls_timer_wheel_create(uint64_t         now,
+                      ls_timer_wheel** w,
+                      ls_err*          err)
+{
+  ls_timer_wheel* ret;
+
+  assert(w);
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  ret->origin   = now;
+  ret->due_tail = &ret->due;
+  *w            = ret;
+  return true;
+}
+
+LS_API void
+ls_timer_wheel_destroy(ls_timer_wheel* w)
+{
+  ls_timer*    t;
+  ls_timer*    next;
+  unsigned int level, idx;
+
+  if (!w)
+  {
+    return;
+  }
+  for (level = 0; level < WHEEL_LEVELS; level++)
+  {
+    for (idx = 0; idx < WHEEL_SLOTS; idx++)
+    {
+      for (t = w->slots[level][idx]; t; t = next)
+      {
+        next = t->next;
+        ls_timer_destroy(t);
+      }
+    }
+  }
+  for (t = w->due; t; t = next)
+  {
+    next = t->next;
+    ls_timer_destroy(t);
+  }
+  ls_data_free(w);
+}
+
+LS_API size_t
+ls_timer_wheel_count(ls_timer_wheel* w)
+{
+  assert(w);
+  return w->pending + w->due_count;
+}
+
+LS_API void
+ls_timer_wheel_add(ls_timer_wheel* w,
+                   ls_timer*       tim)
+{
+  assert(w);
+  assert(tim);
+  assert(!tim->pprev);
+
+  tim->tick = _tick(w, tim->ns, true);
+  if (tim->tick < w->now)
+  {
+    _append_due(w, tim);
+  }
+  else
+  {
+    _place(w, tim);
+  }
+}
+
+LS_API bool
+ls_timer_wheel_remove(ls_timer_wheel* w,
+                      ls_timer*       tim)
+{
+  unsigned int level, idx;
+
+  assert(w);
+  assert(tim);
+  if (!tim->pprev)
+  {
+    return false;
+  }
+
+  *tim->pprev = tim->next;
+  if (tim->next)
+  {
+    tim->next->pprev = tim->pprev;
+  }
+
+  if (tim->slot == SLOT_DUE)
+  {
+    if (w->due_tail == &tim->next)
+    {
+      w->due_tail = tim->pprev;
+    }
+    w->due_count--;
+  }
+  else
+  {
+    level = tim->slot / WHEEL_SLOTS;
+    idx   = tim->slot % WHEEL_SLOTS;
+    if (!w->slots[level][idx])
+    {
+      w->used[level][idx / 64] &= ~(UINT64_C(1) << (idx % 64) );
+    }
+    w->pending--;
+  }
+  tim->next  = NULL;
+  tim->pprev = NULL;
+  return true;
+}
+
+LS_API void
+ls_timer_wheel_advance(ls_timer_wheel* w,
+                       uint64_t        now)
+{
+  uint64_t     target;
+  unsigned int idx, level, i;
+  ls_timer*    t;
+  ls_timer*    next;
+
+  assert(w);
+
+  target = _tick(w, now, false);
+  while (w->now <= target)
+  {
+    if (w->pending == 0)
+    {
+      w->now = target + 1;
+      break;
+    }
+
+    idx = w->now & WHEEL_MASK;
+    if (idx == 0)
+    {
+      /* bring the next slot of each level down, as far as this tick */
+      /* rolls over */
+      for (level = 1; level < WHEEL_LEVELS; level++)
+      {
+        i = (w->now >> (WHEEL_BITS * level) ) & WHEEL_MASK;
+        _cascade(w, level, i);
+        if (i != 0)
+        {
+          break;
+        }
+      }
+    }
+
+    for (t = _take_slot(w, 0, idx); t; t = next)
+    {
+      next = t->next;
+      _append_due(w, t);
+    }
+
+    /* skip empty slots, stopping at the end of this turn of level 0.  If */
+    /* level 0 is empty, skip straight to the next cascade. */
+    i       = _next_used(w->used[0], idx + 1);
+    w->now += i - idx;
+    if ( (i == WHEEL_SLOTS) && (w->pending > 0) &&
+         (_next_used(w->used[0], 0) == WHEEL_SLOTS) )
+    {
+      w->now = _next_tick(w);
+    }
+    if (w->now > target + 1)
+    {
+      w->now = target + 1;
+    }
+  }
+}
+
+LS_API ls_timer*
+ls_timer_wheel_pop_due(ls_timer_wheel* w)
+{
+  ls_timer* ret;
+
+  assert(w);
+  ret = w->due;
+  if (ret)
+  {
+    ls_timer_wheel_remove(w, ret);
+  }
+  return ret;
+}
+
+LS_API bool
+ls_timer_wheel_next(ls_timer_wheel* w,
+                    uint64_t*       when)
+{
+  assert(w);
+  assert(when);
+
+  if (w->due)
+  {
+    *when = w->due->ns;
+    return true;
+  }
+  if (w->pending == 0)
+  {
+    return false;
+  }
+
+  *when = w->origin + _next_tick(w) * LS_NS_PER_MS;
+  return true;
+}
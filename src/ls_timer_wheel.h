@@ -0,0 +1,121 @@
+/**
+ * \file
+ * \brief
+ * Hierarchical timing wheel.  Four levels of 256 slots each, with a
+ * resolution of one millisecond, cover about 49 days; timers further out
+ * than that wait in the last level until they come into range.  Adding and
+ * removing a timer are O(1).  Timers that come due are moved, a slot at a
+ * time, onto a due list in the order they expire.
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.  Users MUST ensure access to all
+ * instances of a wheel is limited to a single thread, or locked.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ls_timer.h"
+
+/** An instance of a timing wheel */
+typedef struct _ls_timer_wheel ls_timer_wheel;
+
+/**
+ * Create a wheel.
+ *
+ * \invariant w != NULL
+ * \param[in]  now The current time, in nanoseconds.  Ticks are counted
+ *                 from here.
+ * \param[out] w   The created wheel
+ * \param[out] err The error information (provide NULL to ignore)
+ * \return bool    true if successful, false otherwise.
+ */
+LS_API bool
+ls_timer_wheel_create(uint64_t         now,
+                      ls_timer_wheel** w,
+                      ls_err*          err);
+
+/**
+ * Destroy a wheel, and every timer still in it.
+ *
+ * \param[in] w The wheel to destroy.  NULL is a no-op.
+ */
+LS_API void
+ls_timer_wheel_destroy(ls_timer_wheel* w);
+
+/**
+ * Number of timers in the wheel, including ones that are due.
+ *
+ * \invariant w != NULL
+ * \param[in] w The wheel
+ * \return The count
+ */
+LS_API size_t
+ls_timer_wheel_count(ls_timer_wheel* w);
+
+/**
+ * Add a timer.  A timer that is already due goes straight on the due list.
+ *
+ * \invariant w != NULL
+ * \invariant tim != NULL, and not in any wheel
+ * \param[in] w   The wheel
+ * \param[in] tim The timer to add
+ */
+LS_API void
+ls_timer_wheel_add(ls_timer_wheel* w,
+                   ls_timer*       tim);
+
+/**
+ * Take a timer out of the wheel, without destroying it.
+ *
+ * \invariant w != NULL
+ * \invariant tim != NULL
+ * \param[in] w   The wheel
+ * \param[in] tim The timer to remove
+ * \return true if it was in the wheel, false if it wasn't (e.g. it has
+ *         already been returned from ls_timer_wheel_pop_due())
+ */
+LS_API bool
+ls_timer_wheel_remove(ls_timer_wheel* w,
+                      ls_timer*       tim);
+
+/**
+ * Move the wheel forward, putting every timer that is due at or before
+ * now on the due list.
+ *
+ * \invariant w != NULL
+ * \param[in] w   The wheel
+ * \param[in] now The current time, in nanoseconds
+ */
+LS_API void
+ls_timer_wheel_advance(ls_timer_wheel* w,
+                       uint64_t        now);
+
+/**
+ * Take the first timer off of the due list.  The caller owns it.
+ *
+ * \invariant w != NULL
+ * \param[in] w The wheel
+ * \return The timer, or NULL if none are due
+ */
+LS_API ls_timer*
+ls_timer_wheel_pop_due(ls_timer_wheel* w);
+
+/**
+ * When should the wheel next be advanced?  This may be earlier than the
+ * next timer is due, when timers need to move down a level first, but is
+ * never later.
+ *
+ * \invariant w != NULL
+ * \invariant when != NULL
+ * \param[in]  w    The wheel
+ * \param[out] when The time to advance at, in nanoseconds
+ * \return true if when was set, false if the wheel is empty
+ */
+LS_API bool
+ls_timer_wheel_next(ls_timer_wheel* w,
+                    uint64_t*       when);
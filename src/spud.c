@@ -8,10 +8,31 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "spud.h"
 #include "config.h"
 
+#ifdef HAVE_GETRANDOM
+#include <sys/random.h>
+#endif
+
+/* glibc's arc4random is a system call each time, so where getrandom is */
+/* there too, buffer that instead.  The BSDs' arc4random is already fast. */
+#if defined(HAVE_GETRANDOM) || !defined(HAVE_ARC4RANDOM)
+#define USE_RAND_POOL 1
+/* random bytes are read from the kernel this many at a time, and handed */
+/* out from a per-thread buffer; 512 tube IDs' worth */
+#define RAND_POOL_SIZE 4096
+
+static __thread uint8_t _rand_pool[RAND_POOL_SIZE];
+/* the unused bytes are the last _rand_avail of the pool */
+static __thread size_t _rand_avail = 0;
+static pthread_once_t  _rand_once  = PTHREAD_ONCE_INIT;
+#endif
+
 LS_API bool
 spud_is_spud(const uint8_t* payload,
              size_t         length)
@@ -40,42 +61,118 @@ spud_init(spud_header*  hdr,
   }
 }
 
+#ifdef USE_RAND_POOL
+/* Fill buf with sz bytes straight from the kernel */
 static bool
-get_rand_buf(void*   buf,
-             size_t  sz,
-             ls_err* err)
+_rand_fill(uint8_t* buf,
+           size_t   sz,
+           ls_err*  err)
 {
-#ifdef HAVE_ARC4RANDOM
-  UNUSED_PARAM(err);
-  arc4random_buf(buf, sz);
+  ssize_t n;
+#ifdef HAVE_GETRANDOM
+  while (sz > 0)
+  {
+    n = getrandom(buf, sz, 0);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    buf += n;
+    sz  -= n;
+  }
   return true;
 #elif defined(HAVE__DEV_URANDOM)
-  /* TODO: think about pre-reading entropy to avoid blocking I/O here. */
-  /* *certainly* don't open/close the file every time. */
-  /* Also, read these: */
-  /*
-   * http://insanecoding.blogspot.com/2014/05/a-good-idea-with-bad-usage-devurandom.html
-   * */
-  /* http://www.2uo.de/myths-about-urandom/ */
-  /* --- Yes. Move to openSSL or someting? */
-  FILE*  rfile = fopen("/dev/urandom", "r");
-  size_t nread;
-  if (!rfile)
+  int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
   {
     LS_ERROR(err, -errno);
     return false;
   }
-  nread = fread(buf, 1, sz, rfile);
-  fclose(rfile);
-  /* Only true if size is 1. (did not understand man page) */
-  /* If this is untrue, something horrible has happened, and we should just */
-  /* stop. */
-  return (nread == sz);
+  while (sz > 0)
+  {
+    n = read(fd, buf, sz);
+    if (n <= 0)
+    {
+      if ( (n < 0) && (errno == EINTR) )
+      {
+        continue;
+      }
+      LS_ERROR(err, n < 0 ? -errno : LS_ERR_INVALID_STATE);
+      close(fd);
+      return false;
+    }
+    buf += n;
+    sz  -= n;
+  }
+  close(fd);
+  return true;
 #else
   #error New random source needed
 #endif
 }
 
+/* A forked child starts with a copy of its parent's pool, which the */
+/* parent is going to hand out too.  Only the forking thread survives, */
+/* so its pool is the only one to throw away. */
+static void
+_rand_atfork_child(void)
+{
+  _rand_avail = 0;
+}
+
+static void
+_rand_init(void)
+{
+  pthread_atfork(NULL, NULL, _rand_atfork_child);
+}
+#endif
+
+static bool
+get_rand_buf(void*   buf,
+             size_t  sz,
+             ls_err* err)
+{
+#ifndef USE_RAND_POOL
+  UNUSED_PARAM(err);
+  arc4random_buf(buf, sz);
+  return true;
+#else
+  uint8_t* out = buf;
+  size_t   n;
+
+  pthread_once(&_rand_once, _rand_init);
+  /* big requests don't go through the pool */
+  if (sz > RAND_POOL_SIZE)
+  {
+    return _rand_fill(out, sz, err);
+  }
+  while (sz > 0)
+  {
+    if (_rand_avail == 0)
+    {
+      if ( !_rand_fill(_rand_pool, RAND_POOL_SIZE, err) )
+      {
+        return false;
+      }
+      _rand_avail = RAND_POOL_SIZE;
+    }
+    n = sz < _rand_avail ? sz : _rand_avail;
+    memcpy(out, _rand_pool + RAND_POOL_SIZE - _rand_avail, n);
+    /* nothing handed out stays behind to be found later */
+    memset(_rand_pool + RAND_POOL_SIZE - _rand_avail, 0, n);
+    _rand_avail -= n;
+    out         += n;
+    sz          -= n;
+  }
+  return true;
+#endif
+}
+
 LS_API bool
 spud_create_id(spud_tube_id* id,
                ls_err*       err)
@@ -93,11 +190,38 @@ spud_create_id(spud_tube_id* id,
   return true;
 }
 
+LS_API bool
+spud_create_ids(spud_tube_id* ids,
+                size_t        count,
+                ls_err*       err)
+{
+  if ( (ids == NULL) && (count > 0) )
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+  if (count == 0)
+  {
+    return true;
+  }
+  return get_rand_buf(ids, count * sizeof(*ids), err);
+}
+
 LS_API bool
 spud_parse(const uint8_t* payload,
            size_t         length,
            spud_message*  msg,
            ls_err*        err)
+{
+  return spud_parse_ctx(payload, length, msg, NULL, err);
+}
+
+LS_API bool
+spud_parse_ctx(const uint8_t*   payload,
+               size_t           length,
+               spud_message*    msg,
+               cn_cbor_context* ctx,
+               ls_err*          err)
 {
   cn_cbor_errback cbor_err;
   if ( (payload == NULL) || (msg == NULL) || !spud_is_spud(payload, length) )
@@ -106,11 +230,12 @@ spud_parse(const uint8_t* payload,
     return false;
   }
   msg->header = (spud_header*)payload;
+  msg->ctx    = ctx;
   if ( length > sizeof(spud_header) )
   {
     msg->cbor = cn_cbor_decode(payload + sizeof(spud_header),
                                length - sizeof(spud_header),
-                               NULL,
+                               ctx,
                                &cbor_err);
     if (!msg->cbor)
     {
@@ -138,9 +263,10 @@ spud_unparse(spud_message* msg)
   msg->header = NULL;
   if (msg->cbor)
   {
-    cn_cbor_free(msg->cbor, NULL);
+    cn_cbor_free(msg->cbor, msg->ctx);
   }
   msg->cbor = NULL;
+  msg->ctx  = NULL;
 }
 
 LS_API bool
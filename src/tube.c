@@ -13,24 +13,154 @@
 
 #include "config.h"
 #include "ls_log.h"
+#include "ls_mem.h"
+#include "ls_pktinfo_int.h"
 #include "ls_sockaddr.h"
 #include "tube_manager.h"
+#include "tube_manager_int.h"
+#include "tube_slab.h"
 
 #define MAXBUFLEN 1500
+/* room for a full GSO send of maximum-sized datagrams */
+#define BURST_BUFLEN (TUBE_MANAGER_MAX_SEGMENTS * MAXBUFLEN)
 
 #define HAS_LOCAL_4 (1 << 0)
 #define HAS_LOCAL_6 (1 << 1)
 
+/* tube_send() only goes to the heap for more chunks than this */
+#define SEND_IOV 8
+
+/* CBOR major types, shifted into the initial byte */
+#define CBOR_MT_UINT  (0 << 5)
+#define CBOR_MT_BYTES (2 << 5)
+#define CBOR_MT_TEXT  (3 << 5)
+#define CBOR_MT_MAP   (5 << 5)
+/* the initial byte, then as many as 8 bytes of argument */
+#define CBOR_HEAD_MAX 9
+/* {0: h'...'} up to the start of the bytes: map(1), key 0, bstr head */
+#define DATA_PREAMBLE_MAX (1 + 1 + CBOR_HEAD_MAX)
+/* number of mandatory path declaration keys, and the longest encoding of */
+/* one of them, including the map head in front of the first */
+#define PDEC_KEYS    3
+#define PDEC_KEY_MAX 8
+
 struct _tube
 {
+  /* every packet starts with this; only the flags change from one to the */
+  /* next.  16-byte aligned, so it never straddles two cache lines. */
+  spud_header             hdr __attribute__ ( ( aligned(16) ) );
   tube_states_t           state;
   struct sockaddr_storage peer;
-  spud_tube_id            id;
   void*                   data;
   ls_pktinfo*             pktinfo;
   int                     sock;
+  tube_manager*           mgr;
+  /* pktinfo points here once the local address is known */
+  ls_pktinfo              local;
+  /* NULL if the tube came from tube_create() */
+  tube_slab*              slab;
+  struct _tube*           next_free;
 };
 
+typedef struct _tube_chunk
+{
+  struct _tube_chunk* next;
+  tube                tubes[TUBE_SLAB_CHUNK];
+} tube_chunk;
+
+struct _tube_slab
+{
+  tube_chunk* chunks;
+  tube*       free;
+  size_t      live;
+};
+
+LS_API bool
+tube_slab_create(tube_slab** slab,
+                 ls_err*     err)
+{
+  tube_slab* ret;
+
+  assert(slab);
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  *slab = ret;
+  return true;
+}
+
+LS_API void
+tube_slab_destroy(tube_slab* slab)
+{
+  tube_chunk* c;
+
+  if (!slab)
+  {
+    return;
+  }
+  assert(slab->live == 0);
+  while (slab->chunks)
+  {
+    c            = slab->chunks;
+    slab->chunks = c->next;
+    ls_data_free(c);
+  }
+  ls_data_free(slab);
+}
+
+LS_API size_t
+tube_slab_live(tube_slab* slab)
+{
+  assert(slab);
+  return slab->live;
+}
+
+LS_API bool
+tube_create_slab(tube_slab* slab,
+                 tube**     t,
+                 ls_err*    err)
+{
+  tube_chunk* c;
+  tube*       ret;
+  int         i;
+
+  assert(slab);
+  assert(t);
+  if (!slab->free)
+  {
+    c = ls_data_malloc( sizeof(*c) );
+    if (!c)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      *t = NULL;
+      return false;
+    }
+    c->next      = slab->chunks;
+    slab->chunks = c;
+    /* hand them out in address order */
+    for (i = TUBE_SLAB_CHUNK - 1; i >= 0; i--)
+    {
+      c->tubes[i].next_free = slab->free;
+      slab->free            = &c->tubes[i];
+    }
+  }
+
+  ret        = slab->free;
+  slab->free = ret->next_free;
+  slab->live++;
+
+  memset( ret, 0, sizeof(*ret) );
+  memcpy(ret->hdr.magic, SpudMagicCookie, SPUD_MAGIC_COOKIE_SIZE);
+  ret->sock  = -1;
+  ret->state = TS_UNKNOWN;
+  ret->slab  = slab;
+  *t         = ret;
+  return true;
+}
+
 LS_API bool
 tube_create(tube**  t,
             ls_err* err)
@@ -45,6 +175,7 @@ tube_create(tube**  t,
     *t = NULL;
     return false;
   }
+  memcpy(ret->hdr.magic, SpudMagicCookie, SPUD_MAGIC_COOKIE_SIZE);
   ret->sock  = -1;
   ret->state = TS_UNKNOWN;
   *t         = ret;
@@ -54,9 +185,15 @@ tube_create(tube**  t,
 LS_API void
 tube_destroy(tube* t)
 {
-  if (t->pktinfo)
+  tube_slab* slab = t->slab;
+
+  if (slab)
   {
-    ls_pktinfo_destroy(t->pktinfo);
+    /* most recently freed goes out first, while it's still in cache */
+    t->next_free = slab->free;
+    slab->free   = t;
+    slab->live--;
+    return;
   }
   ls_data_free(t);
 }
@@ -108,7 +245,7 @@ tube_print(const tube* t,
 
   ls_log(LS_LOG_INFO,
          "TUBE %s: %s->%s",
-         spud_id_to_string(id_buf, sizeof(id_buf), &t->id),
+         spud_id_to_string(id_buf, sizeof(id_buf), &t->hdr.tube_id),
          local, remote);
   return true;
 }
@@ -119,12 +256,15 @@ tube_set_local(tube*       t,
                ls_err*     err)
 {
   assert(t);
+  UNUSED_PARAM(err);
   if (!info)
   {
     t->pktinfo = NULL;
     return true;
   }
-  return ls_pktinfo_dup(info, &t->pktinfo, err);
+  t->local   = *info;
+  t->pktinfo = &t->local;
+  return true;
 }
 
 LS_API bool
@@ -138,21 +278,23 @@ tube_send(tube*        t,
           ls_err*      err)
 {
   spud_header   smh;
+  struct iovec  stack_iov[SEND_IOV];
+  struct iovec* iov = stack_iov;
   int           i, count;
-  struct iovec* iov;
   bool          ret;
 
   assert(t != NULL);
-  iov = ls_data_calloc( num + 1, sizeof(struct iovec) );
-  if (!iov)
-  {
-    LS_ERROR(err, LS_ERR_NO_MEMORY);
-    return false;
-  }
-  if ( !spud_init(&smh, &t->id, err) )
+  if (num + 1 > SEND_IOV)
   {
-    return false;
+    iov = ls_data_calloc( num + 1, sizeof(struct iovec) );
+    if (!iov)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      return false;
+    }
   }
+  /* a copy, so that sends from other threads don't trip over each other */
+  smh        = t->hdr;
   smh.flags  = 0;
   smh.flags |= cmd;
   if (adec)
@@ -177,14 +319,77 @@ tube_send(tube*        t,
       count++;
     }
   }
-  ret = tube_manager_sendmsg(t->sock,
-                             t->pktinfo, (struct sockaddr*)&t->peer,
-                             iov, count,
-                             err);
-  ls_data_free(iov);
+  ret = tube_manager_send(t->mgr,
+                          t->sock,
+                          t->pktinfo, (struct sockaddr*)&t->peer,
+                          iov, count,
+                          err);
+  if (iov != stack_iov)
+  {
+    ls_data_free(iov);
+  }
   return ret;
 }
 
+/* Write the shortest CBOR head for major type mt and argument val into */
+/* buf, which must have room for CBOR_HEAD_MAX bytes.  Returns the number */
+/* of bytes written. */
+static size_t
+_cbor_head(uint8_t* buf,
+           uint8_t  mt,
+           uint64_t val)
+{
+  size_t n, i;
+
+  if (val < 24)
+  {
+    buf[0] = mt | (uint8_t)val;
+    return 1;
+  }
+  if (val <= UINT8_MAX)
+  {
+    buf[0] = mt | 24;
+    n      = 1;
+  }
+  else if (val <= UINT16_MAX)
+  {
+    buf[0] = mt | 25;
+    n      = 2;
+  }
+  else if (val <= UINT32_MAX)
+  {
+    buf[0] = mt | 26;
+    n      = 4;
+  }
+  else
+  {
+    buf[0] = mt | 27;
+    n      = 8;
+  }
+  /* network byte order */
+  for (i = n; i > 0; i--)
+  {
+    buf[i] = val & 0xff;
+    val  >>= 8;
+  }
+  return n + 1;
+}
+
+/* The CBOR that goes in front of len bytes of application data, for it to */
+/* come out as {0: h'...'}.  buf must have room for DATA_PREAMBLE_MAX */
+/* bytes.  Returns the number of bytes written. */
+static size_t
+_data_preamble(uint8_t* buf,
+               size_t   len)
+{
+  size_t sz;
+
+  sz  = _cbor_head(buf, CBOR_MT_MAP, 1);
+  sz += _cbor_head(buf + sz, CBOR_MT_UINT, 0);
+  sz += _cbor_head(buf + sz, CBOR_MT_BYTES, len);
+  return sz;
+}
+
 static void*
 _pool_calloc(size_t count,
              size_t size,
@@ -327,6 +532,61 @@ tube_send_pdec(tube*    t,
   return tube_send_cbor(t, SPUD_DATA, reflect, true, cbor, err);
 }
 
+/* The fixed part of a path declaration, encoded at build time: the head of */
+/* a map of three, then each key.  Only the head of the value that goes */
+/* with each key changes from one packet to the next. */
+static const struct
+{
+  uint8_t mt;
+  uint8_t len;
+  uint8_t cbor[PDEC_KEY_MAX];
+} _pdec_keys[PDEC_KEYS] = {
+  { CBOR_MT_BYTES, 8,
+    { CBOR_MT_MAP | 3, CBOR_MT_TEXT | 6, 'i', 'p', 'a', 'd', 'd', 'r' } },
+  { CBOR_MT_BYTES, 6,
+    { CBOR_MT_TEXT | 5, 't', 'o', 'k', 'e', 'n' } },
+  { CBOR_MT_TEXT,  4,
+    { CBOR_MT_TEXT | 3, 'u', 'r', 'l' } }
+};
+
+LS_API bool
+tube_send_path_mandatory_keys(tube*          t,
+                              const uint8_t* ipaddr,
+                              size_t         iplen,
+                              const uint8_t* token,
+                              size_t         tokenlen,
+                              const char*    url,
+                              bool           reflect,
+                              ls_err*        err)
+{
+  uint8_t  pre[PDEC_KEYS][PDEC_KEY_MAX + CBOR_HEAD_MAX];
+  uint8_t* d[2 * PDEC_KEYS];
+  size_t   l[2 * PDEC_KEYS];
+  int      i;
+
+  assert(t);
+  assert(ipaddr);
+  assert(token);
+  assert(url);
+
+  /* the values go out from where they are */
+  d[1] = (uint8_t*)ipaddr;
+  l[1] = iplen;
+  d[3] = (uint8_t*)token;
+  l[3] = tokenlen;
+  d[5] = (uint8_t*)url;
+  l[5] = strlen(url);
+  for (i = 0; i < PDEC_KEYS; i++)
+  {
+    memcpy(pre[i], _pdec_keys[i].cbor, _pdec_keys[i].len);
+    d[2 * i] = pre[i];
+    l[2 * i] = _pdec_keys[i].len +
+               _cbor_head(pre[i] + _pdec_keys[i].len,
+                          _pdec_keys[i].mt, l[2 * i + 1]);
+  }
+  return tube_send(t, SPUD_DATA, reflect, true, d, l, 2 * PDEC_KEYS, err);
+}
+
 LS_API bool
 tube_send_cbor(tube*        t,
                spud_command cmd,
@@ -360,13 +620,9 @@ tube_data(tube*    t,
           size_t   len,
           ls_err*  err)
 {
-  /* max size for CBOR preamble 19 bytes: */
-  /* 1(map|27) 8(length) 1(key:0) 1(bstr|27) 8(length) */
-  /* uint8_t preamble[19]; */
-  cn_cbor*        map;
-  cn_cbor*        cdata;
-  bool            ret = false;
-  cn_cbor_context ctx;
+  uint8_t  preamble[DATA_PREAMBLE_MAX];
+  uint8_t* d[2];
+  size_t   l[2];
 
   assert(t);
   if (len == 0)
@@ -374,24 +630,126 @@ tube_data(tube*    t,
     return tube_send(t, SPUD_DATA, false, false, NULL, 0, 0, err);
   }
 
-  if ( !_map_create(&ctx, &map, err) )
+  /* the application's bytes go out from where they are, after just enough */
+  /* CBOR to make a map of them */
+  d[0] = preamble;
+  l[0] = _data_preamble(preamble, len);
+  d[1] = data;
+  l[1] = len;
+  return tube_send(t, SPUD_DATA, false, false, d, l, 2, err);
+}
+
+LS_API bool
+tube_data_burst(tube*     t,
+                uint8_t** data,
+                size_t*   len,
+                size_t    num,
+                ls_err*   err)
+{
+  spud_header smh;
+  uint8_t     scratch[DATA_PREAMBLE_MAX];
+  uint8_t*    buf;
+  size_t      start = 0;
+  size_t      off   = 0;
+  size_t      seg   = 0;
+  size_t      dlen;
+  size_t      i;
+
+  assert(t);
+  if (num == 0)
+  {
+    return true;
+  }
+  assert(data);
+  assert(len);
+
+  /* all or nothing: don't send the first few and then find one too big */
+  for (i = 0; i < num; i++)
+  {
+    if ( (len[i] > 0) &&
+         ( len[i] > MAXBUFLEN - sizeof(smh) -
+           _data_preamble(scratch, len[i]) ) )
+    {
+      LS_ERROR(err, LS_ERR_OVERFLOW);
+      return false;
+    }
+  }
+
+  if (t->mgr)
+  {
+    buf = _tube_manager_burst_buf(t->mgr, BURST_BUFLEN, err);
+  }
+  else
+  {
+    buf = ls_data_malloc(BURST_BUFLEN);
+    if (!buf)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+    }
+  }
+  if (!buf)
   {
     return false;
   }
 
-  /* TODO: the whole point of the iov system is so that we don't have to copy */
-  /* the data here.  Which we just did.  Please fix. */
-  if ( !( cdata = cn_cbor_data_create(data, len, &ctx, NULL) ) ||
-       !cn_cbor_mapput_int(map, 0, cdata, &ctx, NULL) )
+  smh       = t->hdr;
+  smh.flags = SPUD_DATA;
+  for (i = 0; i < num; i++)
   {
-    LS_ERROR(err, LS_ERR_NO_MEMORY);
-    goto cleanup;
+    if (BURST_BUFLEN - off < MAXBUFLEN)
+    {
+      if ( !tube_manager_send_segments(t->mgr, t->sock, t->pktinfo,
+                                       (struct sockaddr*)&t->peer,
+                                       buf + start, off - start, seg, err) )
+      {
+        goto error;
+      }
+      start = 0;
+      off   = 0;
+      seg   = 0;
+    }
+
+    memcpy( buf + off, &smh, sizeof(smh) );
+    dlen = sizeof(smh);
+    if (len[i] > 0)
+    {
+      dlen += _data_preamble(buf + off + dlen, len[i]);
+      memcpy(buf + off + dlen, data[i], len[i]);
+      dlen += len[i];
+    }
+
+    /* a datagram of a different size starts a new run */
+    if ( seg && (dlen != seg) )
+    {
+      if ( !tube_manager_send_segments(t->mgr, t->sock, t->pktinfo,
+                                       (struct sockaddr*)&t->peer,
+                                       buf + start, off - start, seg, err) )
+      {
+        goto error;
+      }
+      start = off;
+    }
+    seg  = dlen;
+    off += dlen;
   }
-  ret = tube_send_cbor(t, SPUD_DATA, false, false, map, err);
+  if ( !tube_manager_send_segments(t->mgr, t->sock, t->pktinfo,
+                                   (struct sockaddr*)&t->peer,
+                                   buf + start, off - start, seg, err) )
+  {
+    goto error;
+  }
+  if (!t->mgr)
+  {
+    ls_data_free(buf);
+  }
+  return true;
 
-cleanup:
-  ls_pool_destroy( (ls_pool*)ctx.context );
-  return ret;
+error:
+  if (!t->mgr)
+  {
+    ls_data_free(buf);
+  }
+  return false;
 }
 
 LS_API bool
@@ -428,7 +786,7 @@ tube_id_to_string(tube*  t,
                   size_t len)
 {
   assert(t);
-  return spud_id_to_string(buf, len, &t->id);
+  return spud_id_to_string(buf, len, &t->hdr.tube_id);
 }
 
 LS_API tube_states_t
@@ -451,7 +809,7 @@ tube_get_id(tube*          t,
             spud_tube_id** id)
 {
   assert(t);
-  *id = &t->id;
+  *id = &t->hdr.tube_id;
 }
 
 LS_API void
@@ -471,6 +829,21 @@ tube_set_info(tube*                  t,
   }
   if (id)
   {
-    spud_copy_id(id, &t->id);
+    spud_copy_id(id, &t->hdr.tube_id);
   }
 }
+
+LS_API void
+tube_set_manager(tube*         t,
+                 tube_manager* mgr)
+{
+  assert(t);
+  t->mgr = mgr;
+}
+
+LS_API tube_manager*
+tube_get_manager(tube* t)
+{
+  assert(t);
+  return t->mgr;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include "tube_cookie.h"
+
+#define COOKIE_KEY "cookie"
+
+/* {"cookie": h'...'} up to the start of the eight bytes: map(1), the key */
+/* as text(6), bstr(8) */
+static const uint8_t _cookie_prefix[] = {
+  0xa1, 0x66, 'c', 'o', 'o', 'k', 'i', 'e', 0x48
+};
+
+/* tube ID, slot, port, and an IPv6 address at most */
+#define MAC_INPUT_MAX (SPUD_TUBE_ID_SIZE + 8 + 2 + 16)
+
+#define ROTL(x, b) (uint64_t)( ( (x) << (b) ) | ( (x) >> (64 - (b) ) ) )
+
+#define SIPROUND \
+  do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+  } while (0)
+
+static uint64_t
+_get64le(const uint8_t* p)
+{
+  uint64_t v = 0;
+  int      i;
+
+  for (i = 7; i >= 0; i--)
+  {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+/* SipHash-2-4 */
+static uint64_t
+_siphash(const tube_cookie_key* key,
+         const uint8_t*         in,
+         size_t                 len)
+{
+  uint64_t v0 = UINT64_C(0x736f6d6570736575) ^ key->k[0];
+  uint64_t v1 = UINT64_C(0x646f72616e646f6d) ^ key->k[1];
+  uint64_t v2 = UINT64_C(0x6c7967656e657261) ^ key->k[0];
+  uint64_t v3 = UINT64_C(0x7465646279746573) ^ key->k[1];
+  uint64_t b  = (uint64_t)len << 56;
+  uint64_t m;
+  size_t   left = len & 7;
+  size_t   i;
+
+  for (i = 0; i + 8 <= len; i += 8)
+  {
+    m   = _get64le(in + i);
+    v3 ^= m;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= m;
+  }
+  for (; left > 0; left--)
+  {
+    b |= (uint64_t)in[i + left - 1] << ( 8 * (left - 1) );
+  }
+  v3 ^= b;
+  SIPROUND;
+  SIPROUND;
+  v0 ^= b;
+
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static uint64_t
+_mac(const tube_cookie_key* key,
+     const spud_tube_id*    id,
+     const struct sockaddr* peer,
+     uint64_t               slot)
+{
+  uint8_t                    in[MAC_INPUT_MAX];
+  size_t                     len = 0;
+  int                        i;
+  const struct sockaddr_in*  sin;
+  const struct sockaddr_in6* sin6;
+
+  memcpy(in, id->octet, SPUD_TUBE_ID_SIZE);
+  len += SPUD_TUBE_ID_SIZE;
+  for (i = 0; i < 8; i++)
+  {
+    in[len++] = (uint8_t)(slot >> (8 * i) );
+  }
+  switch (peer->sa_family)
+  {
+  case AF_INET:
+    sin = (const struct sockaddr_in*)peer;
+    memcpy( in + len, &sin->sin_port, sizeof(sin->sin_port) );
+    len += sizeof(sin->sin_port);
+    memcpy( in + len, &sin->sin_addr, sizeof(sin->sin_addr) );
+    len += sizeof(sin->sin_addr);
+    break;
+  case AF_INET6:
+    sin6 = (const struct sockaddr_in6*)peer;
+    memcpy( in + len, &sin6->sin6_port, sizeof(sin6->sin6_port) );
+    len += sizeof(sin6->sin6_port);
+    memcpy( in + len, &sin6->sin6_addr, sizeof(sin6->sin6_addr) );
+    len += sizeof(sin6->sin6_addr);
+    break;
+  default:
+    /* just the ID and time, then */
+    break;
+  }
+  return _siphash(key, in, len);
+}
+
+LS_API bool
+tube_cookie_key_init(tube_cookie_key* key,
+                     ls_err*          err)
+{
+  spud_tube_id r[2];
+
+  assert(key);
+  /* tube IDs are 64 random bits each */
+  if ( !spud_create_ids(r, 2, err) )
+  {
+    return false;
+  }
+  key->k[0] = _get64le(r[0].octet);
+  key->k[1] = _get64le(r[1].octet);
+  return true;
+}
+
+LS_API uint64_t
+tube_cookie_make(const tube_cookie_key* key,
+                 const spud_tube_id*    id,
+                 const struct sockaddr* peer,
+                 uint64_t               now)
+{
+  assert(key);
+  assert(id);
+  assert(peer);
+  return _mac(key, id, peer, now / TUBE_COOKIE_SLOT_NS);
+}
+
+LS_API bool
+tube_cookie_check(const tube_cookie_key* key,
+                  const spud_tube_id*    id,
+                  const struct sockaddr* peer,
+                  uint64_t               now,
+                  uint64_t               cookie)
+{
+  uint64_t slot;
+
+  assert(key);
+  assert(id);
+  assert(peer);
+  slot = now / TUBE_COOKIE_SLOT_NS;
+  if (_mac(key, id, peer, slot) == cookie)
+  {
+    return true;
+  }
+  return (slot > 0) && (_mac(key, id, peer, slot - 1) == cookie);
+}
+
+LS_API void
+tube_cookie_encode(uint64_t cookie,
+                   uint8_t* buf)
+{
+  int i;
+
+  assert(buf);
+  memcpy( buf, _cookie_prefix, sizeof(_cookie_prefix) );
+  for (i = 0; i < 8; i++)
+  {
+    buf[sizeof(_cookie_prefix) + i] = (uint8_t)(cookie >> ( 8 * (7 - i) ) );
+  }
+}
+
+LS_API bool
+tube_cookie_decode(const cn_cbor* cbor,
+                   uint64_t*      cookie)
+{
+  const cn_cbor* c;
+  uint64_t       v = 0;
+  int            i;
+
+  assert(cookie);
+  if ( !cbor || (cbor->type != CN_CBOR_MAP) )
+  {
+    return false;
+  }
+  c = cn_cbor_mapget_string(cbor, COOKIE_KEY);
+  if ( !c || (c->type != CN_CBOR_BYTES) || (c->length != 8) )
+  {
+    return false;
+  }
+  for (i = 0; i < 8; i++)
+  {
+    v = (v << 8) | c->v.bytes[i];
+  }
+  *cookie = v;
+  return true;
+}
@@ -0,0 +1,109 @@
+/**
+ * \file
+ * \brief
+ * Stateless OPEN validation.  A responder answers an OPEN for an unknown
+ * tube with an ACK carrying a cookie: a keyed MAC (SipHash-2-4) over the
+ * tube ID, the peer's address and a coarse time slot.  Nothing is kept
+ * about the OPEN; the tube is only created once the peer echoes a cookie
+ * that checks out, which a spoofed source never sees.
+ * private, not for use outside library and unit tests.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "ls_basics.h"
+#include "ls_error.h"
+#include "ls_timer.h"
+#include "spud.h"
+
+/** How long each time slot is.  A cookie is good for the rest of the slot
+ * it was made in, and all of the next one. */
+#define TUBE_COOKIE_SLOT_NS (8 * LS_NS_PER_SEC)
+
+/** Size of a cookie as CBOR: {"cookie": h'<8 bytes>'} */
+#define TUBE_COOKIE_CBOR_SIZE 17
+
+/** The secret cookies are made with */
+typedef struct _tube_cookie_key
+{
+  /** SipHash key */
+  uint64_t k[2];
+} tube_cookie_key;
+
+/**
+ * Pick a new random key.  Cookies made with the old one no longer check.
+ *
+ * \invariant key != NULL
+ * \param[out] key The key
+ * \param[out] err If non-NULL on input, contains error if false is returned
+ * \return true: set.  false: see err.
+ */
+LS_API bool
+tube_cookie_key_init(tube_cookie_key* key,
+                     ls_err*          err);
+
+/**
+ * Make the cookie for an OPEN.
+ *
+ * \invariant key != NULL
+ * \invariant id != NULL
+ * \invariant peer != NULL
+ * \param[in] key  The secret
+ * \param[in] id   The tube ID from the OPEN
+ * \param[in] peer Where the OPEN came from
+ * \param[in] now  Monotonic nanoseconds
+ * \return The cookie
+ */
+LS_API uint64_t
+tube_cookie_make(const tube_cookie_key* key,
+                 const spud_tube_id*    id,
+                 const struct sockaddr* peer,
+                 uint64_t               now);
+
+/**
+ * Is this a cookie we made recently, for this tube and peer?
+ *
+ * \invariant key != NULL
+ * \invariant id != NULL
+ * \invariant peer != NULL
+ * \param[in] key    The secret
+ * \param[in] id     The tube ID from the packet
+ * \param[in] peer   Where the packet came from
+ * \param[in] now    Monotonic nanoseconds
+ * \param[in] cookie The cookie from the packet
+ * \return true if it checks out
+ */
+LS_API bool
+tube_cookie_check(const tube_cookie_key* key,
+                  const spud_tube_id*    id,
+                  const struct sockaddr* peer,
+                  uint64_t               now,
+                  uint64_t               cookie);
+
+/**
+ * Encode a cookie as the CBOR body of an ACK.
+ *
+ * \invariant buf != NULL
+ * \param[in]  cookie The cookie
+ * \param[out] buf    Room for TUBE_COOKIE_CBOR_SIZE bytes
+ */
+LS_API void
+tube_cookie_encode(uint64_t cookie,
+                   uint8_t* buf);
+
+/**
+ * Find the cookie in the CBOR body of an ACK.
+ *
+ * \invariant cookie != NULL
+ * \param[in]  cbor   The decoded body, or NULL if there wasn't one
+ * \param[out] cookie The cookie
+ * \return true if there was one
+ */
+LS_API bool
+tube_cookie_decode(const cn_cbor* cbor,
+                   uint64_t*      cookie);
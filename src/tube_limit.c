@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include "tube_limit.h"
+#include "ls_mem.h"
+#include "ls_timer.h"
+#include "spud.h"
+
+/* Buckets in each row; a power of two */
+#define WIDTH 4096
+#define ROWS  2
+
+struct _tube_limit
+{
+  /* when each bucket will next be full, in now's terms */
+  uint64_t full[ROWS][WIDTH];
+  uint64_t seed[ROWS];
+  /* nanoseconds per token */
+  uint64_t interval;
+  /* how far ahead of now a bucket may be full and still have a token */
+  uint64_t tolerance;
+};
+
+static inline size_t
+_bucket(uint64_t seed,
+        uint64_t k)
+{
+  k ^= seed;
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return (size_t)k & (WIDTH - 1);
+}
+
+/* An IPv4 /24, with the family above it */
+static uint64_t
+_prefix4(const uint8_t* a)
+{
+  return ( (uint64_t)AF_INET << 32 ) |
+         ( (uint64_t)a[0] << 16 ) | ( (uint64_t)a[1] << 8 ) | a[2];
+}
+
+/* The source's prefix, as a number */
+static uint64_t
+_prefix(const struct sockaddr* src)
+{
+  const struct sockaddr_in*  sin;
+  const struct sockaddr_in6* sin6;
+  uint64_t                   k = 0;
+  int                        i;
+
+  switch (src->sa_family)
+  {
+  case AF_INET:
+    sin = (const struct sockaddr_in*)src;
+    k   = _prefix4( (const uint8_t*)&sin->sin_addr );
+    break;
+  case AF_INET6:
+    sin6 = (const struct sockaddr_in6*)src;
+    if ( IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr) )
+    {
+      /* the same as the IPv4 address would be */
+      k = _prefix4(&sin6->sin6_addr.s6_addr[12]);
+      break;
+    }
+    for (i = 0; i < 8; i++)
+    {
+      k = (k << 8) | sin6->sin6_addr.s6_addr[i];
+    }
+    break;
+  default:
+    break;
+  }
+  return k;
+}
+
+LS_API bool
+tube_limit_create(uint32_t     rate,
+                  uint32_t     burst,
+                  tube_limit** lim,
+                  ls_err*      err)
+{
+  tube_limit*  ret;
+  spud_tube_id seed[ROWS];
+  int          i;
+
+  assert(rate > 0);
+  assert(burst > 0);
+  assert(lim);
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  /* random, so that nobody can pick addresses that land together */
+  if ( !spud_create_ids(seed, ROWS, err) )
+  {
+    ls_data_free(ret);
+    return false;
+  }
+  for (i = 0; i < ROWS; i++)
+  {
+    memcpy( &ret->seed[i], seed[i].octet, sizeof(ret->seed[i]) );
+  }
+  ret->interval  = LS_NS_PER_SEC / rate;
+  ret->tolerance = ret->interval * (burst - 1);
+  *lim           = ret;
+  return true;
+}
+
+LS_API void
+tube_limit_destroy(tube_limit* lim)
+{
+  ls_data_free(lim);
+}
+
+LS_API bool
+tube_limit_admit(tube_limit*            lim,
+                 const struct sockaddr* src,
+                 uint64_t               now)
+{
+  uint64_t* b[ROWS];
+  uint64_t  k;
+  int       i;
+
+  assert(lim);
+  assert(src);
+  k = _prefix(src);
+  for (i = 0; i < ROWS; i++)
+  {
+    b[i] = &lim->full[i][_bucket(lim->seed[i], k)];
+    if (*b[i] > now + lim->tolerance)
+    {
+      /* empty */
+      return false;
+    }
+  }
+  for (i = 0; i < ROWS; i++)
+  {
+    *b[i] = (*b[i] > now ? *b[i] : now) + lim->interval;
+  }
+  return true;
+}
@@ -0,0 +1,69 @@
+/**
+ * \file
+ * \brief
+ * Per-source rate limit in fixed memory.  Sources are grouped by prefix
+ * (/24 for IPv4, /64 for IPv6) and hashed into each of two rows of token
+ * buckets, count-min sketch style: a packet is let through only if every
+ * bucket it lands in has a token, so a quiet source is only held back if
+ * it collides with a busy one in both rows.  Each bucket is kept as the
+ * time at which it will next be full, so taking a token is one compare
+ * and one store per row, and nothing is ever allocated per source.
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "ls_basics.h"
+#include "ls_error.h"
+
+/** A rate limit */
+typedef struct _tube_limit tube_limit;
+
+/**
+ * Create a rate limit.
+ *
+ * \invariant rate > 0
+ * \invariant burst > 0
+ * \invariant lim != NULL
+ * \param[in]  rate  Tokens per second for each source prefix
+ * \param[in]  burst How many tokens a prefix can save up
+ * \param[out] lim   The created limit
+ * \param[out] err   If non-NULL on input, contains error if false is
+ *                   returned
+ * \return true: created.  false: see err.
+ */
+LS_API bool
+tube_limit_create(uint32_t     rate,
+                  uint32_t     burst,
+                  tube_limit** lim,
+                  ls_err*      err);
+
+/**
+ * Destroy a rate limit.
+ *
+ * \param[in] lim The limit to destroy.  NULL is a no-op.
+ */
+LS_API void
+tube_limit_destroy(tube_limit* lim);
+
+/**
+ * Take a token for a source, if it has one.
+ *
+ * \invariant lim != NULL
+ * \invariant src != NULL
+ * \param[in] lim The limit
+ * \param[in] src Where the packet came from
+ * \param[in] now Monotonic nanoseconds; must not go backwards
+ * \return true to let the packet through, false to drop it
+ */
+LS_API bool
+tube_limit_admit(tube_limit*            lim,
+                 const struct sockaddr* src,
+                 uint64_t               now);
@@ -2,34 +2,173 @@
  * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
  */
 
+#ifdef __linux__
+/* needed for recvmmsg */
+#define _GNU_SOURCE 1
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <string.h>
+#include <netinet/udp.h>
+
+#include "config.h"
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#define TUBE_HAVE_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 #include "tube.h"
 #include "ls_eventing.h"
-#include "ls_htable.h"
 #include "ls_log.h"
 #include "ls_sockaddr.h"
 
 #include "tube_manager_int.h"
-
-#define GHEAP_MALLOC ls_data_malloc
-#define GHEAP_FREE ls_data_free
-#include "../vendor/gheap/gpriority_queue.h"
-
-#define DEFAULT_HASH_SIZE 65521
+#include "tube_uring.h"
+#include "ls_mpsc.h"
+#include "ls_timer_heap.h"
+#include "ls_timer_int.h"
+#include "ls_timer_wheel.h"
+
+#define DEFAULT_TABLE_SIZE 65521
+/* Byte sent down the pipe when work is posted to an idle loop */
+#define WAKE_POST -3
+/* Page size for the pool that received CBOR is decoded into.  A packet */
+/* that fills it just adds another page. */
+#define PARSE_POOL_SIZE 4096
 #define MAXBUFLEN 1500
+/* Receive buffer size with UDP_GRO on: big enough for any super-datagram */
+/* the kernel might hand up. */
+#define GRO_BUFLEN 65535
+/* Data batch entries to start with; the arrays double when a receive */
+/* brings in more. */
+#define DATA_BATCH_SIZE 64
+/* How often counts of suppressed log messages are written out */
+#define LOG_FLUSH_NS (10 * LS_NS_PER_SEC)
+#define MCTL_SIZE ( CMSG_SPACE( sizeof(struct in6_pktinfo) ) + \
+                    CMSG_SPACE( sizeof(int) ) )
+
+/* bits in mgr->ready */
+#define READY_V6 0x01
+#define READY_V4 0x02
+/* With edge-triggered I/O, sockets stay ready until they return EAGAIN.  */
+/* Check for other events (like the pipe) at least this often while that */
+/* is happening. */
+#define READY_POLL_INTERVAL 64
+/* Submission queue size for io_uring, which is also the number of sends */
+/* that can be in flight before falling back to sendmsg. */
+#define URING_ENTRIES 256
+/* Most bytes that can go to UDP GSO in one sendmsg, leaving room for the */
+/* UDP and IPv6 headers in a 64k super-packet. */
+#define GSO_MAX_BYTES 65000
 
 #ifndef MAX
 #define MAX(a,b) ( ( (a) > (b) ) ? (a) : (b) )
 #endif
 
+#if !defined(HAVE_RECVMMSG) && !defined(HAVE_SENDMMSG)
+struct mmsghdr
+{
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;
+};
+#endif
+
+/* Receive state for one datagram of a batch.  msg_hdr in the matching */
+/* mgr->rx_msgs entry points into this. */
+typedef struct _tube_recv_slot
+{
+  struct sockaddr_storage addr;
+  struct iovec            iov;
+  ls_pktinfo*             info;
+  uint8_t                 mctl[MCTL_SIZE];
+  uint8_t*                buf;
+  size_t                  buf_len;
+} tube_recv_slot;
+
+/* Where a batched data packet came from.  A receive slot may be reused */
+/* before the batch is delivered, so the address is copied out. */
+typedef struct _tube_peer
+{
+  struct sockaddr_storage addr;
+} tube_peer;
+
+/* A queued datagram, copied out of the caller's buffers.  msg_hdr in the */
+/* matching mgr->tx_msgs entry points into this. */
+typedef struct _tube_send_slot
+{
+  int                     sock;
+  struct sockaddr_storage addr;
+  struct iovec            iov;
+  uint8_t                 mctl[CMSG_SPACE( sizeof(struct in6_pktinfo) )];
+  uint8_t                 buf[MAXBUFLEN];
+} tube_send_slot;
+
 static tube_sendmsg_func _sendmsg_func = sendmsg;
 static tube_recvmsg_func _recvmsg_func = recvmsg;
 
+#ifdef HAVE_RECVMMSG
+static tube_recvmmsg_func _recvmmsg_func = recvmmsg;
+#else
+static int
+_recvmmsg_fallback(int              sock,
+                   struct mmsghdr*  msgvec,
+                   unsigned int     vlen,
+                   int              flags,
+                   struct timespec* timeout)
+{
+  unsigned int i;
+  ssize_t      n;
+  UNUSED_PARAM(timeout);
+
+  for (i = 0; i < vlen; i++)
+  {
+    n = _recvmsg_func(sock, &msgvec[i].msg_hdr, flags);
+    if (n < 0)
+    {
+      /* hand back what we have; the error will recur on the next read */
+      return (i > 0) ? (int)i : -1;
+    }
+    msgvec[i].msg_len = n;
+  }
+  return vlen;
+}
+
+static tube_recvmmsg_func _recvmmsg_func = _recvmmsg_fallback;
+#endif
+
+#ifdef HAVE_SENDMMSG
+static tube_sendmmsg_func _sendmmsg_func = sendmmsg;
+#else
+static int
+_sendmmsg_fallback(int             sock,
+                   struct mmsghdr* msgvec,
+                   unsigned int    vlen,
+                   int             flags)
+{
+  unsigned int i;
+  ssize_t      n;
+
+  for (i = 0; i < vlen; i++)
+  {
+    n = _sendmsg_func(sock, &msgvec[i].msg_hdr, flags);
+    if (n < 0)
+    {
+      /* report what went; the caller retries from the one that failed */
+      return (i > 0) ? (int)i : -1;
+    }
+    msgvec[i].msg_len = n;
+  }
+  return vlen;
+}
+
+static tube_sendmmsg_func _sendmmsg_func = _sendmmsg_fallback;
+#endif
+
 typedef struct _sig_context {
   int                  sig;
   tube_manager*        mgr;
@@ -39,71 +178,270 @@ typedef struct _sig_context {
 
 static sig_context* sig_contexts = NULL;
 
+typedef enum
+{
+  POST_FUNC,
+  POST_TIMER,
+  POST_CANCEL,
+  POST_RESCHEDULE
+} post_kind;
+
+/* Work handed to the loop thread from elsewhere */
+typedef struct _tube_post
+{
+  /* first, so that a node is its post */
+  ls_mpsc_node   link;
+  post_kind      kind;
+  tube_post_func cb;
+  void*          arg;
+  ls_timer*      tim;
+  unsigned long  ms;
+} tube_post;
+
+static void
+clean_tube(tube* t)
+{
+  ls_err err;
+
+  if (tube_get_state(t) == TS_RUNNING)
+  {
+    if ( !tube_close(t, &err) )
+    {
+      LS_LOG_ERR(err, "tube_close");
+      /* keep going! */
+    }
+  }
+  tube_destroy(t);
+}
+
 static int
-_timer_less(const void* const context,
-            const void* const a,
-            const void* const b)
+clean_walk(void*               user_data,
+           const spud_tube_id* id,
+           tube*               t)
 {
-  UNUSED_PARAM(context);
+  UNUSED_PARAM(user_data);
+  UNUSED_PARAM(id);
+  clean_tube(t);
+  return 1;
+}
+
+/* cn_cbor allocators for decoding received packets into mgr->parse_pool */
+static void*
+_parse_calloc(size_t count,
+              size_t size,
+              void*  context)
+{
+  void* ptr;
 
-  return ls_timer_greater(*(ls_timer**)a, *(ls_timer**)b);
+  if ( !ls_pool_calloc(context, count, size, &ptr, NULL) )
+  {
+    return NULL;
+  }
+  return ptr;
 }
 
 static void
-_timer_move(void* const       dst,
-            const void* const src)
+_parse_free(void* ptr,
+            void* context)
 {
-  ls_timer** dt = (void*)dst;
-  ls_timer** st = (void*)src;
-  *dt = *st;
+  /* everything goes at once, when the pool is reset */
+  UNUSED_PARAM(ptr);
+  UNUSED_PARAM(context);
 }
 
-static void
-_timer_del(void* item)
+static bool
+_io_init(tube_manager*   m,
+         tube_io_backend io,
+         ls_err*         err)
 {
-  ls_timer_destroy(*(ls_timer**)item);
+  if (io == TUBE_IO_DEFAULT)
+  {
+#ifdef TUBE_HAVE_EPOLL
+    io = TUBE_IO_EPOLL;
+#else
+    io = TUBE_IO_SELECT;
+#endif
+  }
+  m->io = io;
+
+  switch (io)
+  {
+  case TUBE_IO_SELECT:
+    return true;
+#ifdef TUBE_HAVE_EPOLL
+  case TUBE_IO_EPOLL:
+  {
+    struct epoll_event ev;
+    m->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m->epfd == -1)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    /* the timers count from CLOCK_MONOTONIC, so they don't jump when the */
+    /* wall clock is set */
+    m->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m->timerfd == -1)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    memset( &ev, 0, sizeof(ev) );
+    ev.events  = EPOLLIN | EPOLLET;
+    ev.data.fd = m->pipe[0];
+    if (epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->pipe[0], &ev) == -1)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    ev.data.fd = m->timerfd;
+    if (epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->timerfd, &ev) == -1)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    return true;
+  }
+#endif
+#ifdef TUBE_HAVE_URING
+  case TUBE_IO_URING:
+    if ( !tube_uring_available() )
+    {
+      LS_ERROR(err, LS_ERR_NO_IMPL);
+      return false;
+    }
+    if ( !tube_uring_create(URING_ENTRIES, &m->uring, err) )
+    {
+      return false;
+    }
+    return tube_uring_watch_poll(m->uring, m->pipe[0], err);
+#endif
+  default:
+    LS_ERROR(err, LS_ERR_NO_IMPL);
+    return false;
+  }
 }
 
-static unsigned int
-hash_id(const void* id)
+/* Start waiting for reads on a new socket */
+static bool
+_io_watch(tube_manager* m,
+          int           fd,
+          ls_err*       err)
 {
-  /* treat the 8 bytes of tube ID like a long long. */
-  uint64_t key = *(uint64_t*)id;
+#ifdef TUBE_HAVE_EPOLL
+  if (m->io == TUBE_IO_EPOLL)
+  {
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof(ev) );
+    ev.events  = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(m->epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    return true;
+  }
+#endif
+#ifdef TUBE_HAVE_URING
+  if (m->io == TUBE_IO_URING)
+  {
+    return tube_uring_watch_recv(m->uring, fd, err);
+  }
+#endif
+  if (fd >= FD_SETSIZE)
+  {
+    LS_ERROR(err, LS_ERR_OVERFLOW);
+    return false;
+  }
+  return true;
+}
 
-  /* from */
-  /* https://gist.github.com/badboy/6267743#64-bit-to-32-bit-hash-functions */
-  key = (~key) + (key << 18);
-  key = key ^ (key >> 31);
-  key = key * 21;
-  key = key ^ (key >> 11);
-  key = key + (key << 6);
-  key = key ^ (key >> 22);
-  return (unsigned int) key;
+/* The socket returned EAGAIN, so wait for the next edge */
+static void
+_io_drained(tube_manager* m,
+            int           fd)
+{
+  if (fd == m->sock6)
+  {
+    m->ready &= ~READY_V6;
+  }
+  else if (fd == m->sock4)
+  {
+    m->ready &= ~READY_V4;
+  }
 }
 
+/* Pick one of the ready sockets, alternating so that neither address */
+/* family starves the other. */
 static int
-compare_id(const void* key1,
-           const void* key2)
+_io_next_ready(tube_manager* m,
+               unsigned int  ready)
 {
-  int      ret = 0;
-  uint64_t k1  = *(uint64_t*)key1;
-  uint64_t k2  = *(uint64_t*)key2;
-  if (k1 < k2)
+  if ( (ready & READY_V6) && (ready & READY_V4) )
   {
-    ret = -1;
+    m->ready_turn = !m->ready_turn;
+    return m->ready_turn ? m->sock4 : m->sock6;
   }
-  else
+  return (ready & READY_V6) ? m->sock6 : m->sock4;
+}
+
+static void
+_io_read_pipe(tube_manager* m)
+{
+  char         b;
+  sig_context* c;
+
+  /* this is non-blocking; drain everything that's there. */
+  while (read(m->pipe[0], &b, 1) == 1)
   {
-    ret = (k1 == k2) ? 0 : 1;
+    for (c = sig_contexts; c; c = c->next)
+    {
+      if (c->sig == b)
+      {
+        c->cb(b);
+      }
+    }
+  }
+}
+
+/* Throw away whatever is still posted, without running it */
+static void
+_drop_posts(tube_manager* mgr)
+{
+  ls_mpsc_node* node = ls_mpsc_take(&mgr->posts);
+  ls_mpsc_node* next;
+  tube_post*    p;
+
+  for (; node; node = next)
+  {
+    next = node->next;
+    p    = (tube_post*)node;
+    if (p->tim)
+    {
+      /* the manager's, for a timer being scheduled; the post's own */
+      /* reference otherwise */
+      ls_timer_destroy(p->tim);
+    }
+    ls_data_free(p);
   }
-  return ret;
+}
+
+/* Read the clock into m->last.  Receive timestamps aren't used for this: */
+/* the kernel takes them from the wall clock, which NTP can step. */
+static bool
+_update_clock(tube_manager* m,
+              ls_err*       err)
+{
+  return ls_time_now_ns(&m->last, err);
 }
 
 /* "friend" functions */
 bool
-_tube_manager_init(tube_manager* m,
-                   int           buckets,
-                   ls_err*       err)
+_tube_manager_init(tube_manager*   m,
+                   int             buckets,
+                   tube_io_backend io,
+                   ls_err*         err)
 {
   m->initialized = false;
   m->sock4       = -1;
@@ -112,19 +450,51 @@ _tube_manager_init(tube_manager* m,
   m->keep_going  = true;
   m->pipe[0]     = -1;
   m->pipe[1]     = -1;
+  m->rx_count    = 0;
+  m->rx_slots    = NULL;
+  m->rx_msgs     = NULL;
+  m->tx_count    = 0;
+  m->tx_len      = 0;
+  m->tx_slots    = NULL;
+  m->tx_msgs     = NULL;
+  m->burst_buf   = NULL;
+  m->epfd        = -1;
+  m->timerfd     = -1;
+  m->timer_armed = false;
+  m->ready       = 0;
+  m->uring       = NULL;
+  m->shard       = 0;
+  m->shards      = 0;
+  m->in_loop     = false;
+  m->gso         = false;
+  m->gro         = false;
+  m->gro_buf     = NULL;
+  m->parse_pool  = NULL;
+  m->tube_slab   = NULL;
+  m->timer_wheel = NULL;
+  m->data_batch  = false;
+  m->batch       = NULL;
+  m->batch_peers = NULL;
+  m->batch_count = 0;
+  m->batch_size  = 0;
+
+  m->open_cookies    = false;
+  m->packet_limit    = NULL;
+  m->open_limit      = NULL;
+  m->packets_limited = 0;
+  m->opens_limited   = 0;
+  m->log_flush_at    = 0;
+
+  m->timer_running = NULL;
+  ls_mpsc_init(&m->posts);
 
   if (buckets <= 0)
   {
-    buckets = DEFAULT_HASH_SIZE;
-  }
-
-  if (pthread_mutex_init(&m->lock, NULL) != 0)
-  {
-    LS_ERROR(err, -errno);
-    goto cleanup;
+    buckets = DEFAULT_TABLE_SIZE;
   }
 
-  if ( !ls_htable_create(buckets, hash_id, compare_id, &m->tubes, err) )
+  if ( !tube_table_create(buckets, &m->tubes, err) ||
+       !tube_slab_create(&m->tube_slab, err) )
   {
     goto cleanup;
   }
@@ -146,6 +516,10 @@ _tube_manager_init(tube_manager* m,
                                          EV_DATA_NAME,
                                          &m->e_data,
                                          err) ||
+       !ls_event_dispatcher_create_event(m->dispatcher,
+                                         EV_DATA_BATCH_NAME,
+                                         &m->e_data_batch,
+                                         err) ||
        !ls_event_dispatcher_create_event(m->dispatcher,
                                          EV_CLOSE_NAME,
                                          &m->e_close,
@@ -162,27 +536,22 @@ _tube_manager_init(tube_manager* m,
     goto cleanup;
   }
 
+  if ( !ls_timer_heap_create(&m->timer_q, err) )
   {
-    static const struct gheap_ctx paged_binary_heap_ctx = {
-      .fanout            = 2,
-      .page_chunks       = 512,
-      .item_size         = sizeof(ls_timer*),
-      .less_comparer     = &_timer_less,
-      .less_comparer_ctx = NULL,
-      .item_mover        = &_timer_move,
-    };
-    m->timer_q = gpriority_queue_create(&paged_binary_heap_ctx, _timer_del);
-    if (!m->timer_q)
-    {
-      LS_ERROR(err, LS_ERR_NO_MEMORY);
-      goto cleanup;
-    }
+    goto cleanup;
   }
 
+  if ( !ls_pool_create(PARSE_POOL_SIZE, &m->parse_pool, err) )
+  {
+    goto cleanup;
+  }
+  m->parse_ctx.calloc_func = _parse_calloc;
+  m->parse_ctx.free_func   = _parse_free;
+  m->parse_ctx.context     = m->parse_pool;
+
   /* Prime the pump to make sure we always have the current time */
-  if (gettimeofday(&m->last, NULL) != 0)
+  if ( !_update_clock(m, err) )
   {
-    LS_ERROR(err, -errno);
     goto cleanup;
   }
 
@@ -211,12 +580,38 @@ _tube_manager_init(tube_manager* m,
       }
     }
   }
+
+  if ( !_io_init(m, io, err) )
+  {
+    goto cleanup;
+  }
   return true;
 cleanup:
   _tube_manager_finalize(m);
   return false;
 }
 
+static void
+_free_recv_slots(tube_recv_slot* slots,
+                 unsigned int    count,
+                 struct mmsghdr* msgs)
+{
+  unsigned int i;
+  if (slots)
+  {
+    for (i = 0; i < count; i++)
+    {
+      if (slots[i].info)
+      {
+        ls_pktinfo_destroy(slots[i].info);
+      }
+      ls_data_free(slots[i].buf);
+    }
+    ls_data_free(slots);
+  }
+  ls_data_free(msgs);
+}
+
 void
 _tube_manager_finalize(tube_manager* mgr)
 {
@@ -228,18 +623,20 @@ _tube_manager_finalize(tube_manager* mgr)
   }
   mgr->initialized = false;
 
-  if (pthread_mutex_destroy(&mgr->lock) != 0)
-  {
-    LS_LOG_PERROR("pthread_mutex_destroy");
-    /* keep destroying */
-  }
+  _drop_posts(mgr);
   if (mgr->tubes)
   {
-    /* will clean, but not send out events. */
+    /* clean, but don't send out events. */
     /* TODO: consider sending events, but not from clean_tube */
-    ls_htable_destroy(mgr->tubes);
+    tube_table_walk(mgr->tubes, clean_walk, NULL);
+    tube_table_destroy(mgr->tubes);
     mgr->tubes = NULL;
   }
+  if (mgr->tube_slab)
+  {
+    tube_slab_destroy(mgr->tube_slab);
+    mgr->tube_slab = NULL;
+  }
   if (mgr->dispatcher)
   {
     ls_event_dispatcher_destroy(mgr->dispatcher);
@@ -247,9 +644,57 @@ _tube_manager_finalize(tube_manager* mgr)
   }
   if (mgr->timer_q)
   {
-    gpriority_queue_delete(mgr->timer_q);
+    ls_timer_heap_destroy(mgr->timer_q);
     mgr->timer_q = NULL;
   }
+  if (mgr->timer_wheel)
+  {
+    ls_timer_wheel_destroy(mgr->timer_wheel);
+    mgr->timer_wheel = NULL;
+  }
+  if (mgr->parse_pool)
+  {
+    ls_pool_destroy(mgr->parse_pool);
+    mgr->parse_pool = NULL;
+  }
+  _free_recv_slots(mgr->rx_slots, mgr->rx_count, mgr->rx_msgs);
+  mgr->rx_slots = NULL;
+  mgr->rx_msgs  = NULL;
+  mgr->rx_count = 0;
+  ls_data_free(mgr->gro_buf);
+  mgr->gro_buf = NULL;
+  ls_data_free(mgr->batch);
+  ls_data_free(mgr->batch_peers);
+  mgr->batch       = NULL;
+  mgr->batch_peers = NULL;
+  mgr->batch_count = 0;
+  mgr->batch_size  = 0;
+  tube_limit_destroy(mgr->packet_limit);
+  tube_limit_destroy(mgr->open_limit);
+  mgr->packet_limit = NULL;
+  mgr->open_limit   = NULL;
+  ls_data_free(mgr->tx_slots);
+  ls_data_free(mgr->tx_msgs);
+  ls_data_free(mgr->burst_buf);
+  mgr->tx_slots  = NULL;
+  mgr->tx_msgs   = NULL;
+  mgr->burst_buf = NULL;
+  mgr->tx_count = 0;
+  mgr->tx_len   = 0;
+  if (mgr->epfd >= 0)
+  {
+    close(mgr->epfd);
+    mgr->epfd = -1;
+  }
+  if (mgr->timerfd >= 0)
+  {
+    close(mgr->timerfd);
+    mgr->timerfd = -1;
+  }
+#ifdef TUBE_HAVE_URING
+  tube_uring_destroy(mgr->uring);
+  mgr->uring = NULL;
+#endif
 }
 
 ls_event_dispatcher*
@@ -259,10 +704,36 @@ _tube_manager_get_dispatcher(tube_manager* mgr)
   return mgr->dispatcher;
 }
 
+uint8_t*
+_tube_manager_burst_buf(tube_manager* mgr,
+                        size_t        size,
+                        ls_err*       err)
+{
+  assert(mgr);
+  if (!mgr->burst_buf)
+  {
+    mgr->burst_buf = ls_data_malloc(size);
+    if (!mgr->burst_buf)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+    }
+  }
+  return mgr->burst_buf;
+}
+
 LS_API bool
 tube_manager_create(int            buckets,
                     tube_manager** m,
                     ls_err*        err)
+{
+  return tube_manager_create_io(buckets, TUBE_IO_DEFAULT, m, err);
+}
+
+LS_API bool
+tube_manager_create_io(int             buckets,
+                       tube_io_backend io,
+                       tube_manager**  m,
+                       ls_err*         err)
 {
   tube_manager* ret = NULL;
   assert(m != NULL);
@@ -273,7 +744,7 @@ tube_manager_create(int            buckets,
     return false;
   }
 
-  if ( !_tube_manager_init(ret, buckets, err) )
+  if ( !_tube_manager_init(ret, buckets, io, err) )
   {
     ls_data_free(ret);
     *m = ret = NULL;
@@ -296,6 +767,13 @@ tube_manager_destroy(tube_manager* mgr)
   ls_data_free(mgr);
 }
 
+LS_API tube_io_backend
+tube_manager_get_io_backend(tube_manager* mgr)
+{
+  assert(mgr);
+  return mgr->io;
+}
+
 LS_API void
 tube_manager_set_data(tube_manager* m,
                       void*         data)
@@ -315,6 +793,60 @@ LS_API bool
 tube_manager_socket(tube_manager* m,
                     int           port,
                     ls_err*       err)
+{
+  return _tube_manager_socket(m, port, false, err);
+}
+
+/* Ask the kernel to hand up coalesced datagrams (or stop) */
+static bool
+_set_gro_sockopt(int     sock,
+                 bool    enable,
+                 ls_err* err)
+{
+#ifdef UDP_GRO
+  const int on = enable ? 1 : 0;
+  if ( (sock >= 0) &&
+       (setsockopt( sock, SOL_UDP, UDP_GRO, &on, sizeof(on) ) != 0) )
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  return true;
+#else
+  UNUSED_PARAM(sock);
+  if (enable)
+  {
+    LS_ERROR(err, LS_ERR_NO_IMPL);
+    return false;
+  }
+  return true;
+#endif
+}
+
+static bool
+_set_reuseport(int     sock,
+               ls_err* err)
+{
+#ifdef SO_REUSEPORT
+  const int on = 1;
+  if (setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on) ) != 0)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  return true;
+#else
+  UNUSED_PARAM(sock);
+  LS_ERROR(err, LS_ERR_NO_IMPL);
+  return false;
+#endif
+}
+
+bool
+_tube_manager_socket(tube_manager* m,
+                     int           port,
+                     bool          reuseport,
+                     ls_err*       err)
 {
   assert(m);
   assert(port >= 0);
@@ -329,6 +861,11 @@ tube_manager_socket(tube_manager* m,
     return false;
   }
 
+  if ( reuseport && !_set_reuseport(m->sock6, err) )
+  {
+    return false;
+  }
+
 #ifdef IPV6_V6ONLY
   {
     /* we're going to have a separate v4 socket */
@@ -353,6 +890,19 @@ tube_manager_socket(tube_manager* m,
     }
   }
 
+  if (reuseport && (port == 0) )
+  {
+    /* everyone sharing the port needs to know what it turned out to be */
+    struct sockaddr_storage addr;
+    socklen_t               len = sizeof(addr);
+    if (getsockname(m->sock6, (struct sockaddr*)&addr, &len) != 0)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    port = ls_sockaddr_get_port( (struct sockaddr*)&addr );
+  }
+
 #ifdef IPV6_RECVPKTINFO
   {
     const int on = 1;
@@ -367,17 +917,13 @@ tube_manager_socket(tube_manager* m,
     #pragma message "No IPV6_RECVPKTINFO.  Destination addresses won't work."
 #endif
 
-#ifdef SO_TIMESTAMP
+#ifdef UDP_SEGMENT
   {
-    const int on = 1;
-    if (setsockopt( m->sock6, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on) ) != 0)
-    {
-      LS_ERROR(err, -errno);
-      return false;
-    }
+    /* the option is only there if the kernel can do UDP GSO */
+    int       seg = 0;
+    socklen_t len = sizeof(seg);
+    m->gso = (getsockopt(m->sock6, SOL_UDP, UDP_SEGMENT, &seg, &len) == 0);
   }
-#else
-    #pragma message "No SO_TIMESTAMP.  Receive timers won't work."
 #endif
 
   {
@@ -395,7 +941,15 @@ tube_manager_socket(tube_manager* m,
     }
   }
   m->max_fd = MAX(m->max_fd, m->sock6);
-
+  if ( m->gro && !_set_gro_sockopt(m->sock6, true, err) )
+  {
+    return false;
+  }
+  if ( !_io_watch(m, m->sock6, err) )
+  {
+    return false;
+  }
+
   m->sock4 = socket(PF_INET, SOCK_DGRAM, 0);
   if (m->sock4 < 0)
   {
@@ -403,6 +957,11 @@ tube_manager_socket(tube_manager* m,
     return false;
   }
 
+  if ( reuseport && !_set_reuseport(m->sock4, err) )
+  {
+    return false;
+  }
+
   {
     struct sockaddr_in addr;
     ls_sockaddr_v4_any(&addr, port);
@@ -428,19 +987,6 @@ tube_manager_socket(tube_manager* m,
     #pragma message "No IP_PKTINFO.  Destination addresses won't work."
 #endif
 
-#ifdef SO_TIMESTAMP
-  {
-    const int on = 1;
-    if (setsockopt( m->sock4, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on) ) != 0)
-    {
-      LS_ERROR(err, -errno);
-      return false;
-    }
-  }
-#else
-    #pragma message "No SO_TIMESTAMP.  Receive timers won't work."
-#endif
-
   {
     int flags = fcntl(m->sock4, F_GETFL, O_NONBLOCK);
     if (flags == -1)
@@ -457,7 +1003,11 @@ tube_manager_socket(tube_manager* m,
   }
 
   m->max_fd = MAX(m->max_fd, m->sock4);
-  return true;
+  if ( m->gro && !_set_gro_sockopt(m->sock4, true, err) )
+  {
+    return false;
+  }
+  return _io_watch(m, m->sock4, err);
 }
 
 LS_API bool
@@ -481,43 +1031,26 @@ tube_manager_bind_event(tube_manager*            mgr,
   return ls_event_bind(ev, cb, mgr, err);
 }
 
-static void
-clean_tube(bool  replace,
-           bool  destroy_key,
-           void* key,
-           void* data)
-{
-  tube*  t = data;
-  ls_err err;
-  UNUSED_PARAM(replace);
-  UNUSED_PARAM(destroy_key);
-  UNUSED_PARAM(key);
-
-  if (tube_get_state(t) == TS_RUNNING)
-  {
-    if ( !tube_close(t, &err) )
-    {
-      LS_LOG_ERR(err, "tube_close");
-      /* keep going! */
-    }
-  }
-  tube_destroy(t);
-}
-
 LS_API bool
 tube_manager_add(tube_manager* mgr,
                  tube*         t,
                  ls_err*       err)
 {
   spud_tube_id* id;
+  tube*         old = NULL;
   assert(mgr);
   assert(t);
 
   tube_get_id(t, &id);
-  if ( !ls_htable_put(mgr->tubes, id, t, clean_tube, err) )
+  if ( !tube_table_put(mgr->tubes, id, t, &old, err) )
   {
     return false;
   }
+  if ( old && (old != t) )
+  {
+    clean_tube(old);
+  }
+  tube_set_manager(t, mgr);
   return ls_event_trigger(mgr->e_add, t, NULL, NULL, err);
 }
 
@@ -536,7 +1069,10 @@ tube_manager_remove(tube_manager* mgr,
   }
 
   tube_get_id(t, &id);
-  ls_htable_remove(mgr->tubes, id);
+  if (tube_table_remove(mgr->tubes, id) == t)
+  {
+    clean_tube(t);
+  }
 }
 
 LS_API bool
@@ -573,31 +1109,240 @@ tube_manager_interrupt(tube_manager* mgr,
   } while (true);
 }
 
+/* Is this the thread running mgr's loop?  Only that thread touches the */
+/* timer queues; everyone else posts. */
+static bool
+_on_loop_thread(tube_manager* mgr)
+{
+  return mgr->in_loop && pthread_equal( mgr->loop_thread, pthread_self() );
+}
+
+static bool
+_post(tube_manager*  mgr,
+      post_kind      kind,
+      tube_post_func cb,
+      void*          arg,
+      ls_timer*      tim,
+      unsigned long  ms,
+      ls_err*        err)
+{
+  tube_post* p = ls_data_malloc( sizeof(*p) );
+
+  if (!p)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  p->kind = kind;
+  p->cb   = cb;
+  p->arg  = arg;
+  p->tim  = tim;
+  p->ms   = ms;
+  if (tim && (kind != POST_TIMER) )
+  {
+    /* the timer may fire and be let go by the loop before this is run */
+    ls_timer_ref(tim);
+  }
+
+  /* the loop drains everything each time around, so it only needs waking */
+  /* for the first post since then */
+  if ( ls_mpsc_push(&mgr->posts, &p->link) )
+  {
+    return tube_manager_interrupt(mgr, WAKE_POST, err);
+  }
+  return true;
+}
+
+/* On the loop thread: queue a timer */
+static bool
+_add_timer(tube_manager* mgr,
+           ls_timer*     tim,
+           ls_err*       err)
+{
+  if (mgr->timer_backend == TUBE_TIMER_WHEEL)
+  {
+    ls_timer_wheel_add(mgr->timer_wheel, tim);
+    return true;
+  }
+  return ls_timer_heap_push(mgr->timer_q, tim, err);
+}
+
+/* On the loop thread: cancel a timer, freeing it if it's queued */
+static void
+_cancel_timer(tube_manager* mgr,
+              ls_timer*     tim)
+{
+  bool removed;
+
+  ls_timer_cancel(tim);
+  if (tim == mgr->timer_running)
+  {
+    /* destroyed once it's done */
+    return;
+  }
+  if (mgr->timer_backend == TUBE_TIMER_WHEEL)
+  {
+    removed = ls_timer_wheel_remove(mgr->timer_wheel, tim);
+  }
+  else
+  {
+    removed = ls_timer_heap_remove(mgr->timer_q, tim);
+  }
+  /* if it wasn't queued, either it's still posted, and will be thrown */
+  /* away when the post is run, or it has fired already */
+  if (removed)
+  {
+    ls_timer_destroy(tim);
+  }
+}
+
+/* On the loop thread: move a queued timer */
+static bool
+_reschedule_timer(tube_manager* mgr,
+                  ls_timer*     tim,
+                  unsigned long ms,
+                  ls_err*       err)
+{
+  if (mgr->timer_backend == TUBE_TIMER_WHEEL)
+  {
+    if ( ls_timer_wheel_remove(mgr->timer_wheel, tim) )
+    {
+      tim->ns = mgr->last + ms * LS_NS_PER_MS;
+      ls_timer_wheel_add(mgr->timer_wheel, tim);
+      return true;
+    }
+  }
+  else if (tim->heap_idx != 0)
+  {
+    /* moves up or down from where it is, rather than leaving and */
+    /* rejoining the heap */
+    tim->ns = mgr->last + ms * LS_NS_PER_MS;
+    ls_timer_heap_update(mgr->timer_q, tim);
+    return true;
+  }
+  LS_ERROR(err, LS_ERR_INVALID_STATE);
+  return false;
+}
+
+/* On the loop thread: run everything posted since last time, in order. */
+/* Returns true if anything ran that might have queued sends. */
+static bool
+_run_posts(tube_manager* mgr)
+{
+  ls_mpsc_node* node = ls_mpsc_take(&mgr->posts);
+  ls_mpsc_node* next;
+  tube_post*    p;
+  ls_err        err;
+  bool          ran = false;
+
+  for (; node; node = next)
+  {
+    next = node->next;
+    p    = (tube_post*)node;
+    switch (p->kind)
+    {
+    case POST_FUNC:
+      p->cb(mgr, p->arg);
+      ran = true;
+      break;
+    case POST_TIMER:
+      if ( ls_timer_is_cancelled(p->tim) )
+      {
+        ls_timer_destroy(p->tim);
+      }
+      else if ( !_add_timer(mgr, p->tim, &err) )
+      {
+        /* nobody is left to tell */
+        LS_LOG_ERR(err, "_add_timer");
+        ls_timer_destroy(p->tim);
+      }
+      break;
+    case POST_CANCEL:
+      _cancel_timer(mgr, p->tim);
+      ls_timer_destroy(p->tim);
+      break;
+    case POST_RESCHEDULE:
+      /* fired already is fine; it raced with firing, and the post's */
+      /* reference kept the timer around to find that out */
+      _reschedule_timer(mgr, p->tim, p->ms, NULL);
+      ls_timer_destroy(p->tim);
+      break;
+    }
+    ls_data_free(p);
+  }
+  return ran;
+}
+
+LS_API bool
+tube_manager_set_timer_backend(tube_manager*      mgr,
+                               tube_timer_backend backend,
+                               ls_err*            err)
+{
+  assert(mgr);
+
+  if ( (backend != TUBE_TIMER_HEAP) && (backend != TUBE_TIMER_WHEEL) )
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+  if ( ( mgr->in_loop && !_on_loop_thread(mgr) ) ||
+       !ls_mpsc_empty(&mgr->posts) ||
+       (ls_timer_heap_count(mgr->timer_q) > 0) ||
+       ( mgr->timer_wheel && (ls_timer_wheel_count(mgr->timer_wheel) > 0) ) )
+  {
+    LS_ERROR(err, LS_ERR_INVALID_STATE);
+    return false;
+  }
+  if ( (backend == TUBE_TIMER_WHEEL) && !mgr->timer_wheel &&
+       !ls_timer_wheel_create(mgr->last, &mgr->timer_wheel, err) )
+  {
+    return false;
+  }
+  mgr->timer_backend = backend;
+  return true;
+}
+
+LS_API bool
+tube_manager_post(tube_manager*  mgr,
+                  tube_post_func cb,
+                  void*          arg,
+                  ls_err*        err)
+{
+  assert(mgr);
+  assert(cb);
+  return _post(mgr, POST_FUNC, cb, arg, NULL, 0, err);
+}
+
 LS_API bool
 tube_manager_cancel_timer(tube_manager* mgr,
                           ls_timer*     tim,
                           ls_err*       err)
 {
   assert(mgr);
-  ls_timer_cancel(tim);
+  assert(tim);
 
-  if (pthread_mutex_lock(&mgr->lock) != 0)
+  if ( _on_loop_thread(mgr) )
   {
-    LS_ERROR(err, -errno);
-    return false;
+    _cancel_timer(mgr, tim);
+    return true;
   }
+  return _post(mgr, POST_CANCEL, NULL, NULL, tim, 0, err);
+}
 
-  /* TODO: no need to do a full heapwalk here.  Should be able to just */
-  /* sift this one up to the top. */
-  gheap_make_heap(mgr->timer_q->ctx, mgr->timer_q->base, mgr->timer_q->size);
+LS_API bool
+tube_manager_reschedule_ms(tube_manager* mgr,
+                           ls_timer*     tim,
+                           unsigned long ms,
+                           ls_err*       err)
+{
+  assert(mgr);
+  assert(tim);
 
-  /* always unlock, if lock worked */
-  if (pthread_mutex_unlock(&mgr->lock) != 0)
+  if ( _on_loop_thread(mgr) )
   {
-    LS_ERROR(err, -errno);
-    return false;
+    return _reschedule_timer(mgr, tim, ms, err);
   }
-  return true;
+  return _post(mgr, POST_RESCHEDULE, NULL, NULL, tim, ms, err);
 }
 
 LS_API bool
@@ -605,27 +1350,14 @@ tube_manager_schedule_timer(tube_manager* mgr,
                             ls_timer*     tim,
                             ls_err*       err)
 {
-  bool ret = true;
   assert(mgr);
   assert(tim);
 
-  if (pthread_mutex_lock(&mgr->lock) != 0)
-  {
-    LS_ERROR(err, -errno);
-    return false;
-  }
-  if ( !gpriority_queue_push(mgr->timer_q, &tim) )
-  {
-    LS_ERROR(err, LS_ERR_NO_MEMORY);
-    ret = false;
-  }
-  /* always unlock, if lock worked */
-  if (pthread_mutex_unlock(&mgr->lock) != 0)
+  if ( _on_loop_thread(mgr) )
   {
-    LS_ERROR(err, -errno);
-    ret = false;
+    return _add_timer(mgr, tim, err);
   }
-  return ret;
+  return _post(mgr, POST_TIMER, NULL, NULL, tim, 0, err);
 }
 
 LS_API bool
@@ -639,7 +1371,8 @@ tube_manager_schedule_ms(tube_manager* mgr,
   ls_timer* ret;
   assert(mgr);
 
-  if ( !ls_timer_create_ms(&mgr->last, ms, cb, context, &ret, err) )
+  if ( !ls_timer_create_ns(mgr->last + ms * LS_NS_PER_MS, cb, context, &ret,
+                           err) )
   {
     return false;
   }
@@ -662,10 +1395,31 @@ tube_manager_schedule(tube_manager*   mgr,
                       ls_timer**      tim,
                       ls_err*         err)
 {
-  ls_timer* ret;
+  struct timespec wall_ts;
+  uint64_t        wall;
+  uint64_t        when;
+  ls_timer*       ret;
   assert(mgr);
+  assert(tv);
+
+  /* timers run on the monotonic clock, so move tv across from the wall */
+  /* clock as of now */
+  if ( !ls_time_now_ns(&when, err) )
+  {
+    return false;
+  }
+  if (clock_gettime(CLOCK_REALTIME, &wall_ts) != 0)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  wall = (uint64_t)wall_ts.tv_sec * LS_NS_PER_SEC + wall_ts.tv_nsec;
+  if (ls_time_from_timeval(tv) > wall)
+  {
+    when += ls_time_from_timeval(tv) - wall;
+  }
 
-  if ( !ls_timer_create(tv, cb, context, &ret, err) )
+  if ( !ls_timer_create_ns(when, cb, context, &ret, err) )
   {
     return false;
   }
@@ -724,75 +1478,165 @@ tube_manager_signal(tube_manager* mgr,
   return true;
 }
 
-static int
-pending_timers(tube_manager*    mgr,
-               struct timeval** tv,
-               ls_err*          err)
+LS_API bool
+tube_manager_flush(tube_manager* mgr,
+                   ls_err*       err)
 {
-  /* returns: */
-  /*   -1 on error */
-  /*   0 with no pending timers */
-  /*   1 with tv filled out */
-  int        ret = -2;
-  ls_timer** tim;
+  bool         ret   = true;
+  unsigned int start = 0;
+  unsigned int end;
+  int          sock;
+  int          n;
 
-  /* while there are still timeouts to process */
-  while ( (ret == -2) && mgr->keep_going )
+  assert(mgr);
+  while (start < mgr->tx_len)
   {
-    if (pthread_mutex_lock(&mgr->lock) != 0)
+    /* one call per run of messages for the same socket */
+    sock = mgr->tx_slots[start].sock;
+    for (end = start + 1;
+         (end < mgr->tx_len) && (mgr->tx_slots[end].sock == sock);
+         end++)
     {
-      LS_ERROR(err, -errno);
-      ret = -1;
-      break;
     }
 
-    /* make sure to copy everything we need out of the tcb while we're locked */
-    tim = (ls_timer**)gpriority_queue_top(mgr->timer_q);
-    if (!tim)
-    {
-      ret = 0;
-    }
-    else
+    n = _sendmmsg_func(sock, &mgr->tx_msgs[start], end - start, 0);
+    if (n <= 0)
     {
-      if ( ls_timer_greater_tv(*tim, &mgr->last) )
+      if ( (n < 0) && (errno == EINTR) )
       {
-        *tv = ls_timer_get_time(*tim);
-        ret = 1;
-        tim = NULL;
+        continue;
       }
-      else
+      /* drop the datagram that failed, as the network might have, and */
+      /* keep going with the rest */
+      if (ret)
       {
-        gpriority_queue_pop(mgr->timer_q);
-        /* keep going */
+        LS_ERROR(err, (n < 0) ? -errno : LS_ERR_NO_IMPL);
+        ret = false;
       }
+      n = 1;
     }
+    start += n;
+  }
+  mgr->tx_len = 0;
+  return ret;
+}
+
+/* Flush from inside the loop, where a failed send isn't fatal. */
+static void
+_flush_sends(tube_manager* mgr)
+{
+  ls_err err;
+
+  if ( (mgr->tx_len > 0) && !tube_manager_flush(mgr, &err) )
+  {
+    LS_LOG_ERR(err, "tube_manager_flush");
+  }
+}
 
-    if (pthread_mutex_unlock(&mgr->lock) != 0)
+/* Find the next timer to run.  Returns as for pending_timers, or -2 with */
+/* due set. */
+static int
+_next_heap_timer(tube_manager* mgr,
+                 uint64_t*     term,
+                 ls_timer**    due)
+{
+  ls_timer* top = ls_timer_heap_top(mgr->timer_q);
+
+  if (!top)
+  {
+    return 0;
+  }
+  if ( ls_timer_greater_ns(top, mgr->last) )
+  {
+    *term = ls_timer_get_ns(top);
+    return 1;
+  }
+  /* take it out of the queue without destroying it; it can't be */
+  /* destroyed until it has run. */
+  *due = ls_timer_heap_pop(mgr->timer_q);
+  return -2;
+}
+
+static int
+_next_wheel_timer(tube_manager* mgr,
+                  uint64_t*     term,
+                  ls_timer**    due)
+{
+  /* everything that has expired moves to the due list in one go */
+  ls_timer_wheel_advance(mgr->timer_wheel, mgr->last);
+  *due = ls_timer_wheel_pop_due(mgr->timer_wheel);
+  if (*due)
+  {
+    return -2;
+  }
+  if ( !ls_timer_wheel_next(mgr->timer_wheel, term) )
+  {
+    return 0;
+  }
+  return 1;
+}
+
+static int
+pending_timers(tube_manager* mgr,
+               uint64_t*     term,
+               ls_err*       err)
+{
+  /* returns: */
+  /*   -1 on error */
+  /*   0 with no pending timers */
+  /*   1 with term set to when the next one is due */
+  int       ret = -2;
+  bool      ran;
+  ls_timer* due;
+  UNUSED_PARAM(err);
+
+  /* timers posted from other threads have to be queued before looking */
+  /* for the next one */
+  ran = _run_posts(mgr);
+
+  /* while there are still timeouts to process */
+  while ( (ret == -2) && mgr->keep_going )
+  {
+    due = NULL;
+    if (mgr->timer_backend == TUBE_TIMER_WHEEL)
     {
-      LS_ERROR(err, -errno);
-      ret = -1;
-      break;
+      ret = _next_wheel_timer(mgr, term, &due);
+    }
+    else
+    {
+      ret = _next_heap_timer(mgr, term, &due);
     }
 
-    if (tim)
+    if (due)
     {
-      ls_timer_exec(*tim);
+      if ( !ls_timer_is_cancelled(due) )
+      {
+        mgr->timer_running = due;
+        ls_timer_exec(due);
+        mgr->timer_running = NULL;
+        ran                = true;
+      }
+      ls_timer_destroy(due);
     }
   }
+  if (ran)
+  {
+    /* send whatever the timers and posts queued */
+    _flush_sends(mgr);
+  }
   return ret;
 }
 
 static int
-tube_manager_wait(tube_manager* mgr,
-                  ls_err*       err)
+_wait_select(tube_manager* mgr,
+             ls_err*       err)
 {
-  /* TODO: make this use a better mechanism than select on your OS. */
   int             pipe_r = mgr->pipe[0];
-  char            b;
   int             e;
   int             pending;
+  unsigned int    ready;
   struct timeval  timeout;
-  struct timeval* term;
+  uint64_t        term;
   fd_set          reads;
   FD_ZERO(&reads);
 
@@ -816,8 +1660,9 @@ tube_manager_wait(tube_manager* mgr,
     FD_SET(pipe_r, &reads);
     if (pending)
     {
-      timersub(term, &mgr->last, &timeout);
+      ls_time_to_timeval(term - mgr->last, &timeout);
     }
+    _flush_sends(mgr);
     switch ( select(mgr->max_fd + 1,
                     &reads, NULL, NULL,
                     pending ? &timeout : NULL) )
@@ -834,47 +1679,30 @@ tube_manager_wait(tube_manager* mgr,
       }
       break;
     case 0:
-      /* ls_log(LS_LOG_INFO, "count: %zu (%zd.%06d)", */
-      /*        gpriority_queue_size(mgr->timer_q), */
-      /*        timeout.tv_sec, */
-      /*        timeout.tv_usec); */
-
       /* timeout */
-      if (gettimeofday(&mgr->last, NULL) != 0)
+      if ( !_update_clock(mgr, err) )
       {
-        LS_ERROR(err, -errno);
         return -1;
       }
-      /* assert(term); */
-      /* mgr->last = *term; */
-      /* ls_log_format_timeval(&mgr->last, "last"); */
       continue;
     default:
       if ( FD_ISSET(pipe_r, &reads) )
       {
-        /* this is non-blocking. */
-        if ( (read(pipe_r, &b, 1) == 1) )             /* && (b > 0)) { */
-        {
-          sig_context* c = sig_contexts;
-          while (c)
-          {
-            if (c->sig == b)
-            {
-              c->cb(b);
-            }
-            c = c->next;
-          }
-        }
+        _io_read_pipe(mgr);
       }
-      /* TODO: make sure v4 doesn't starve */
-      /* select is level-triggered */
+      /* select is level-triggered, so nothing needs to be remembered */
+      ready = 0;
       if ( (mgr->sock6 >= 0) && FD_ISSET(mgr->sock6, &reads) )
       {
-        return mgr->sock6;
+        ready |= READY_V6;
       }
       if ( (mgr->sock4 >= 0) && FD_ISSET(mgr->sock4, &reads) )
       {
-        return mgr->sock4;
+        ready |= READY_V4;
+      }
+      if (ready)
+      {
+        return _io_next_ready(mgr, ready);
       }
       break;
     }
@@ -882,59 +1710,1087 @@ tube_manager_wait(tube_manager* mgr,
   return -2;
 }
 
-LS_API bool
-tube_manager_loop(tube_manager* mgr,
-                  ls_err*       err)
+#ifdef TUBE_HAVE_EPOLL
+/* Point the timerfd at the earliest timer, or disarm it if there are none. */
+/* Only makes a syscall when the deadline changes. */
+static bool
+_arm_timerfd(tube_manager*   mgr,
+             const uint64_t* term,
+             ls_err*         err)
 {
-  struct msghdr           hdr;
-  struct sockaddr_storage their_addr;
-  struct iovec            iov[1];
-  ssize_t                 numbytes;
-  uint8_t                 buf[MAXBUFLEN];
-  char                    id_str[SPUD_ID_STRING_SIZE + 1];
-  spud_message            msg = {NULL, NULL};
-  spud_tube_id            uid;
-  spud_command            cmd;
-  tube_event_data         d;
-  bool                    got_time;
-  struct cmsghdr*         cmsg;
-  uint8_t                 mctl[sizeof(struct cmsghdr) +
-                               sizeof(struct in6_pktinfo) +
-                               sizeof(struct in_pktinfo) +
-                               16]; /* TODO: measure this on some other OS's to
-                                     * see if it's enough */
-  ls_pktinfo*   info;
-  int           sock;
-  tube_states_t state;
-
-  assert(mgr);
+  struct itimerspec its;
 
-  if ( !ls_pktinfo_create(&info, err) )
+  if (term)
   {
-    return false;
+    if ( mgr->timer_armed && (*term == mgr->timer_deadline) )
+    {
+      return true;
+    }
+  }
+  else if (!mgr->timer_armed)
+  {
+    return true;
   }
 
-  hdr.msg_name    = &their_addr;
+  memset( &its, 0, sizeof(its) );
+  if (term)
+  {
+    its.it_value.tv_sec  = *term / LS_NS_PER_SEC;
+    its.it_value.tv_nsec = *term % LS_NS_PER_SEC;
+  }
+  if (timerfd_settime(mgr->timerfd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  mgr->timer_armed = (term != NULL);
+  if (term)
+  {
+    mgr->timer_deadline = *term;
+  }
+  return true;
+}
+
+static int
+_wait_epoll(tube_manager* mgr,
+            ls_err*       err)
+{
+  struct epoll_event evs[4];
+  uint64_t           term;
+  uint64_t           expirations;
+  int                pending;
+  int                n;
+  int                i;
+  int                fd;
+
+  while (mgr->keep_going)
+  {
+    pending = pending_timers(mgr, &term, err);
+    if (pending < 0)
+    {
+      return pending;
+    }
+    if ( !_arm_timerfd(mgr, pending ? &term : NULL, err) )
+    {
+      return -1;
+    }
+
+    /* Sockets that haven't hit EAGAIN yet are still readable, so there's */
+    /* no need to ask the kernel, except to keep the pipe from starving. */
+    if ( mgr->ready && (++mgr->ready_polls < READY_POLL_INTERVAL) )
+    {
+      return _io_next_ready(mgr, mgr->ready);
+    }
+    mgr->ready_polls = 0;
+    _flush_sends(mgr);
+
+    n = epoll_wait(mgr->epfd,
+                   evs,
+                   sizeof(evs) / sizeof(evs[0]),
+                   mgr->ready ? 0 : -1);
+    if (n == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      LS_ERROR(err, -errno);
+      return -1;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      fd = evs[i].data.fd;
+      if (fd == mgr->pipe[0])
+      {
+        _io_read_pipe(mgr);
+      }
+      else if (fd == mgr->timerfd)
+      {
+        /* non-blocking; just clears the expiration count */
+        if (read( fd, &expirations, sizeof(expirations) ) > 0)
+        {
+          mgr->timer_armed = false;
+        }
+        if ( !_update_clock(mgr, err) )
+        {
+          return -1;
+        }
+      }
+      else if (fd == mgr->sock6)
+      {
+        mgr->ready |= READY_V6;
+      }
+      else if (fd == mgr->sock4)
+      {
+        mgr->ready |= READY_V4;
+      }
+    }
+  }
+  return -2;
+}
+#endif
+
+static int
+tube_manager_wait(tube_manager* mgr,
+                  ls_err*       err)
+{
+#ifdef TUBE_HAVE_EPOLL
+  if (mgr->io == TUBE_IO_EPOLL)
+  {
+    return _wait_epoll(mgr, err);
+  }
+#endif
+  return _wait_select(mgr, err);
+}
+
+/* Pull the destination address and GRO segment size out of the control */
+/* messages.  segment is 0 unless the kernel coalesced several datagrams. */
+static void
+_read_cmsgs(struct msghdr* hdr,
+            ls_pktinfo*    info,
+            size_t*        segment)
+{
+  struct cmsghdr* cmsg;
+  int             gro;
+
+  *segment = 0;
+  for ( cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg) )
+  {
+    if ( (cmsg->cmsg_level == IPPROTO_IPV6) &&
+         (cmsg->cmsg_type == IPV6_PKTINFO) )
+    {
+      ls_pktinfo_set6( info, (struct in6_pktinfo*)CMSG_DATA(cmsg) );
+    }
+    if ( (cmsg->cmsg_level == IPPROTO_IP) && (cmsg->cmsg_type == IP_PKTINFO) )
+    {
+      ls_pktinfo_set4( info, (struct in_pktinfo*)CMSG_DATA(cmsg) );
+    }
+#ifdef UDP_GRO
+    else if ( (cmsg->cmsg_level == SOL_UDP) &&
+              (cmsg->cmsg_type == UDP_GRO) &&
+              ( cmsg->cmsg_len == CMSG_LEN( sizeof(int) ) ) )
+    {
+      memcpy( &gro, CMSG_DATA(cmsg), sizeof(gro) );
+      if (gro > 0)
+      {
+        *segment = gro;
+      }
+    }
+#endif
+  }
+#ifndef UDP_GRO
+  UNUSED_PARAM(gro);
+#endif
+}
+
+/* Grow the data batch arrays to hold size entries.  The peer pointers in */
+/* the entries already collected are moved to the new addresses. */
+static bool
+_grow_data_batch(tube_manager* mgr,
+                 size_t        size,
+                 ls_err*       err)
+{
+  tube_event_data* batch;
+  tube_peer*       peers;
+  size_t           i;
+
+  batch = ls_data_realloc( mgr->batch, size * sizeof(tube_event_data) );
+  if (!batch)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  mgr->batch = batch;
+  peers      = ls_data_malloc( size * sizeof(tube_peer) );
+  if (!peers)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  if (mgr->batch_count)
+  {
+    memcpy( peers, mgr->batch_peers, mgr->batch_count * sizeof(tube_peer) );
+  }
+  for (i = 0; i < mgr->batch_count; i++)
+  {
+    batch[i].peer = (const struct sockaddr*)
+                    &peers[(const tube_peer*)batch[i].peer - mgr->batch_peers];
+  }
+  ls_data_free(mgr->batch_peers);
+  mgr->batch_peers = peers;
+  mgr->batch_size  = size;
+  return true;
+}
+
+/* Put the entries for each tube next to each other, keeping both the */
+/* order the tubes first showed up in and the order within each tube. */
+/* Usually there are only a few tubes in a batch. */
+static void
+_group_data_batch(tube_manager* mgr)
+{
+  tube_event_data d;
+  size_t          i, k;
+
+  for (i = 1; i < mgr->batch_count; i++)
+  {
+    d = mgr->batch[i];
+    if (mgr->batch[i - 1].t == d.t)
+    {
+      continue;
+    }
+    /* everything before i is grouped already; find the end of d's group */
+    k = i - 1;
+    while ( (k > 0) && (mgr->batch[k].t != d.t) )
+    {
+      k--;
+    }
+    if (mgr->batch[k].t != d.t)
+    {
+      /* first packet for this tube */
+      continue;
+    }
+    memmove( &mgr->batch[k + 2], &mgr->batch[k + 1],
+             (i - k - 1) * sizeof(tube_event_data) );
+    mgr->batch[k + 1] = d;
+  }
+}
+
+/* Deliver the data packets collected so far, if any */
+static bool
+_flush_data_batch(tube_manager* mgr,
+                  ls_err*       err)
+{
+  tube_event_batch b;
+
+  if (mgr->batch_count == 0)
+  {
+    return true;
+  }
+  _group_data_batch(mgr);
+  b.tmgr  = mgr;
+  b.data  = mgr->batch;
+  b.count = mgr->batch_count;
+  /* anything the callbacks receive starts a new batch */
+  mgr->batch_count = 0;
+  return ls_event_trigger(mgr->e_data_batch, &b, NULL, NULL, err);
+}
+
+/* At the end of a receive: deliver the batch, and free up the CBOR it */
+/* was holding on to. */
+static bool
+_finish_receive(tube_manager* mgr,
+                ls_err*       err)
+{
+  bool ret;
+
+  /* drops that went quiet still get their count out, eventually */
+  if (mgr->last >= mgr->log_flush_at)
+  {
+    ls_log_limit_flush();
+    mgr->log_flush_at = mgr->last + LOG_FLUSH_NS;
+  }
+  if (mgr->batch_count == 0)
+  {
+    return true;
+  }
+  ret = _flush_data_batch(mgr, err);
+  ls_pool_reset(mgr->parse_pool);
+  return ret;
+}
+
+/* Hold on to a data packet until the end of the receive */
+static bool
+_batch_data(tube_manager*          mgr,
+            const tube_event_data* d,
+            ls_err*                err)
+{
+  tube_peer* peer;
+  socklen_t  len;
+
+  if ( (mgr->batch_count == mgr->batch_size) &&
+       !_grow_data_batch(mgr, mgr->batch_size * 2, err) &&
+       !_flush_data_batch(mgr, err) )
+  {
+    return false;
+  }
+  /* with the peers being copied, the wrong length would read off the end */
+  len  = (d->peer->sa_family == AF_INET6) ? sizeof(struct sockaddr_in6) :
+         sizeof(struct sockaddr_in);
+  peer = &mgr->batch_peers[mgr->batch_count];
+  memcpy(&peer->addr, d->peer, len);
+  mgr->batch[mgr->batch_count]      = *d;
+  mgr->batch[mgr->batch_count].peer = (const struct sockaddr*)&peer->addr;
+  mgr->batch_count++;
+  return true;
+}
+
+/* Create a tube for a peer we're going to talk to, and start it running */
+static bool
+_accept_tube(tube_manager*          mgr,
+             int                    sock,
+             const struct sockaddr* their_addr,
+             ls_pktinfo*            info,
+             spud_tube_id*          uid,
+             tube**                 t,
+             ls_err*                err)
+{
+  if ( !tube_create_slab(mgr->tube_slab, t, err) )
+  {
+    /* probably out of memory */
+    /* TODO: replace with an unused queue */
+    return false;
+  }
+
+  tube_set_info(*t, sock, their_addr, uid);
+
+  if ( !tube_set_local(*t, info, err) )
+  {
+    return false;
+  }
+
+  if ( !tube_manager_add(mgr, *t, err) )
+  {
+    return false;
+  }
+
+  tube_set_state(*t, TS_RUNNING);
+  return true;
+}
+
+/* ACK an OPEN with a cookie, straight from the stack */
+static bool
+_send_cookie(tube_manager*          mgr,
+             int                    sock,
+             const struct sockaddr* their_addr,
+             ls_pktinfo*            info,
+             spud_tube_id*          uid,
+             ls_err*                err)
+{
+  spud_header  hdr;
+  uint8_t      body[TUBE_COOKIE_CBOR_SIZE];
+  struct iovec iov[2];
+
+  if ( !spud_init(&hdr, uid, err) )
+  {
+    return false;
+  }
+  hdr.flags = SPUD_ACK;
+  tube_cookie_encode(tube_cookie_make(&mgr->cookie_key, uid, their_addr,
+                                      mgr->last),
+                     body);
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  iov[1].iov_base = body;
+  iov[1].iov_len  = sizeof(body);
+  return tube_manager_send(mgr, sock, info, (struct sockaddr*)their_addr,
+                           iov, 2, err);
+}
+
+/* Send a responder's cookie back to it */
+static bool
+_echo_cookie(tube*    t,
+             uint64_t cookie,
+             ls_err*  err)
+{
+  uint8_t  body[TUBE_COOKIE_CBOR_SIZE];
+  uint8_t* d = body;
+  size_t   l = sizeof(body);
+
+  tube_cookie_encode(cookie, body);
+  return tube_send(t, SPUD_ACK, false, false, &d, &l, 1, err);
+}
+
+/* Handle one received datagram.  Returns false only on errors that should */
+/* stop the loop; bad or unexpected packets are logged and dropped. */
+static bool
+_process_packet(tube_manager*          mgr,
+                int                    sock,
+                const uint8_t*         buf,
+                size_t                 numbytes,
+                const struct sockaddr* their_addr,
+                ls_pktinfo*            info,
+                ls_err*                err)
+{
+  char            id_str[SPUD_ID_STRING_SIZE + 1];
+  spud_message    msg = {NULL, NULL, NULL};
+  spud_tube_id    uid;
+  spud_command    cmd;
+  tube_event_data d;
+  tube_states_t   state;
+  uint64_t        cookie;
+  bool            ret = true;
+
+  /* before doing any work for it at all */
+  if ( mgr->packet_limit &&
+       !tube_limit_admit(mgr->packet_limit, their_addr, mgr->last) )
+  {
+    __atomic_fetch_add(&mgr->packets_limited, 1, __ATOMIC_RELAXED);
+    return true;
+  }
+
+  if ( !spud_parse_ctx(buf, numbytes, &msg, &mgr->parse_ctx, err) )
+  {
+    /* it's an attack.  Move along. */
+    LS_LOG_ERR_LIMITED(mgr->last, *err, "spud_parse");
+    goto cleanup;
+  }
+
+  spud_copy_id(&msg.header->tube_id, &uid);
+
+  cmd = msg.header->flags & SPUD_COMMAND;
+  if ( (cmd != SPUD_DATA) && !_flush_data_batch(mgr, err) )
+  {
+    goto error;
+  }
+
+  d.t    = tube_table_get(mgr->tubes, &uid);
+  d.tmgr = mgr;
+  d.cbor = msg.cbor;
+  d.peer = their_addr;
+  if (!d.t)
+  {
+    if ( !tube_manager_is_responder(mgr) ||
+         ( (cmd != SPUD_OPEN) && !mgr->open_cookies ) )
+    {
+      /* Not for one of our tubes, and we're not a responder, so punt. */
+      /* Even if we're a responder, if we get anything but an open */
+      /* for an unknown tube, ignore it. */
+      LS_LOG_LIMITED( mgr->last, LS_LOG_WARN, "Invalid tube ID: %s",
+                      spud_id_to_string(id_str, sizeof(id_str), &uid) );
+      goto cleanup;
+    }
+
+    if ( (cmd == SPUD_OPEN) && mgr->open_limit &&
+         !tube_limit_admit(mgr->open_limit, their_addr, mgr->last) )
+    {
+      __atomic_fetch_add(&mgr->opens_limited, 1, __ATOMIC_RELAXED);
+      goto cleanup;
+    }
+
+    if (mgr->open_cookies)
+    {
+      if (cmd == SPUD_OPEN)
+      {
+        /* answer it, and forget it */
+        _send_cookie(mgr, sock, their_addr, info, &uid, err);
+        goto cleanup;
+      }
+      if ( (cmd != SPUD_ACK) ||
+           !tube_cookie_decode(msg.cbor, &cookie) ||
+           !tube_cookie_check(&mgr->cookie_key, &uid, their_addr, mgr->last,
+                              cookie) )
+      {
+        LS_LOG_LIMITED( mgr->last, LS_LOG_WARN, "Invalid tube ID: %s",
+                        spud_id_to_string(id_str, sizeof(id_str), &uid) );
+        goto cleanup;
+      }
+      /* they got our ACK, so now it's worth a tube */
+      if ( !_accept_tube(mgr, sock, their_addr, info, &uid, &d.t, err) )
+      {
+        goto error;
+      }
+    }
+    else
+    {
+      if ( !_accept_tube(mgr, sock, their_addr, info, &uid, &d.t, err) )
+      {
+        goto error;
+      }
+      if ( !tube_send(d.t, SPUD_ACK, false, false, NULL, 0, 0, err) )
+      {
+        goto cleanup;
+      }
+    }
+  }
+
+  state = tube_get_state(d.t);
+  switch (cmd)
+  {
+  case SPUD_DATA:
+    if (state == TS_RUNNING)
+    {
+      if (mgr->data_batch)
+      {
+        if ( !_batch_data(mgr, &d, err) )
+        {
+          goto error;
+        }
+      }
+      else if ( !ls_event_trigger(mgr->e_data, &d, NULL, NULL, err) )
+      {
+        goto error;
+      }
+    }
+    break;
+  case SPUD_CLOSE:
+    if (state != TS_UNKNOWN)
+    {
+      /* double-close is a no-op */
+      tube_set_state(d.t, TS_UNKNOWN);
+      if ( !ls_event_trigger(mgr->e_close, &d, NULL, NULL, err) )
+      {
+        goto error;
+      }
+      tube_manager_remove(mgr, d.t);
+    }
+    break;
+  case SPUD_OPEN:
+    /* Double open.  no-op. */
+    break;
+  case SPUD_ACK:
+    if (state == TS_OPENING)
+    {
+      /* the responder wants proof that we heard it */
+      if ( tube_cookie_decode(msg.cbor, &cookie) &&
+           !_echo_cookie(d.t, cookie, err) )
+      {
+        LS_LOG_ERR(*err, "tube_send");
+      }
+      tube_set_state(d.t, TS_RUNNING);
+      if ( !ls_event_trigger(mgr->e_running, &d, NULL, NULL, err) )
+      {
+        goto error;
+      }
+    }
+    break;
+  }
+  goto cleanup;
+error:
+  ret = false;
+cleanup:
+  spud_unparse(&msg);
+  /* batched data still points into the pool */
+  if (mgr->batch_count == 0)
+  {
+    ls_pool_reset(mgr->parse_pool);
+  }
+  return ret;
+}
+
+/* Handle what one receive returned: either a single datagram, or with */
+/* UDP_GRO, several datagrams of segment bytes each (the last may be */
+/* shorter) that the kernel coalesced.  Each is parsed where it sits. */
+static bool
+_process_datagrams(tube_manager*          mgr,
+                   int                    sock,
+                   const uint8_t*         buf,
+                   size_t                 numbytes,
+                   size_t                 segment,
+                   const struct sockaddr* their_addr,
+                   ls_pktinfo*            info,
+                   ls_err*                err)
+{
+  size_t off;
+  size_t len;
+
+  if ( (segment == 0) || (segment >= numbytes) )
+  {
+    return _process_packet(mgr, sock, buf, numbytes, their_addr, info, err);
+  }
+  for (off = 0; mgr->keep_going && (off < numbytes); off += segment)
+  {
+    len = (numbytes - off < segment) ? numbytes - off : segment;
+    if ( !_process_packet(mgr, sock, buf + off, len, their_addr, info, err) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+_reset_recv_slot(tube_recv_slot* slot,
+                 struct mmsghdr* mm)
+{
+  mm->msg_hdr.msg_name       = &slot->addr;
+  mm->msg_hdr.msg_namelen    = sizeof(slot->addr);
+  mm->msg_hdr.msg_iov        = &slot->iov;
+  mm->msg_hdr.msg_iovlen     = 1;
+  mm->msg_hdr.msg_control    = slot->mctl;
+  mm->msg_hdr.msg_controllen = sizeof(slot->mctl);
+  mm->msg_hdr.msg_flags      = 0;
+  mm->msg_len                = 0;
+  slot->iov.iov_base         = slot->buf;
+  slot->iov.iov_len          = slot->buf_len;
+  ls_pktinfo_clear(slot->info);
+}
+
+/* Read up to mgr->rx_count datagrams from sock with one call, and */
+/* process each of them.  Only the slots that were filled get reset. */
+static bool
+_recv_batch(tube_manager* mgr,
+            int           sock,
+            ls_err*       err)
+{
+  bool            ret;
+  int             count;
+  int             i;
+  size_t          segment;
+  tube_recv_slot* slot;
+  struct mmsghdr* mm;
+
+  count = _recvmmsg_func(sock, mgr->rx_msgs, mgr->rx_count, 0, NULL);
+  if (count < 0)
+  {
+    if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+    {
+      _io_drained(mgr, sock);
+      return true;
+    }
+    if (errno == EINTR)
+    {
+      return true;
+    }
+    /* unrecoverable */
+    LS_ERROR(err, -errno);
+    return false;
+  }
+
+  if ( (unsigned int)count < mgr->rx_count )
+  {
+    /* a short batch means the socket ran dry */
+    _io_drained(mgr, sock);
+  }
+
+  /* one clock read covers the whole batch */
+  ret = _update_clock(mgr, err);
+
+  for (i = 0; ret && mgr->keep_going && (i < count); i++)
+  {
+    slot = &mgr->rx_slots[i];
+    mm   = &mgr->rx_msgs[i];
+    _read_cmsgs(&mm->msg_hdr, slot->info, &segment);
+    if (mm->msg_len == 0)
+    {
+      continue;
+    }
+    ret = _process_datagrams(mgr,
+                             sock,
+                             slot->buf,
+                             mm->msg_len,
+                             segment,
+                             (const struct sockaddr*)&slot->addr,
+                             slot->info,
+                             err);
+  }
+  /* before the slots the batch's data points into are reused */
+  if (ret)
+  {
+    ret = _finish_receive(mgr, err);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    _reset_recv_slot(&mgr->rx_slots[i], &mgr->rx_msgs[i]);
+  }
+  /* everything sent while handling the batch goes out together */
+  _flush_sends(mgr);
+  return ret;
+}
+
+LS_API void
+tube_manager_set_batch_functions(tube_recvmmsg_func recv,
+                                 tube_sendmmsg_func send)
+{
+#ifdef HAVE_RECVMMSG
+  _recvmmsg_func = recv ? recv : recvmmsg;
+#else
+  _recvmmsg_func = recv ? recv : _recvmmsg_fallback;
+#endif
+#ifdef HAVE_SENDMMSG
+  _sendmmsg_func = send ? send : sendmmsg;
+#else
+  _sendmmsg_func = send ? send : _sendmmsg_fallback;
+#endif
+}
+
+LS_API bool
+tube_manager_set_batch_size(tube_manager* mgr,
+                            unsigned int  count,
+                            ls_err*       err)
+{
+  tube_recv_slot* slots = NULL;
+  struct mmsghdr* msgs  = NULL;
+  unsigned int    i;
+
+  assert(mgr);
+  if (count > TUBE_MANAGER_MAX_BATCH)
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (count > 1)
+  {
+    slots = ls_data_calloc( count, sizeof(*slots) );
+    msgs  = ls_data_calloc( count, sizeof(*msgs) );
+    if (!slots || !msgs)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      _free_recv_slots(slots, 0, msgs);
+      return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+      slots[i].buf_len = mgr->gro ? GRO_BUFLEN : MAXBUFLEN;
+      slots[i].buf     = ls_data_malloc(slots[i].buf_len);
+      if ( !slots[i].buf || !ls_pktinfo_create(&slots[i].info, err) )
+      {
+        if (!slots[i].buf)
+        {
+          LS_ERROR(err, LS_ERR_NO_MEMORY);
+        }
+        _free_recv_slots(slots, i + 1, msgs);
+        return false;
+      }
+      _reset_recv_slot(&slots[i], &msgs[i]);
+    }
+  }
+  else
+  {
+    count = 0;
+  }
+
+  _free_recv_slots(mgr->rx_slots, mgr->rx_count, mgr->rx_msgs);
+  mgr->rx_slots = slots;
+  mgr->rx_msgs  = msgs;
+  mgr->rx_count = count;
+  return true;
+}
+
+LS_API bool
+tube_manager_set_send_batch_size(tube_manager* mgr,
+                                 unsigned int  count,
+                                 ls_err*       err)
+{
+  tube_send_slot* slots = NULL;
+  struct mmsghdr* msgs  = NULL;
+
+  assert(mgr);
+  if (count > TUBE_MANAGER_MAX_BATCH)
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (count > 1)
+  {
+    slots = ls_data_calloc( count, sizeof(*slots) );
+    msgs  = ls_data_calloc( count, sizeof(*msgs) );
+    if (!slots || !msgs)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      ls_data_free(slots);
+      ls_data_free(msgs);
+      return false;
+    }
+  }
+  else
+  {
+    count = 0;
+  }
+
+  /* don't lose anything queued in the old slots */
+  if ( !tube_manager_flush(mgr, err) )
+  {
+    ls_data_free(slots);
+    ls_data_free(msgs);
+    return false;
+  }
+  ls_data_free(mgr->tx_slots);
+  ls_data_free(mgr->tx_msgs);
+  mgr->tx_slots = slots;
+  mgr->tx_msgs  = msgs;
+  mgr->tx_count = count;
+  return true;
+}
+
+LS_API bool
+tube_manager_set_gro(tube_manager* mgr,
+                     bool          enable,
+                     ls_err*       err)
+{
+  uint8_t* buf = NULL;
+
+  assert(mgr);
+  if (enable == mgr->gro)
+  {
+    return true;
+  }
+  if ( enable && (mgr->io == TUBE_IO_URING) )
+  {
+    /* the provided buffers are only big enough for one datagram each */
+    LS_ERROR(err, LS_ERR_NO_IMPL);
+    return false;
+  }
+  if (enable)
+  {
+    buf = ls_data_malloc(GRO_BUFLEN);
+    if (!buf)
+    {
+      LS_ERROR(err, LS_ERR_NO_MEMORY);
+      return false;
+    }
+  }
+
+  if ( !_set_gro_sockopt(mgr->sock6, enable, err) ||
+       !_set_gro_sockopt(mgr->sock4, enable, err) )
+  {
+    ls_data_free(buf);
+    /* don't leave one socket coalescing into a buffer that's too small */
+    _set_gro_sockopt(mgr->sock6, mgr->gro, NULL);
+    _set_gro_sockopt(mgr->sock4, mgr->gro, NULL);
+    return false;
+  }
+
+  ls_data_free(mgr->gro_buf);
+  mgr->gro_buf = buf;
+  mgr->gro     = enable;
+
+  /* resize the batch buffers to match */
+  if ( (mgr->rx_count > 1) &&
+       !tube_manager_set_batch_size(mgr, mgr->rx_count, err) )
+  {
+    tube_manager_set_gro(mgr, !enable, NULL);
+    return false;
+  }
+  return true;
+}
+
+LS_API bool
+tube_manager_set_data_batch(tube_manager* mgr,
+                            bool          enable,
+                            ls_err*       err)
+{
+  assert(mgr);
+  if ( enable && (mgr->batch_size == 0) &&
+       !_grow_data_batch(mgr, DATA_BATCH_SIZE, err) )
+  {
+    return false;
+  }
+  /* anything already collected is still delivered at the end of the */
+  /* receive */
+  mgr->data_batch = enable;
+  return true;
+}
+
+LS_API bool
+tube_manager_set_open_cookies(tube_manager* mgr,
+                              bool          enable,
+                              ls_err*       err)
+{
+  assert(mgr);
+  if ( enable && !mgr->open_cookies &&
+       !tube_cookie_key_init(&mgr->cookie_key, err) )
+  {
+    return false;
+  }
+  mgr->open_cookies = enable;
+  return true;
+}
+
+/* Replace *lim with a limit of rate per second, or none if rate is 0 */
+static bool
+_set_limit(tube_limit** lim,
+           uint32_t     rate,
+           ls_err*      err)
+{
+  tube_limit* ret = NULL;
+
+  /* a second's worth can come at once */
+  if ( rate && !tube_limit_create(rate, rate, &ret, err) )
+  {
+    return false;
+  }
+  tube_limit_destroy(*lim);
+  *lim = ret;
+  return true;
+}
+
+LS_API bool
+tube_manager_set_rate_limits(tube_manager* mgr,
+                             uint32_t      packets,
+                             uint32_t      opens,
+                             ls_err*       err)
+{
+  tube_limit* old_packets;
+
+  assert(mgr);
+  if ( (packets > LS_NS_PER_SEC) || (opens > LS_NS_PER_SEC) )
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+  /* all or nothing */
+  old_packets       = mgr->packet_limit;
+  mgr->packet_limit = NULL;
+  if ( !_set_limit(&mgr->packet_limit, packets, err) )
+  {
+    mgr->packet_limit = old_packets;
+    return false;
+  }
+  if ( !_set_limit(&mgr->open_limit, opens, err) )
+  {
+    tube_limit_destroy(mgr->packet_limit);
+    mgr->packet_limit = old_packets;
+    return false;
+  }
+  tube_limit_destroy(old_packets);
+  return true;
+}
+
+LS_API void
+tube_manager_get_drops(tube_manager*       mgr,
+                       tube_manager_drops* drops)
+{
+  assert(mgr);
+  assert(drops);
+  drops->packets = __atomic_load_n(&mgr->packets_limited, __ATOMIC_RELAXED);
+  drops->opens   = __atomic_load_n(&mgr->opens_limited, __ATOMIC_RELAXED);
+}
+
+#ifdef TUBE_HAVE_URING
+/* The whole loop for io_uring: one submit-and-wait per iteration, which */
+/* also carries every send queued while handling the previous batch. */
+static bool
+_loop_uring(tube_manager* mgr,
+            ls_pktinfo*   info,
+            ls_err*       err)
+{
+  tube_uring_event ev;
+  struct timespec  timeout;
+  uint64_t         term;
+  int              pending;
+  size_t           segment;
+
+  while (mgr->keep_going)
+  {
+    pending = pending_timers(mgr, &term, err);
+    if (pending < 0)
+    {
+      return false;
+    }
+    if (!mgr->keep_going)
+    {
+      break;
+    }
+    if (pending)
+    {
+      timeout.tv_sec  = (term - mgr->last) / LS_NS_PER_SEC;
+      timeout.tv_nsec = (term - mgr->last) % LS_NS_PER_SEC;
+    }
+    if ( !tube_uring_submit_wait(mgr->uring, pending ? &timeout : NULL, err) )
+    {
+      return false;
+    }
+
+    /* one clock read covers everything that completed, or the timeout */
+    if ( !_update_clock(mgr, err) )
+    {
+      return false;
+    }
+    while ( mgr->keep_going && tube_uring_next(mgr->uring, &ev) )
+    {
+      if (ev.kind == TUBE_URING_READABLE)
+      {
+        if (ev.fd == mgr->pipe[0])
+        {
+          _io_read_pipe(mgr);
+        }
+        continue;
+      }
+
+      ls_pktinfo_clear(info);
+      _read_cmsgs(&ev.hdr, info, &segment);
+      if (ev.len == 0)
+      {
+        continue;
+      }
+      if ( !_process_datagrams(mgr,
+                               ev.fd,
+                               ev.data,
+                               ev.len,
+                               segment,
+                               (const struct sockaddr*)ev.hdr.msg_name,
+                               info,
+                               err) ||
+           !_finish_receive(mgr, err) )
+      {
+        return false;
+      }
+    }
+  }
+
+  /* don't strand anything the last callbacks sent */
+  return tube_uring_submit(mgr->uring, err);
+}
+#endif
+
+LS_API bool
+tube_manager_loop(tube_manager* mgr,
+                  ls_err*       err)
+{
+  struct msghdr           hdr;
+  struct sockaddr_storage their_addr;
+  struct iovec            iov[1];
+  ssize_t                 numbytes;
+  uint8_t                 buf[MAXBUFLEN];
+  uint8_t                 mctl[MCTL_SIZE];
+  ls_pktinfo*             info;
+  int                     sock;
+  size_t                  segment;
+
+  assert(mgr);
+
+  if ( !ls_pktinfo_create(&info, err) )
+  {
+    return false;
+  }
+
+  hdr.msg_name    = &their_addr;
   hdr.msg_iov     = iov;
   hdr.msg_iovlen  = 1;
   hdr.msg_control = mctl;
 
-  iov[0].iov_base = buf;
-  iov[0].iov_len  = sizeof(buf);
-  d.peer          = (const struct sockaddr*)&their_addr;
+  /* GRO can't be turned on or off while the loop is running */
+  if (mgr->gro)
+  {
+    iov[0].iov_base = mgr->gro_buf;
+    iov[0].iov_len  = GRO_BUFLEN;
+  }
+  else
+  {
+    iov[0].iov_base = buf;
+    iov[0].iov_len  = sizeof(buf);
+  }
+
+  /* sends can only be batched from this thread */
+  mgr->loop_thread = pthread_self();
+  mgr->in_loop     = true;
 
   if ( !ls_event_trigger(mgr->e_loopstart, mgr, NULL, NULL, err) )
   {
     goto error;
   }
 
+#ifdef TUBE_HAVE_URING
+  if (mgr->io == TUBE_IO_URING)
+  {
+    if ( !_loop_uring(mgr, info, err) )
+    {
+      goto error;
+    }
+    goto done;
+  }
+#endif
+
   while (mgr->keep_going)
   {
     hdr.msg_namelen    = sizeof(their_addr);
     hdr.msg_controllen = sizeof(mctl);
     hdr.msg_flags      = 0;
     ls_pktinfo_clear(info);
-    got_time = false;
 
     sock = tube_manager_wait(mgr, err);
     switch (sock)
@@ -942,16 +2798,31 @@ tube_manager_loop(tube_manager* mgr,
     case -1:
       goto error;
     case -2:
-      goto cleanup;
+      continue;
     default:
       break;
     }
+
+    if (mgr->rx_count > 1)
+    {
+      if ( !_recv_batch(mgr, sock, err) )
+      {
+        goto error;
+      }
+      continue;
+    }
+
     if ( ( numbytes = _recvmsg_func(sock, &hdr, 0) ) == -1 )
     {
       if (errno == EINTR)
       {
         continue;
       }
+      if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+      {
+        _io_drained(mgr, sock);
+        continue;
+      }
       /* unrecoverable */
       LS_ERROR(err, -errno);
       goto error;
@@ -960,131 +2831,38 @@ tube_manager_loop(tube_manager* mgr,
     /* recvmsg should only return 0 on TCP EOF */
     assert(numbytes != 0);
 
-    for ( cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg) )
-    {
-      if ( (cmsg->cmsg_level == IPPROTO_IPV6) &&
-           (cmsg->cmsg_type == IPV6_PKTINFO) )
-      {
-        ls_pktinfo_set6( info, (struct in6_pktinfo*)CMSG_DATA(cmsg) );
-      }
-      if ( (cmsg->cmsg_level == IPPROTO_IP) && (cmsg->cmsg_type == IP_PKTINFO) )
-      {
-        ls_pktinfo_set4( info, (struct in_pktinfo*)CMSG_DATA(cmsg) );
-      }
-      else if ( (cmsg->cmsg_level == SOL_SOCKET) &&
-                (cmsg->cmsg_type == SCM_TIMESTAMP) &&
-                ( cmsg->cmsg_len == CMSG_LEN( sizeof(struct timeval) ) ) )
-      {
-        memcpy( &mgr->last, CMSG_DATA(cmsg), sizeof(struct timeval) );
-        got_time = true;
-      }
-    }
-    if (!got_time)
-    {
-      if (gettimeofday(&mgr->last, NULL) == -1)
-      {
-        LS_ERROR(err, -errno);
-        goto error;
-      }
-    }
-
-    if ( !spud_parse(buf, numbytes, &msg, err) )
-    {
-      /* it's an attack.  Move along. */
-      LS_LOG_ERR(*err, "spud_parse");
-      goto cleanup;
-    }
-
-    spud_copy_id(&msg.header->tube_id, &uid);
-
-    cmd    = msg.header->flags & SPUD_COMMAND;
-    d.t    = ls_htable_get(mgr->tubes, &uid);
-    d.tmgr = mgr;
-    d.cbor = msg.cbor;
-    if (!d.t)
+    _read_cmsgs(&hdr, info, &segment);
+    if ( !_update_clock(mgr, err) )
     {
-      if ( !tube_manager_is_responder(mgr) || (cmd != SPUD_OPEN) )
-      {
-        /* Not for one of our tubes, and we're not a responder, so punt. */
-        /* Even if we're a responder, if we get anything but an open */
-        /* for an unknown tube, ignore it. */
-        ls_log( LS_LOG_WARN, "Invalid tube ID: %s",
-                spud_id_to_string(id_str, sizeof(id_str), &uid) );
-        goto cleanup;
-      }
-
-      /* get started */
-      if ( !tube_create(&d.t, err) )
-      {
-        /* probably out of memory */
-        /* TODO: replace with an unused queue */
-        goto error;
-      }
-
-      tube_set_info(d.t, sock, (struct sockaddr*)&their_addr, &uid);
-
-      if ( !tube_set_local(d.t, info, err) )
-      {
-        goto error;
-      }
-
-      if ( !tube_manager_add(mgr, d.t, err) )
-      {
-        goto error;
-      }
-
-      tube_set_state(d.t, TS_RUNNING);
-
-      if ( !tube_send(d.t, SPUD_ACK, false, false, NULL, 0, 0, err) )
-      {
-        goto cleanup;
-      }
+      goto error;
     }
 
-    state = tube_get_state(d.t);
-    switch (cmd)
+    if ( !_process_datagrams(mgr,
+                             sock,
+                             iov[0].iov_base,
+                             numbytes,
+                             segment,
+                             (const struct sockaddr*)&their_addr,
+                             info,
+                             err) ||
+         !_finish_receive(mgr, err) )
     {
-    case SPUD_DATA:
-      if (state == TS_RUNNING)
-      {
-        if ( !ls_event_trigger(mgr->e_data, &d, NULL, NULL, err) )
-        {
-          goto error;
-        }
-      }
-      break;
-    case SPUD_CLOSE:
-      if (state != TS_UNKNOWN)
-      {
-        /* double-close is a no-op */
-        tube_set_state(d.t, TS_UNKNOWN);
-        if ( !ls_event_trigger(mgr->e_close, &d, NULL, NULL, err) )
-        {
-          goto error;
-        }
-        tube_manager_remove(mgr, d.t);
-      }
-      break;
-    case SPUD_OPEN:
-      /* Double open.  no-op. */
-      break;
-    case SPUD_ACK:
-      if (state == TS_OPENING)
-      {
-        tube_set_state(d.t, TS_RUNNING);
-        if ( !ls_event_trigger(mgr->e_running, &d, NULL, NULL, err) )
-        {
-          goto error;
-        }
-      }
-      break;
+      goto error;
     }
-cleanup:
-    spud_unparse(&msg);
   }
+#ifdef TUBE_HAVE_URING
+done:
+#endif
+  /* don't strand anything the last callbacks sent */
+  _flush_sends(mgr);
+  mgr->in_loop = false;
   ls_pktinfo_destroy(info);
   return true;
 error:
+  _flush_sends(mgr);
+  /* whatever was being batched points into buffers that are going away */
+  mgr->batch_count = 0;
+  mgr->in_loop     = false;
   ls_pktinfo_destroy(info);
   return false;
 }
@@ -1109,7 +2887,7 @@ LS_API size_t
 tube_manager_size(tube_manager* mgr)
 {
   assert(mgr);
-  return ls_htable_get_count(mgr->tubes);
+  return tube_table_count(mgr->tubes);
 }
 
 LS_API void
@@ -1133,6 +2911,31 @@ tube_manager_is_responder(tube_manager* mgr)
   return (mgr->policy & TP_WILL_RESPOND) == TP_WILL_RESPOND;
 }
 
+/* In a group, replies are steered to the shard whose index is the second */
+/* half of the tube ID (as a big-endian number) mod the number of shards. */
+/* Nudge a random ID so that it belongs to this shard. */
+static void
+_steer_id(tube_manager* mgr,
+          spud_tube_id* id)
+{
+  uint32_t v;
+  uint64_t w;
+
+  if (mgr->shards < 2)
+  {
+    return;
+  }
+  memcpy(&v, &id->octet[4], sizeof(v));
+  v = ntohl(v);
+  w = (uint64_t)v - (v % mgr->shards) + mgr->shard;
+  if (w > UINT32_MAX)
+  {
+    w -= mgr->shards;
+  }
+  v = htonl( (uint32_t)w );
+  memcpy(&id->octet[4], &v, sizeof(v));
+}
+
 LS_API bool
 tube_manager_open_tube(tube_manager*          mgr,
                        const struct sockaddr* dest,
@@ -1142,7 +2945,7 @@ tube_manager_open_tube(tube_manager*          mgr,
   tube*        ret = NULL;
   spud_tube_id id;
 
-  if ( !tube_create(&ret, err) )
+  if ( !tube_create_slab(mgr->tube_slab, &ret, err) )
   {
     return false;
   }
@@ -1152,6 +2955,7 @@ tube_manager_open_tube(tube_manager*          mgr,
     tube_destroy(ret);
     return false;
   }
+  _steer_id(mgr, &id);
 
   switch (dest->sa_family)
   {
@@ -1177,8 +2981,8 @@ tube_manager_open_tube(tube_manager*          mgr,
 
   if ( !tube_send(ret, SPUD_OPEN, false, false, NULL, 0, 0, err) )
   {
-    tube_manager_remove(mgr,ret);
-    tube_destroy(ret);
+    /* removing destroys it */
+    tube_manager_remove(mgr, ret);
     return false;
   }
   *t = ret;
@@ -1193,6 +2997,278 @@ tube_manager_set_socket_functions(tube_sendmsg_func send,
   _recvmsg_func = (recv == NULL) ? recvmsg : recv;
 }
 
+/* msg_control must have room for a pktinfo cmsg */
+static void
+_build_msghdr(struct msghdr*   msg,
+              uint8_t*         msg_control,
+              size_t           control_len,
+              ls_pktinfo*      source,
+              struct sockaddr* dest,
+              struct iovec*    iov,
+              size_t           count)
+{
+  memset( msg, 0, sizeof(*msg) );
+  msg->msg_name    = dest;
+  msg->msg_namelen = ls_sockaddr_get_length(dest);
+  msg->msg_iov     = iov;
+  msg->msg_iovlen  = count;
+
+  if (source)
+  {
+    memset(msg_control, 0, control_len);
+    msg->msg_control    = msg_control;
+    msg->msg_controllen = control_len;
+    msg->msg_controllen = ls_pktinfo_cmsg( source, CMSG_FIRSTHDR(msg) );
+  }
+}
+
+/* Copy a message into the next send slot, flushing first if they are all */
+/* full.  Returns false if the message doesn't fit in a slot. */
+static bool
+_queue_send(tube_manager*    mgr,
+            int              sock,
+            ls_pktinfo*      source,
+            struct sockaddr* dest,
+            struct iovec*    iov,
+            size_t           count)
+{
+  tube_send_slot* slot;
+  struct mmsghdr* mm;
+  size_t          len = 0;
+  size_t          i;
+
+  assert(dest);
+  assert(iov);
+  assert(count > 0);
+
+  for (i = 0; i < count; i++)
+  {
+    len += iov[i].iov_len;
+  }
+  if ( len > sizeof(slot->buf) )
+  {
+    return false;
+  }
+  if (mgr->tx_len == mgr->tx_count)
+  {
+    _flush_sends(mgr);
+  }
+
+  slot = &mgr->tx_slots[mgr->tx_len];
+  mm   = &mgr->tx_msgs[mgr->tx_len];
+  mgr->tx_len++;
+
+  slot->sock = sock;
+  memcpy( &slot->addr, dest, ls_sockaddr_get_length(dest) );
+  len = 0;
+  for (i = 0; i < count; i++)
+  {
+    memcpy(slot->buf + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  slot->iov.iov_base = slot->buf;
+  slot->iov.iov_len  = len;
+  _build_msghdr(&mm->msg_hdr, slot->mctl, sizeof(slot->mctl),
+                source, (struct sockaddr*)&slot->addr, &slot->iov, 1);
+  mm->msg_len = 0;
+  return true;
+}
+
+LS_API bool
+tube_manager_send(tube_manager*    mgr,
+                  int              sock,
+                  ls_pktinfo*      source,
+                  struct sockaddr* dest,
+                  struct iovec*    iov,
+                  size_t           count,
+                  ls_err*          err)
+{
+#ifdef TUBE_HAVE_URING
+  if ( mgr && mgr->uring && mgr->in_loop &&
+       pthread_equal( mgr->loop_thread, pthread_self() ) )
+  {
+    uint8_t       msg_control[CMSG_SPACE( sizeof(struct in6_pktinfo) )];
+    struct msghdr msg;
+    ls_err        qerr;
+
+    assert(dest);
+    assert(iov);
+    assert(count > 0);
+
+    _build_msghdr(&msg, msg_control, sizeof(msg_control),
+                  source, dest, iov, count);
+    if ( tube_uring_queue_sendmsg(mgr->uring, sock, &msg, &qerr) )
+    {
+      return true;
+    }
+    if (qerr.code != LS_ERR_OVERFLOW)
+    {
+      if (err)
+      {
+        *err = qerr;
+      }
+      return false;
+    }
+    /* no room; send it the old-fashioned way */
+  }
+#endif
+  if ( mgr && mgr->tx_count && mgr->in_loop &&
+       pthread_equal( mgr->loop_thread, pthread_self() ) )
+  {
+    if ( _queue_send(mgr, sock, source, dest, iov, count) )
+    {
+      return true;
+    }
+    /* too big for a slot; keep the order by sending the queue first */
+    _flush_sends(mgr);
+  }
+  return tube_manager_sendmsg(sock, source, dest, iov, count, err);
+}
+
+#ifdef UDP_SEGMENT
+/* Send len bytes of buf as datagrams of segment bytes each (the last one */
+/* may be shorter) with a single sendmsg. */
+static bool
+_send_gso(int              sock,
+          ls_pktinfo*      source,
+          struct sockaddr* dest,
+          uint8_t*         buf,
+          size_t           len,
+          uint16_t         segment,
+          ls_err*          err)
+{
+  uint8_t         msg_control[CMSG_SPACE( sizeof(struct in6_pktinfo) ) +
+                              CMSG_SPACE( sizeof(uint16_t) )];
+  struct msghdr   msg;
+  struct iovec    iov;
+  struct cmsghdr* cmsg;
+
+  iov.iov_base = buf;
+  iov.iov_len  = len;
+  _build_msghdr(&msg, msg_control, sizeof(msg_control),
+                source, dest, &iov, 1);
+
+  /* the segment size goes after the pktinfo, if there is one */
+  if (!source)
+  {
+    memset( msg_control, 0, sizeof(msg_control) );
+  }
+  cmsg             = (struct cmsghdr*)(msg_control + msg.msg_controllen);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type  = UDP_SEGMENT;
+  cmsg->cmsg_len   = CMSG_LEN( sizeof(uint16_t) );
+  memcpy( CMSG_DATA(cmsg), &segment, sizeof(segment) );
+  msg.msg_control     = msg_control;
+  msg.msg_controllen += CMSG_SPACE( sizeof(uint16_t) );
+
+  if (_sendmsg_func(sock, &msg, 0) <= 0)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  return true;
+}
+
+/* Errors that mean GSO won't work on this socket, rather than that the */
+/* send failed. */
+static bool
+_gso_unsupported(int code)
+{
+  switch (-code)
+  {
+  case EIO:
+  case EINVAL:
+  case ENOPROTOOPT:
+  case EOPNOTSUPP:
+    return true;
+  default:
+    return false;
+  }
+}
+#endif
+
+LS_API bool
+tube_manager_send_segments(tube_manager*    mgr,
+                           int              sock,
+                           ls_pktinfo*      source,
+                           struct sockaddr* dest,
+                           uint8_t*         buf,
+                           size_t           len,
+                           size_t           segment,
+                           ls_err*          err)
+{
+  struct iovec iov;
+  size_t       off;
+#ifdef UDP_SEGMENT
+  size_t       chunk;
+  ls_err       gso_err;
+#endif
+
+  assert(dest);
+  assert(buf);
+  assert(segment > 0);
+
+#ifdef UDP_SEGMENT
+  if ( mgr && mgr->gso && (len > segment) && (segment <= MAXBUFLEN) )
+  {
+    /* anything queued on the loop thread has to go first */
+    if ( mgr->in_loop && pthread_equal( mgr->loop_thread, pthread_self() ) )
+    {
+      _flush_sends(mgr);
+#ifdef TUBE_HAVE_URING
+      if ( mgr->uring && !tube_uring_submit(mgr->uring, err) )
+      {
+        return false;
+      }
+#endif
+    }
+
+    for (off = 0; off < len; off += chunk)
+    {
+      chunk = len - off;
+      if (chunk > GSO_MAX_BYTES)
+      {
+        chunk = (GSO_MAX_BYTES / segment) * segment;
+      }
+      if ( (chunk / segment) > TUBE_MANAGER_MAX_SEGMENTS )
+      {
+        chunk = TUBE_MANAGER_MAX_SEGMENTS * segment;
+      }
+      if ( !_send_gso(sock, source, dest, buf + off, chunk,
+                      (uint16_t)segment, &gso_err) )
+      {
+        if ( (off == 0) && _gso_unsupported(gso_err.code) )
+        {
+          /* the route's device can't do it after all; stop trying */
+          mgr->gso = false;
+          break;
+        }
+        if (err)
+        {
+          *err = gso_err;
+        }
+        return false;
+      }
+    }
+    if (mgr->gso)
+    {
+      return true;
+    }
+  }
+#endif
+
+  for (off = 0; off < len; off += segment)
+  {
+    iov.iov_base = buf + off;
+    iov.iov_len  = (len - off < segment) ? len - off : segment;
+    if ( !tube_manager_send(mgr, sock, source, dest, &iov, 1, err) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 LS_API bool
 tube_manager_sendmsg(int              sock,
                      ls_pktinfo*      source,
@@ -1201,26 +3277,15 @@ tube_manager_sendmsg(int              sock,
                      size_t           count,
                      ls_err*          err)
 {
-  char          msg_control[1024];
+  uint8_t       msg_control[1024];
   struct msghdr msg;
 
   assert(dest);
   assert(iov);
   assert(count > 0);
 
-  memset( &msg, 0, sizeof(msg) );
-  msg.msg_name    = dest;
-  msg.msg_namelen = ls_sockaddr_get_length(dest);
-  msg.msg_iov     = iov;
-  msg.msg_iovlen  = count;
-
-  if (source)
-  {
-    memset( msg_control, 0, sizeof(msg_control) );
-    msg.msg_control    = msg_control;
-    msg.msg_controllen = sizeof(msg_control);
-    msg.msg_controllen = ls_pktinfo_cmsg( source, CMSG_FIRSTHDR(&msg) );
-  }
+  _build_msghdr(&msg, msg_control, sizeof(msg_control),
+                source, dest, iov, count);
 
   if (_sendmsg_func(sock, &msg, 0) <= 0)
   {
@@ -1231,16 +3296,15 @@ tube_manager_sendmsg(int              sock,
 }
 
 static int
-log_walk(void*       user_data,
-         const void* key,
-         void*       data)
+log_walk(void*               user_data,
+         const spud_tube_id* id,
+         tube*               t)
 {
-  const spud_tube_id* kid = key;
-  char                buf[SPUD_ID_STRING_SIZE + 1];
+  char buf[SPUD_ID_STRING_SIZE + 1];
   UNUSED_PARAM(user_data);
-  UNUSED_PARAM(data);
+  UNUSED_PARAM(t);
 
-  ls_log( LS_LOG_INFO, "%s", spud_id_to_string(buf, sizeof(buf), kid) );
+  ls_log( LS_LOG_INFO, "%s", spud_id_to_string(buf, sizeof(buf), id) );
   return 1;
 }
 
@@ -1248,7 +3312,7 @@ LS_API void
 tube_manager_print_tubes(tube_manager* mgr)
 {
   assert(mgr);
-  ls_htable_walk(mgr->tubes, log_walk, mgr);
+  tube_table_walk(mgr->tubes, log_walk, mgr);
 }
 
 LS_API void
@@ -1259,5 +3323,5 @@ tube_manager_foreach(tube_manager*    mgr,
   assert(mgr);
   assert(walker);
 
-  ls_htable_walk(mgr->tubes, (ls_htable_walkfunc) walker, data);
+  tube_table_walk(mgr->tubes, walker, data);
 }
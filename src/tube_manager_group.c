@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
+#include "tube_manager_group.h"
+#include "ls_log.h"
+#include "ls_mem.h"
+#include "ls_sockaddr.h"
+
+#include "tube_manager_int.h"
+
+typedef struct _tube_shard
+{
+  tube_manager* mgr;
+  pthread_t     thread;
+  bool          started;
+  bool          loop_ret;
+  ls_err        loop_err;
+} tube_shard;
+
+struct _tube_manager_group
+{
+  unsigned int count;
+  unsigned int next_open;
+  bool         running;
+  tube_shard*  shards;
+};
+
+LS_API bool
+tube_manager_group_create(unsigned int         shards,
+                          int                  buckets,
+                          tube_io_backend      io,
+                          tube_manager_group** grp,
+                          ls_err*              err)
+{
+  tube_manager_group* ret;
+  unsigned int        i;
+
+  assert(grp);
+  if (shards < 1)
+  {
+    LS_ERROR(err, LS_ERR_INVALID_ARG);
+    return false;
+  }
+
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  ret->shards = ls_data_calloc( shards, sizeof(tube_shard) );
+  if (!ret->shards)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    ls_data_free(ret);
+    return false;
+  }
+  ret->count = shards;
+
+  for (i = 0; i < shards; i++)
+  {
+    if ( !tube_manager_create_io(buckets, io, &ret->shards[i].mgr, err) )
+    {
+      tube_manager_group_destroy(ret);
+      return false;
+    }
+    ret->shards[i].mgr->shard  = i;
+    ret->shards[i].mgr->shards = shards;
+  }
+
+  *grp = ret;
+  return true;
+}
+
+LS_API void
+tube_manager_group_destroy(tube_manager_group* grp)
+{
+  unsigned int i;
+
+  if (!grp)
+  {
+    return;
+  }
+  if (grp->running)
+  {
+    tube_manager_group_stop(grp, NULL);
+  }
+  for (i = 0; i < grp->count; i++)
+  {
+    tube_manager_destroy(grp->shards[i].mgr);
+  }
+  ls_data_free(grp->shards);
+  ls_data_free(grp);
+}
+
+/* Steer by the second half of the tube ID, which starts 8 bytes into the */
+/* UDP payload.  The kernel falls back on its own hash if the program fails */
+/* (e.g. a short packet) or returns an index that's out of range. */
+static bool
+_attach_steering(int          sock,
+                 unsigned int shards,
+                 ls_err*      err)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  struct sock_filter code[] = {
+    /* A = ntohl(*(uint32_t*)&payload[8]) */
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, 8 },
+    /* A %= shards */
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, shards },
+    /* return A */
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  struct sock_fprog prog = {
+    .len    = sizeof(code) / sizeof(code[0]),
+    .filter = code,
+  };
+
+  if (setsockopt( sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                  &prog, sizeof(prog) ) != 0)
+  {
+    LS_ERROR(err, -errno);
+    return false;
+  }
+  return true;
+#else
+  UNUSED_PARAM(sock);
+  UNUSED_PARAM(shards);
+  LS_ERROR(err, LS_ERR_NO_IMPL);
+  return false;
+#endif
+}
+
+LS_API bool
+tube_manager_group_socket(tube_manager_group* grp,
+                          int                 port,
+                          ls_err*             err)
+{
+  tube_manager*           first;
+  struct sockaddr_storage addr;
+  socklen_t               len = sizeof(addr);
+  unsigned int            i;
+  bool                    responder = (port != 0);
+
+  assert(grp);
+  if (grp->count == 1)
+  {
+    return tube_manager_socket(grp->shards[0].mgr, port, err);
+  }
+
+  /* Shard i has to be socket i in the reuseport group, so bind in order. */
+  first = grp->shards[0].mgr;
+  if ( !_tube_manager_socket(first, port, true, err) )
+  {
+    return false;
+  }
+  if (port == 0)
+  {
+    if (getsockname(first->sock6, (struct sockaddr*)&addr, &len) != 0)
+    {
+      LS_ERROR(err, -errno);
+      return false;
+    }
+    port = ls_sockaddr_get_port( (struct sockaddr*)&addr );
+  }
+
+  for (i = 1; i < grp->count; i++)
+  {
+    if ( !_tube_manager_socket(grp->shards[i].mgr, port, true, err) )
+    {
+      return false;
+    }
+  }
+
+  /* The program applies to the whole reuseport group of the socket. */
+  if ( !_attach_steering(first->sock6, grp->count, err) ||
+       !_attach_steering(first->sock4, grp->count, err) )
+  {
+    return false;
+  }
+
+  for (i = 0; i < grp->count; i++)
+  {
+    tube_manager_set_policy_responder(grp->shards[i].mgr, responder);
+  }
+  return true;
+}
+
+LS_API unsigned int
+tube_manager_group_count(tube_manager_group* grp)
+{
+  assert(grp);
+  return grp->count;
+}
+
+LS_API tube_manager*
+tube_manager_group_get(tube_manager_group* grp,
+                       unsigned int        i)
+{
+  assert(grp);
+  assert(i < grp->count);
+  return grp->shards[i].mgr;
+}
+
+LS_API bool
+tube_manager_group_bind_event(tube_manager_group*      grp,
+                              const char*              name,
+                              ls_event_notify_callback cb,
+                              ls_err*                  err)
+{
+  unsigned int i;
+
+  assert(grp);
+  for (i = 0; i < grp->count; i++)
+  {
+    if ( !tube_manager_bind_event(grp->shards[i].mgr, name, cb, err) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+LS_API size_t
+tube_manager_group_size(tube_manager_group* grp)
+{
+  size_t       ret = 0;
+  unsigned int i;
+
+  assert(grp);
+  for (i = 0; i < grp->count; i++)
+  {
+    ret += tube_manager_size(grp->shards[i].mgr);
+  }
+  return ret;
+}
+
+LS_API bool
+tube_manager_group_open_tube(tube_manager_group*    grp,
+                             const struct sockaddr* dest,
+                             tube**                 t,
+                             ls_err*                err)
+{
+  tube_manager* mgr;
+
+  assert(grp);
+  if (grp->running)
+  {
+    /* the shard's loop owns its tubes now */
+    LS_ERROR(err, LS_ERR_INVALID_STATE);
+    return false;
+  }
+  mgr            = grp->shards[grp->next_open].mgr;
+  grp->next_open = (grp->next_open + 1) % grp->count;
+  return tube_manager_open_tube(mgr, dest, t, err);
+}
+
+static void*
+_shard_run(void* p)
+{
+  tube_shard* shard = p;
+
+  shard->loop_ret = tube_manager_loop(shard->mgr, &shard->loop_err);
+  if (!shard->loop_ret)
+  {
+    LS_LOG_ERR(shard->loop_err, "tube_manager_loop");
+  }
+  return shard;
+}
+
+LS_API bool
+tube_manager_group_start(tube_manager_group* grp,
+                         ls_err*             err)
+{
+  unsigned int i;
+  int          r;
+
+  assert(grp);
+  grp->running = true;
+  for (i = 0; i < grp->count; i++)
+  {
+    r = pthread_create(&grp->shards[i].thread, NULL, _shard_run,
+                       &grp->shards[i]);
+    if (r != 0)
+    {
+      LS_ERROR(err, -r);
+      tube_manager_group_stop(grp, NULL);
+      return false;
+    }
+    grp->shards[i].started = true;
+  }
+  return true;
+}
+
+LS_API bool
+tube_manager_group_stop(tube_manager_group* grp,
+                        ls_err*             err)
+{
+  bool         ret = true;
+  unsigned int i;
+  ls_err       stop_err;
+
+  assert(grp);
+  for (i = 0; i < grp->count; i++)
+  {
+    if ( !tube_manager_stop(grp->shards[i].mgr, &stop_err) )
+    {
+      LS_LOG_ERR(stop_err, "tube_manager_stop");
+    }
+  }
+  for (i = 0; i < grp->count; i++)
+  {
+    if (!grp->shards[i].started)
+    {
+      continue;
+    }
+    pthread_join(grp->shards[i].thread, NULL);
+    grp->shards[i].started = false;
+    if (ret && !grp->shards[i].loop_ret)
+    {
+      if (err)
+      {
+        *err = grp->shards[i].loop_err;
+      }
+      ret = false;
+    }
+  }
+  grp->running = false;
+  return ret;
+}
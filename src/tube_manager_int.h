@@ -10,7 +10,11 @@
 
 #include "tube_manager.h"
 #include "ls_eventing.h"
-#include "ls_htable.h"
+#include "ls_mpsc.h"
+#include "tube_cookie.h"
+#include "tube_limit.h"
+#include "tube_slab.h"
+#include "tube_table.h"
 
 struct _tube_manager
 {
@@ -19,20 +23,72 @@ struct _tube_manager
   int                     sock6;
   int                     pipe[2];
   int                     max_fd;
-  ls_htable*              tubes;
+  tube_table*             tubes;
+  tube_slab*              tube_slab;
   ls_event_dispatcher*    dispatcher;
-  struct gpriority_queue* timer_q;
-  struct timeval          last;
-  pthread_mutex_t         lock;
+  struct _ls_timer_heap*  timer_q;
+  tube_timer_backend      timer_backend;
+  struct _ls_timer_wheel* timer_wheel;
+  /* the timer whose callback is running, if any */
+  struct _ls_timer*       timer_running;
+  /* work posted from other threads, run on the loop thread */
+  ls_mpsc                 posts;
+  /* CLOCK_MONOTONIC nanoseconds, as of the latest event */
+  uint64_t                last;
   ls_event*               e_loopstart;
   ls_event*               e_running;
   ls_event*               e_data;
+  ls_event*               e_data_batch;
   ls_event*               e_close;
   ls_event*               e_add;
   ls_event*               e_remove;
   tube_policies           policy;
   bool                    keep_going;
   void*                   data;
+  unsigned int            rx_count;
+  struct _tube_recv_slot* rx_slots;
+  struct mmsghdr*         rx_msgs;
+  unsigned int            tx_count;
+  unsigned int            tx_len;
+  struct _tube_send_slot* tx_slots;
+  struct mmsghdr*         tx_msgs;
+  /* where tube_data_burst() lays out its datagrams; made on first use */
+  uint8_t*                burst_buf;
+  tube_io_backend         io;
+  int                     epfd;
+  int                     timerfd;
+  bool                    timer_armed;
+  uint64_t                timer_deadline;
+  unsigned int            ready;
+  unsigned int            ready_turn;
+  unsigned int            ready_polls;
+  struct _tube_uring*     uring;
+  pthread_t               loop_thread;
+  bool                    in_loop;
+  bool                    gso;
+  bool                    gro;
+  uint8_t*                gro_buf;
+  ls_pool*                parse_pool;
+  cn_cbor_context         parse_ctx;
+  /* data packets collected from the current receive, when batching; the */
+  /* parse pool isn't reset until they have been delivered */
+  bool                    data_batch;
+  tube_event_data*        batch;
+  struct _tube_peer*      batch_peers;
+  size_t                  batch_count;
+  size_t                  batch_size;
+  /* answer OPENs with a cookie rather than a tube */
+  bool                    open_cookies;
+  tube_cookie_key         cookie_key;
+  /* per-source limits, or NULL for none, and what they've dropped */
+  tube_limit*             packet_limit;
+  tube_limit*             open_limit;
+  uint64_t                packets_limited;
+  uint64_t                opens_limited;
+  /* when to next summarize rate-limited log messages */
+  uint64_t                log_flush_at;
+  unsigned int            shard;
+  unsigned int            shards;
 };
 
 /**
@@ -40,27 +96,61 @@ struct _tube_manager
  *
  * \invariant m != NULL
  * \param[in] m The tube manager to initialize
- * \param[in] buckets The tubes hashtable bucket size
+ * \param[in] buckets Number of tubes to size the tube table for
+ * \param[in] io The I/O mechanism to wait with
  * \param[out] err If non-NULL on input, describes error if false is returned
  * \return true: m in initialized.  false: see err.
  */
 bool
-_tube_manager_init(tube_manager* m,
-                   int           buckets,
-                   ls_err*       err);
+_tube_manager_init(tube_manager*   m,
+                   int             buckets,
+                   tube_io_backend io,
+                   ls_err*         err);
+
+/**
+ * Get the manager's scratch buffer for tube_data_burst(), creating it the
+ * first time.  Only for the thread that owns the manager's tubes.
+ *
+ * \invariant mgr != NULL
+ * \param[in]  mgr  The tube manager
+ * \param[in]  size The buffer's size; the same on every call
+ * \param[out] err  If non-NULL on input, describes error if NULL is returned
+ * \return The buffer, or NULL; see err.
+ */
+uint8_t*
+_tube_manager_burst_buf(tube_manager* mgr,
+                        size_t        size,
+                        ls_err*       err);
 
 /**
  * Finalizes a tube manager.  Useful for subclasses.
  *
  * \invariant m != NULL
  * \param[in] mgr The tube manager to finalize
- * \param[in] buckets The tubes hashtable bucket size
  * \param[out] err If non-NULL on input, describes error if false is returned
  * \return true: m in initialized.  false: see err.
  */
 void
 _tube_manager_finalize(tube_manager* mgr);
 
+/**
+ * Create the manager's sockets, as in tube_manager_socket().  With
+ * reuseport, SO_REUSEPORT is set on both sockets before binding, and if port
+ * is 0 the v4 socket is bound to the same port the v6 socket got.
+ *
+ * \invariant m != NULL
+ * \param[in] m The tube manager
+ * \param[in] port The port to bind to, or 0 for any
+ * \param[in] reuseport Whether other sockets may share the port
+ * \param[out] err If non-NULL on input, describes error if false is returned
+ * \return true: sockets created.  false: see err.
+ */
+bool
+_tube_manager_socket(tube_manager* m,
+                     int           port,
+                     bool          reuseport,
+                     ls_err*       err);
+
 /**
  * Get the tube manager's event dispatcher. Useful for subclasses.
  */
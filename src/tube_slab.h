@@ -0,0 +1,72 @@
+/**
+ * \file
+ * \brief
+ * Slab of tube objects, so that a manager can create and destroy tubes
+ * without going to the heap each time.  Tubes are carved out of chunks of
+ * TUBE_SLAB_CHUNK at a time, and destroyed tubes go on a free list for the
+ * next tube_create_slab().
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.  Users MUST ensure that all tubes
+ * from a slab are created and destroyed on a single thread.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include "tube.h"
+
+/** Number of tubes allocated at a time */
+#define TUBE_SLAB_CHUNK 64
+
+/** An instance of a slab */
+typedef struct _tube_slab tube_slab;
+
+/**
+ * Create a slab.  No tubes are allocated until the first
+ * tube_create_slab().
+ *
+ * \invariant slab != NULL
+ * \param[out] slab The created slab
+ * \param[out] err  The error information (provide NULL to ignore)
+ * \return bool     true if successful, false otherwise.
+ */
+LS_API bool
+tube_slab_create(tube_slab** slab,
+                 ls_err*     err);
+
+/**
+ * Destroy a slab, and the memory for all of its tubes.  Every tube created
+ * from the slab must have been destroyed first.
+ *
+ * \param[in] slab The slab to destroy.  NULL is a no-op.
+ */
+LS_API void
+tube_slab_destroy(tube_slab* slab);
+
+/**
+ * Number of tubes from this slab that have not been destroyed.
+ *
+ * \invariant slab != NULL
+ * \param[in] slab The slab
+ * \return The count
+ */
+LS_API size_t
+tube_slab_live(tube_slab* slab);
+
+/**
+ * Create a tube from a slab, as with tube_create().  tube_destroy() puts it
+ * back.
+ *
+ * \invariant slab != NULL
+ * \invariant t != NULL
+ * \param[in]  slab The slab to take the tube from
+ * \param[out] t    The created tube
+ * \param[out] err  The error information (provide NULL to ignore)
+ * \return bool     true if successful, false otherwise.
+ */
+LS_API bool
+tube_create_slab(tube_slab* slab,
+                 tube**     t,
+                 ls_err*    err);
@@ -131,7 +131,8 @@ tube_stream_manager_create(int                   buckets,
     *sm = ret = NULL;
     return false;
   }
-  if ( !_tube_manager_init( (tube_manager*)ret, buckets, err ) )
+  if ( !_tube_manager_init( (tube_manager*)ret, buckets, TUBE_IO_DEFAULT,
+                            err ) )
   {
     ls_data_free(ret);
     *sm = ret = NULL;
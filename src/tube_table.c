@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "tube_table.h"
+#include "tube.h"
+#include "ls_mem.h"
+
+/* Smallest table, in slots */
+#define MIN_SLOTS 16
+/* Grow when more than 7/8 full */
+#define LOAD_NUM 7
+#define LOAD_DEN 8
+/* Probe distances are kept in a byte; grow before one would overflow. */
+#define MAX_DIST 255
+
+static inline uint64_t
+_key(const spud_tube_id* id)
+{
+  uint64_t k;
+  memcpy( &k, id->octet, sizeof(k) );
+  return k;
+}
+
+/* IDs are random, unless a peer picked them to collide; the seed keeps */
+/* that from working. */
+static inline size_t
+_home(const tube_table* tbl,
+      uint64_t          k)
+{
+  k ^= tbl->seed;
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return (size_t)k & tbl->mask;
+}
+
+static bool
+_alloc_slots(size_t             slots,
+             uint8_t**          dist,
+             tube_table_entry** entries,
+             ls_err*            err)
+{
+  *dist    = ls_data_calloc(slots, 1);
+  *entries = ls_data_malloc( slots * sizeof(tube_table_entry) );
+  if (!*dist || !*entries)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    ls_data_free(*dist);
+    ls_data_free(*entries);
+    return false;
+  }
+  return true;
+}
+
+/* Whether _insert() would succeed: the same probe, without moving anything. */
+/* Taking a resident's slot carries on with that resident's distance. */
+static bool
+_fits(const tube_table* tbl,
+      uint64_t          key)
+{
+  size_t       i = _home(tbl, key);
+  unsigned int d = 1;
+
+  while (tbl->dist[i])
+  {
+    if (tbl->dist[i] < d)
+    {
+      d = tbl->dist[i];
+    }
+    i = (i + 1) & tbl->mask;
+    if (++d > MAX_DIST)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Robin Hood insert of a key known not to be in the table.  Returns false */
+/* if some entry would end up too far from home, in which case the entry */
+/* being carried at that point, not necessarily key, is left out; only */
+/* call this on a table that can be thrown away, or after _fits(). */
+static bool
+_insert(tube_table*   tbl,
+        uint64_t      key,
+        struct _tube* t)
+{
+  tube_table_entry e = {key, t};
+  tube_table_entry tmp;
+  size_t           i = _home(tbl, key);
+  unsigned int     d = 1;
+  uint8_t          td;
+
+  while (tbl->dist[i])
+  {
+    if (tbl->dist[i] < d)
+    {
+      /* take from the rich */
+      tmp             = tbl->entries[i];
+      td              = tbl->dist[i];
+      tbl->entries[i] = e;
+      tbl->dist[i]    = (uint8_t)d;
+      e               = tmp;
+      d               = td;
+    }
+    i = (i + 1) & tbl->mask;
+    if (++d > MAX_DIST)
+    {
+      return false;
+    }
+  }
+  tbl->entries[i] = e;
+  tbl->dist[i]    = (uint8_t)d;
+  return true;
+}
+
+static bool
+_resize(tube_table* tbl,
+        size_t      slots,
+        ls_err*     err)
+{
+  uint8_t*          old_dist    = tbl->dist;
+  tube_table_entry* old_entries = tbl->entries;
+  size_t            old_slots   = tbl->mask + 1;
+  size_t            i;
+
+  while (true)
+  {
+    if ( !_alloc_slots(slots, &tbl->dist, &tbl->entries, err) )
+    {
+      tbl->dist    = old_dist;
+      tbl->entries = old_entries;
+      return false;
+    }
+    tbl->mask = slots - 1;
+    for (i = 0; i < old_slots; i++)
+    {
+      if ( old_dist[i] &&
+           !_insert(tbl, old_entries[i].key, old_entries[i].t) )
+      {
+        break;
+      }
+    }
+    if (i == old_slots)
+    {
+      break;
+    }
+    /* pathological clustering; try again with more room */
+    ls_data_free(tbl->dist);
+    ls_data_free(tbl->entries);
+    slots *= 2;
+  }
+  ls_data_free(old_dist);
+  ls_data_free(old_entries);
+  return true;
+}
+
+/* Index of key, or -1 */
+static inline ssize_t
+_find(const tube_table* tbl,
+      uint64_t          key)
+{
+  size_t       i = _home(tbl, key);
+  unsigned int d = 1;
+
+  /* once we're further from home than the resident, key can't be here */
+  while (tbl->dist[i] >= d)
+  {
+    if (tbl->entries[i].key == key)
+    {
+      return (ssize_t)i;
+    }
+    i = (i + 1) & tbl->mask;
+    d++;
+  }
+  return -1;
+}
+
+LS_API bool
+tube_table_create(size_t       capacity,
+                  tube_table** tbl,
+                  ls_err*      err)
+{
+  tube_table*  ret;
+  spud_tube_id seed;
+  size_t       slots = MIN_SLOTS;
+
+  assert(tbl);
+  while (slots * LOAD_NUM / LOAD_DEN < capacity)
+  {
+    slots *= 2;
+  }
+
+  ret = ls_data_calloc( 1, sizeof(*ret) );
+  if (!ret)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  if ( !spud_create_id(&seed, err) ||
+       !_alloc_slots(slots, &ret->dist, &ret->entries, err) )
+  {
+    ls_data_free(ret);
+    return false;
+  }
+  ret->seed = _key(&seed);
+  ret->mask = slots - 1;
+  *tbl      = ret;
+  return true;
+}
+
+LS_API void
+tube_table_destroy(tube_table* tbl)
+{
+  if (!tbl)
+  {
+    return;
+  }
+  ls_data_free(tbl->dist);
+  ls_data_free(tbl->entries);
+  ls_data_free(tbl);
+}
+
+LS_API size_t
+tube_table_count(tube_table* tbl)
+{
+  assert(tbl);
+  return tbl->count;
+}
+
+LS_API struct _tube*
+tube_table_get(tube_table*         tbl,
+               const spud_tube_id* id)
+{
+  ssize_t i;
+
+  assert(tbl);
+  assert(id);
+  i = _find( tbl, _key(id) );
+  return (i < 0) ? NULL : tbl->entries[i].t;
+}
+
+LS_API bool
+tube_table_put(tube_table*         tbl,
+               const spud_tube_id* id,
+               struct _tube*       t,
+               struct _tube**      replaced,
+               ls_err*             err)
+{
+  uint64_t key;
+  ssize_t  i;
+  bool     fit;
+
+  assert(tbl);
+  assert(id);
+  assert(t);
+
+  key = _key(id);
+  i   = _find(tbl, key);
+  if (i >= 0)
+  {
+    if (replaced)
+    {
+      *replaced = tbl->entries[i].t;
+    }
+    tbl->entries[i].t = t;
+    return true;
+  }
+
+  if ( ( (tbl->count + 1) * LOAD_DEN > (tbl->mask + 1) * LOAD_NUM ) &&
+       !_resize(tbl, (tbl->mask + 1) * 2, err) )
+  {
+    return false;
+  }
+  /* grow before moving anything, so a failed probe can't strand an entry */
+  /* that was displaced along the way */
+  while ( !_fits(tbl, key) )
+  {
+    if ( !_resize(tbl, (tbl->mask + 1) * 2, err) )
+    {
+      return false;
+    }
+  }
+  fit = _insert(tbl, key, t);
+  assert(fit);
+  (void)fit;
+  tbl->count++;
+  if (replaced)
+  {
+    *replaced = NULL;
+  }
+  return true;
+}
+
+LS_API struct _tube*
+tube_table_remove(tube_table*         tbl,
+                  const spud_tube_id* id)
+{
+  struct _tube* ret;
+  ssize_t       found;
+  size_t        i, next;
+
+  assert(tbl);
+  assert(id);
+
+  found = _find( tbl, _key(id) );
+  if (found < 0)
+  {
+    return NULL;
+  }
+  i   = (size_t)found;
+  ret = tbl->entries[i].t;
+
+  /* shift the rest of the cluster back a slot, so lookups never have to */
+  /* step over a hole */
+  next = (i + 1) & tbl->mask;
+  while (tbl->dist[next] > 1)
+  {
+    tbl->entries[i] = tbl->entries[next];
+    tbl->dist[i]    = tbl->dist[next] - 1;
+    i               = next;
+    next            = (next + 1) & tbl->mask;
+  }
+  tbl->dist[i] = 0;
+  tbl->count--;
+  return ret;
+}
+
+LS_API unsigned int
+tube_table_walk(tube_table*         tbl,
+                tube_table_walkfunc func,
+                void*               user_data)
+{
+  unsigned int  count = 0;
+  size_t        start;
+  size_t        i;
+  spud_tube_id* id;
+
+  assert(tbl);
+  assert(func);
+
+  if (tbl->count == 0)
+  {
+    return 0;
+  }
+
+  /* Walk backwards from an empty slot.  Removing the current entry only */
+  /* shifts entries from slots that have already been visited. */
+  for (start = 0; tbl->dist[start]; start++)
+  {
+  }
+  i = start;
+  do
+  {
+    i = (i - 1) & tbl->mask;
+    if (tbl->dist[i])
+    {
+      count++;
+      tube_get_id(tbl->entries[i].t, &id);
+      if ( !(*func)(user_data, id, tbl->entries[i].t) )
+      {
+        break;
+      }
+    }
+  } while (i != start);
+  return count;
+}
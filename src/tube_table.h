@@ -0,0 +1,151 @@
+/**
+ * \file
+ * \brief
+ * Table of tubes, keyed by tube ID.  Open addressing with Robin Hood
+ * insertion and backward-shift deletion; the 8-byte ID is stored inline as
+ * the key, next to the tube pointer, so a lookup that hits usually touches
+ * one byte of probe metadata and one cache line of entries.
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.  Users MUST ensure access to all
+ * instances of a table is limited to a single thread.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include "ls_basics.h"
+#include "ls_error.h"
+#include "spud.h"
+
+struct _tube;
+
+/* 16 bytes, so four to a cache line */
+typedef struct _tube_table_entry
+{
+  uint64_t      key;
+  struct _tube* t;
+} tube_table_entry;
+
+/** An instance of a tube table */
+typedef struct _tube_table
+{
+  /* dist[i] is 0 for an empty slot, otherwise 1 + how far entries[i] is */
+  /* from its home slot */
+  uint8_t*          dist;
+  tube_table_entry* entries;
+  size_t            mask;
+  size_t            count;
+  uint64_t          seed;
+} tube_table;
+
+/**
+ * Function called for each entry by tube_table_walk().  Same shape as
+ * tube_walker_func.
+ *
+ * \param user_data Optional data provided
+ * \param id        The ID of the current tube
+ * \param t         The current tube
+ * \retval int 0 to stop walking, or 1 to continue.
+ */
+typedef int (* tube_table_walkfunc)(void*               user_data,
+                                    const spud_tube_id* id,
+                                    struct _tube*       t);
+
+/**
+ * Create a table.
+ *
+ * \invariant tbl != NULL
+ * \param[in]  capacity Number of tubes to make room for up front.  The table
+ *                      grows as needed.
+ * \param[out] tbl      The created table
+ * \param[out] err      The error information (provide NULL to ignore)
+ * \return bool         true if successful, false otherwise.
+ */
+LS_API bool
+tube_table_create(size_t       capacity,
+                  tube_table** tbl,
+                  ls_err*      err);
+
+/**
+ * Destroy a table.  The tubes in it are not touched.
+ *
+ * \param[in] tbl The table to destroy.  NULL is a no-op.
+ */
+LS_API void
+tube_table_destroy(tube_table* tbl);
+
+/**
+ * Number of tubes in the table.
+ *
+ * \invariant tbl != NULL
+ * \param[in] tbl The table
+ * \return The count
+ */
+LS_API size_t
+tube_table_count(tube_table* tbl);
+
+/**
+ * Find a tube.
+ *
+ * \invariant tbl != NULL
+ * \invariant id != NULL
+ * \param[in] tbl The table
+ * \param[in] id  The tube ID to look for
+ * \return The tube, or NULL if it isn't there
+ */
+LS_API struct _tube*
+tube_table_get(tube_table*         tbl,
+               const spud_tube_id* id);
+
+/**
+ * Add a tube, replacing any tube already stored under the same ID.
+ *
+ * \invariant tbl != NULL
+ * \invariant id != NULL
+ * \invariant t != NULL
+ * \param[in]  tbl      The table
+ * \param[in]  id       The tube ID
+ * \param[in]  t        The tube
+ * \param[out] replaced The tube that was there before, or NULL.  May be NULL.
+ * \param[out] err      The error information (provide NULL to ignore)
+ * \return bool         true if successful, false otherwise.
+ */
+LS_API bool
+tube_table_put(tube_table*         tbl,
+               const spud_tube_id* id,
+               struct _tube*       t,
+               struct _tube**      replaced,
+               ls_err*             err);
+
+/**
+ * Remove a tube.
+ *
+ * \invariant tbl != NULL
+ * \invariant id != NULL
+ * \param[in] tbl The table
+ * \param[in] id  The tube ID to remove
+ * \return The tube that was removed, or NULL if it wasn't there
+ */
+LS_API struct _tube*
+tube_table_remove(tube_table*         tbl,
+                  const spud_tube_id* id);
+
+/**
+ * Call a function for every tube in the table, in no particular order.
+ * The function may remove the tube it was called for, but must not
+ * otherwise change the table.
+ *
+ * \invariant tbl != NULL
+ * \invariant func != NULL
+ * \param[in] tbl       The table
+ * \param[in] func      Function to be called for each tube
+ * \param[in] user_data Value to use as the first parameter for func
+ * \return Number of tubes visited up to and including the one for which func
+ *         returned 0, if it did
+ */
+LS_API unsigned int
+tube_table_walk(tube_table*         tbl,
+                tube_table_walkfunc func,
+                void*               user_data);
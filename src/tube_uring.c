@@ -0,0 +1,654 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#ifdef __linux__
+/* needed for in6_pktinfo */
+#define _GNU_SOURCE 1
+#endif
+
+#include "tube_uring.h"
+
+#ifdef TUBE_HAVE_URING
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ls_log.h"
+#include "ls_mem.h"
+
+/* user_data is the kind of operation in the top byte, and the fd or send */
+/* slot number in the rest. */
+#define UD_RECV 1ULL
+#define UD_POLL 2ULL
+#define UD_SEND 3ULL
+#define UD_MAKE(kind, n) ( ( (kind) << 56 ) | (uint64_t)(n) )
+#define UD_KIND(ud) ( (ud) >> 56 )
+#define UD_VALUE(ud) ( (ud) & ( (1ULL << 56) - 1 ) )
+
+#ifndef MIN
+#define MIN(a,b) ( ( (a) < (b) ) ? (a) : (b) )
+#endif
+#ifndef MAX
+#define MAX(a,b) ( ( (a) > (b) ) ? (a) : (b) )
+#endif
+
+#define BUF_GROUP 0
+#define NUM_BUFS 512 /* must be a power of 2 */
+#define MAX_PAYLOAD 2048
+#define CTL_SIZE ( CMSG_SPACE( sizeof(struct in6_pktinfo) ) + \
+                   CMSG_SPACE( sizeof(struct timespec) ) )
+#define BUF_SIZE ( sizeof(struct io_uring_recvmsg_out) + \
+                   sizeof(struct sockaddr_storage) + CTL_SIZE + MAX_PAYLOAD )
+
+typedef struct _tube_uring_tx
+{
+  struct msghdr           hdr;
+  struct iovec            iov;
+  struct sockaddr_storage addr;
+  uint8_t                 ctl[CMSG_SPACE( sizeof(struct in6_pktinfo) )];
+  uint8_t                 buf[MAX_PAYLOAD];
+  int                     next_free;
+} tube_uring_tx;
+
+struct _tube_uring
+{
+  int fd;
+
+  /* both rings live in one mapping (IORING_FEAT_SINGLE_MMAP) */
+  void*                rings;
+  size_t               rings_len;
+  struct io_uring_sqe* sqes;
+  size_t               sqes_len;
+
+  unsigned int* sq_head;
+  unsigned int* sq_tail;
+  unsigned int  sq_mask;
+  unsigned int  sq_entries;
+  unsigned int  sq_local_tail;
+
+  unsigned int*        cq_head;
+  unsigned int*        cq_tail;
+  unsigned int         cq_mask;
+  struct io_uring_cqe* cqes;
+
+  /* provided buffers for recvmsg */
+  struct io_uring_buf_ring* br;
+  size_t                    br_len;
+  uint8_t*                  bufs;
+  unsigned short            br_tail;
+  int                       held_bid;
+  struct msghdr             recv_tmpl;
+
+  /* sends waiting for their completions */
+  tube_uring_tx* tx;
+  unsigned int   ntx;
+  int            tx_free;
+};
+
+static int
+_setup(unsigned int            entries,
+       struct io_uring_params* p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+_enter(int                                  fd,
+       unsigned int                         to_submit,
+       unsigned int                         min_complete,
+       unsigned int                         flags,
+       const struct io_uring_getevents_arg* arg)
+{
+  return (int)syscall( __NR_io_uring_enter, fd, to_submit, min_complete,
+                       flags, arg, arg ? sizeof(*arg) : 0 );
+}
+
+static int
+_register(int          fd,
+          unsigned int opcode,
+          void*        arg,
+          unsigned int nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+bool
+tube_uring_available(void)
+{
+  /* -1: don't know yet */
+  static int              available = -1;
+  struct io_uring_params  p;
+  struct io_uring_probe*  probe;
+  const unsigned int      feats = IORING_FEAT_SINGLE_MMAP |
+                                  IORING_FEAT_NODROP |
+                                  IORING_FEAT_EXT_ARG;
+  int fd;
+
+  if (available >= 0)
+  {
+    return available;
+  }
+
+  available = 0;
+  memset( &p, 0, sizeof(p) );
+  fd = _setup(4, &p);
+  if (fd < 0)
+  {
+    /* ENOSYS, or disabled with kernel.io_uring_disabled */
+    return false;
+  }
+  if ( (p.features & feats) == feats )
+  {
+    /* multishot recvmsg arrived in the same release as SEND_ZC */
+    probe = ls_data_calloc( 1, sizeof(*probe) +
+                            256 * sizeof(struct io_uring_probe_op) );
+    if (probe)
+    {
+      if ( (_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) &&
+           (probe->last_op >= IORING_OP_SEND_ZC) )
+      {
+        available = 1;
+      }
+      ls_data_free(probe);
+    }
+  }
+  close(fd);
+  return available;
+}
+
+static void
+_buf_return(tube_uring* r,
+            int         bid)
+{
+  struct io_uring_buf* b = &r->br->bufs[r->br_tail & (NUM_BUFS - 1)];
+  b->addr = (uintptr_t)(r->bufs + (size_t)bid * BUF_SIZE);
+  b->len  = BUF_SIZE;
+  b->bid  = bid;
+  r->br_tail++;
+  __atomic_store_n(&r->br->tail, r->br_tail, __ATOMIC_RELEASE);
+}
+
+bool
+tube_uring_create(unsigned int entries,
+                  tube_uring** ring,
+                  ls_err*      err)
+{
+  tube_uring*            r;
+  struct io_uring_params p;
+  unsigned int           i;
+  uint8_t*               base;
+
+  assert(ring);
+  r = ls_data_calloc( 1, sizeof(*r) );
+  if (!r)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    return false;
+  }
+  r->fd       = -1;
+  r->rings    = MAP_FAILED;
+  r->sqes     = MAP_FAILED;
+  r->br       = MAP_FAILED;
+  r->held_bid = -1;
+
+  memset( &p, 0, sizeof(p) );
+  /* leave plenty of room for multishot completions to pile up */
+  p.flags      = IORING_SETUP_CQSIZE;
+  p.cq_entries = NUM_BUFS * 2;
+  r->fd        = _setup(entries, &p);
+  if (r->fd < 0)
+  {
+    LS_ERROR(err, -errno);
+    goto error;
+  }
+
+  r->rings_len = MAX( p.sq_off.array + p.sq_entries * sizeof(unsigned int),
+                      p.cq_off.cqes + p.cq_entries *
+                      sizeof(struct io_uring_cqe) );
+  r->rings = mmap(NULL, r->rings_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->rings == MAP_FAILED)
+  {
+    LS_ERROR(err, -errno);
+    goto error;
+  }
+  r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes     = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED)
+  {
+    LS_ERROR(err, -errno);
+    goto error;
+  }
+
+  base          = r->rings;
+  r->sq_head    = (unsigned int*)(base + p.sq_off.head);
+  r->sq_tail    = (unsigned int*)(base + p.sq_off.tail);
+  r->sq_mask    = *(unsigned int*)(base + p.sq_off.ring_mask);
+  r->sq_entries = p.sq_entries;
+  r->cq_head    = (unsigned int*)(base + p.cq_off.head);
+  r->cq_tail    = (unsigned int*)(base + p.cq_off.tail);
+  r->cq_mask    = *(unsigned int*)(base + p.cq_off.ring_mask);
+  r->cqes       = (struct io_uring_cqe*)(base + p.cq_off.cqes);
+
+  /* SQE i always lives in array slot i */
+  for (i = 0; i < p.sq_entries; i++)
+  {
+    ( (unsigned int*)(base + p.sq_off.array) )[i] = i;
+  }
+  r->sq_local_tail = *r->sq_tail;
+
+  /* provided buffer ring, which has to be page-aligned */
+  r->br_len = NUM_BUFS * sizeof(struct io_uring_buf);
+  r->br     = mmap(NULL, r->br_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (r->br == MAP_FAILED)
+  {
+    LS_ERROR(err, -errno);
+    goto error;
+  }
+  r->bufs = ls_data_malloc(NUM_BUFS * BUF_SIZE);
+  if (!r->bufs)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    goto error;
+  }
+  {
+    struct io_uring_buf_reg reg;
+    memset( &reg, 0, sizeof(reg) );
+    reg.ring_addr    = (uintptr_t)r->br;
+    reg.ring_entries = NUM_BUFS;
+    reg.bgid         = BUF_GROUP;
+    if (_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+      LS_ERROR(err, -errno);
+      goto error;
+    }
+  }
+  for (i = 0; i < NUM_BUFS; i++)
+  {
+    _buf_return(r, i);
+  }
+
+  /* the kernel lays out each buffer as io_uring_recvmsg_out, then the name, */
+  /* then the control messages, then the payload, using these sizes */
+  r->recv_tmpl.msg_namelen    = sizeof(struct sockaddr_storage);
+  r->recv_tmpl.msg_controllen = CTL_SIZE;
+
+  r->ntx = p.sq_entries;
+  r->tx  = ls_data_calloc( r->ntx, sizeof(tube_uring_tx) );
+  if (!r->tx)
+  {
+    LS_ERROR(err, LS_ERR_NO_MEMORY);
+    goto error;
+  }
+  for (i = 0; i < r->ntx; i++)
+  {
+    r->tx[i].next_free = (i + 1 < r->ntx) ? (int)i + 1 : -1;
+  }
+  r->tx_free = 0;
+
+  *ring = r;
+  return true;
+error:
+  tube_uring_destroy(r);
+  return false;
+}
+
+void
+tube_uring_destroy(tube_uring* r)
+{
+  if (!r)
+  {
+    return;
+  }
+  /* closing the ring cancels everything still in flight */
+  if (r->fd >= 0)
+  {
+    close(r->fd);
+  }
+  if (r->rings != MAP_FAILED)
+  {
+    munmap(r->rings, r->rings_len);
+  }
+  if (r->sqes != MAP_FAILED)
+  {
+    munmap(r->sqes, r->sqes_len);
+  }
+  if (r->br != MAP_FAILED)
+  {
+    munmap(r->br, r->br_len);
+  }
+  ls_data_free(r->bufs);
+  ls_data_free(r->tx);
+  ls_data_free(r);
+}
+
+static unsigned int
+_sq_ready(tube_uring* r)
+{
+  return r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static bool
+_submit(tube_uring*                          r,
+        unsigned int                         min_complete,
+        unsigned int                         flags,
+        const struct io_uring_getevents_arg* arg,
+        ls_err*                              err)
+{
+  __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+  if (_enter(r->fd, _sq_ready(r), min_complete, flags, arg) < 0)
+  {
+    switch (errno)
+    {
+    case ETIME:
+    case EINTR:
+      /* not errors */
+      break;
+    case EBUSY:
+    case EAGAIN:
+      /* completion queue backed up; the caller will drain it */
+      break;
+    default:
+      LS_ERROR(err, -errno);
+      return false;
+    }
+  }
+  return true;
+}
+
+static struct io_uring_sqe*
+_get_sqe(tube_uring* r,
+         ls_err*     err)
+{
+  struct io_uring_sqe* sqe;
+
+  if (_sq_ready(r) >= r->sq_entries)
+  {
+    /* full; push what we have to make room */
+    if ( !_submit(r, 0, 0, NULL, err) )
+    {
+      return NULL;
+    }
+    if (_sq_ready(r) >= r->sq_entries)
+    {
+      LS_ERROR(err, LS_ERR_OVERFLOW);
+      return NULL;
+    }
+  }
+  sqe = &r->sqes[r->sq_local_tail & r->sq_mask];
+  r->sq_local_tail++;
+  memset( sqe, 0, sizeof(*sqe) );
+  return sqe;
+}
+
+bool
+tube_uring_watch_recv(tube_uring* r,
+                      int         fd,
+                      ls_err*     err)
+{
+  struct io_uring_sqe* sqe;
+
+  assert(r);
+  sqe = _get_sqe(r, err);
+  if (!sqe)
+  {
+    return false;
+  }
+  sqe->opcode    = IORING_OP_RECVMSG;
+  sqe->fd        = fd;
+  sqe->addr      = (uintptr_t)&r->recv_tmpl;
+  sqe->len       = 1;
+  sqe->ioprio    = IORING_RECV_MULTISHOT;
+  sqe->flags     = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUF_GROUP;
+  sqe->user_data = UD_MAKE(UD_RECV, fd);
+  return true;
+}
+
+bool
+tube_uring_watch_poll(tube_uring* r,
+                      int         fd,
+                      ls_err*     err)
+{
+  struct io_uring_sqe* sqe;
+
+  assert(r);
+  sqe = _get_sqe(r, err);
+  if (!sqe)
+  {
+    return false;
+  }
+  sqe->opcode        = IORING_OP_POLL_ADD;
+  sqe->fd            = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->len           = IORING_POLL_ADD_MULTI;
+  sqe->user_data     = UD_MAKE(UD_POLL, fd);
+  return true;
+}
+
+bool
+tube_uring_queue_sendmsg(tube_uring*          r,
+                         int                  fd,
+                         const struct msghdr* msg,
+                         ls_err*              err)
+{
+  struct io_uring_sqe* sqe;
+  tube_uring_tx*       tx;
+  size_t               len = 0;
+  size_t               i;
+
+  assert(r);
+  assert(msg);
+  if ( (r->tx_free < 0) ||
+       ( msg->msg_namelen > sizeof(struct sockaddr_storage) ) ||
+       ( msg->msg_controllen > sizeof(tx->ctl) ) )
+  {
+    LS_ERROR(err, LS_ERR_OVERFLOW);
+    return false;
+  }
+  for (i = 0; i < msg->msg_iovlen; i++)
+  {
+    len += msg->msg_iov[i].iov_len;
+  }
+  if (len > MAX_PAYLOAD)
+  {
+    LS_ERROR(err, LS_ERR_OVERFLOW);
+    return false;
+  }
+
+  sqe = _get_sqe(r, err);
+  if (!sqe)
+  {
+    return false;
+  }
+
+  tx         = &r->tx[r->tx_free];
+  r->tx_free = tx->next_free;
+
+  memset( &tx->hdr, 0, sizeof(tx->hdr) );
+  memcpy(&tx->addr, msg->msg_name, msg->msg_namelen);
+  tx->hdr.msg_name    = &tx->addr;
+  tx->hdr.msg_namelen = msg->msg_namelen;
+  if (msg->msg_controllen > 0)
+  {
+    memcpy(tx->ctl, msg->msg_control, msg->msg_controllen);
+    tx->hdr.msg_control    = tx->ctl;
+    tx->hdr.msg_controllen = msg->msg_controllen;
+  }
+  len = 0;
+  for (i = 0; i < msg->msg_iovlen; i++)
+  {
+    memcpy(tx->buf + len, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+    len += msg->msg_iov[i].iov_len;
+  }
+  tx->iov.iov_base   = tx->buf;
+  tx->iov.iov_len    = len;
+  tx->hdr.msg_iov    = &tx->iov;
+  tx->hdr.msg_iovlen = 1;
+
+  sqe->opcode    = IORING_OP_SENDMSG;
+  sqe->fd        = fd;
+  sqe->addr      = (uintptr_t)&tx->hdr;
+  sqe->len       = 1;
+  sqe->user_data = UD_MAKE(UD_SEND, tx - r->tx);
+  return true;
+}
+
+static void
+_release_held(tube_uring* r)
+{
+  if (r->held_bid >= 0)
+  {
+    _buf_return(r, r->held_bid);
+    r->held_bid = -1;
+  }
+}
+
+bool
+tube_uring_submit(tube_uring* r,
+                  ls_err*     err)
+{
+  assert(r);
+  _release_held(r);
+  return _submit(r, 0, 0, NULL, err);
+}
+
+bool
+tube_uring_submit_wait(tube_uring*            r,
+                       const struct timespec* timeout,
+                       ls_err*                err)
+{
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec      ts;
+  unsigned int                  wait = 1;
+
+  assert(r);
+  _release_held(r);
+
+  if ( *r->cq_head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE) )
+  {
+    /* already have something to do */
+    wait = 0;
+  }
+
+  memset( &arg, 0, sizeof(arg) );
+  if (timeout)
+  {
+    ts.tv_sec  = timeout->tv_sec;
+    ts.tv_nsec = timeout->tv_nsec;
+    arg.ts     = (uintptr_t)&ts;
+  }
+  return _submit(r, wait, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                 &arg, err);
+}
+
+bool
+tube_uring_next(tube_uring*       r,
+                tube_uring_event* ev)
+{
+  struct io_uring_cqe*         cqe;
+  struct io_uring_recvmsg_out* out;
+  unsigned int                 head;
+  uint64_t                     ud;
+  int                          res;
+  unsigned int                 flags;
+  uint8_t*                     buf;
+  size_t                       hdr_len;
+  ls_err                       err;
+
+  assert(r);
+  assert(ev);
+  _release_held(r);
+
+  head = *r->cq_head;
+  while ( head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE) )
+  {
+    cqe   = &r->cqes[head & r->cq_mask];
+    ud    = cqe->user_data;
+    res   = cqe->res;
+    flags = cqe->flags;
+    head++;
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+    switch ( UD_KIND(ud) )
+    {
+    case UD_SEND:
+      r->tx[UD_VALUE(ud)].next_free = r->tx_free;
+      r->tx_free                    = (int)UD_VALUE(ud);
+      if (res < 0)
+      {
+        ls_log( LS_LOG_WARN, "io_uring sendmsg: %s", strerror(-res) );
+      }
+      break;
+    case UD_POLL:
+      if ( !(flags & IORING_CQE_F_MORE) &&
+           !tube_uring_watch_poll(r, (int)UD_VALUE(ud), &err) )
+      {
+        LS_LOG_ERR(err, "tube_uring_watch_poll");
+      }
+      if (res < 0)
+      {
+        break;
+      }
+      ev->kind = TUBE_URING_READABLE;
+      ev->fd   = (int)UD_VALUE(ud);
+      return true;
+    case UD_RECV:
+      if ( !(flags & IORING_CQE_F_MORE) &&
+           !tube_uring_watch_recv(r, (int)UD_VALUE(ud), &err) )
+      {
+        LS_LOG_ERR(err, "tube_uring_watch_recv");
+      }
+      if ( !(flags & IORING_CQE_F_BUFFER) )
+      {
+        /* ENOBUFS and friends, already re-armed above.  That's safe even */
+        /* for ENOBUFS: only one buffer is ever held, and _release_held() */
+        /* gave it back before this completion was read, so every buffer */
+        /* the kernel used up before running out is back in the ring. */
+        if ( (res < 0) && (res != -ENOBUFS) )
+        {
+          ls_log( LS_LOG_WARN, "io_uring recvmsg: %s", strerror(-res) );
+        }
+        break;
+      }
+      r->held_bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      buf         = r->bufs + (size_t)r->held_bid * BUF_SIZE;
+      hdr_len     = sizeof(*out) + r->recv_tmpl.msg_namelen +
+                    r->recv_tmpl.msg_controllen;
+      if ( (res < 0) || ( (size_t)res < hdr_len ) )
+      {
+        _release_held(r);
+        break;
+      }
+      out = (struct io_uring_recvmsg_out*)buf;
+
+      memset( &ev->hdr, 0, sizeof(ev->hdr) );
+      ev->kind                = TUBE_URING_RECV;
+      ev->fd                  = (int)UD_VALUE(ud);
+      ev->hdr.msg_name        = buf + sizeof(*out);
+      ev->hdr.msg_namelen     = MIN(out->namelen, r->recv_tmpl.msg_namelen);
+      ev->hdr.msg_control     = buf + sizeof(*out) + r->recv_tmpl.msg_namelen;
+      ev->hdr.msg_controllen  = out->controllen;
+      ev->hdr.msg_flags       = out->flags;
+      ev->data                = buf + hdr_len;
+      ev->len                 = MIN( (size_t)out->payloadlen,
+                                     (size_t)res - hdr_len );
+      return true;
+    default:
+      assert(false);
+      break;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * \file
+ * \brief
+ * Minimal io_uring engine used by the tube manager.  Keeps multishot
+ * recvmsg operations armed on the manager's sockets, receiving into a
+ * provided buffer ring, and batches sendmsg operations so that they all go
+ * to the kernel with the next wait.
+ * private, not for use outside library and unit tests.
+ *
+ * \b NOTE: This API is not thread-safe.  Everything except
+ * tube_uring_available() MUST be called from the thread running the loop.
+ *
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "ls_error.h"
+
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define TUBE_HAVE_URING 1
+#endif
+#endif
+
+#ifdef TUBE_HAVE_URING
+
+/** An io_uring instance */
+typedef struct _tube_uring tube_uring;
+
+/** What a completion turned out to be */
+typedef enum {
+  /** A datagram arrived */
+  TUBE_URING_RECV,
+  /** A polled file descriptor is readable */
+  TUBE_URING_READABLE
+} tube_uring_kind;
+
+/**
+ * One completion, as returned by tube_uring_next().  The pointers are valid
+ * until the next call to tube_uring_next() or tube_uring_submit_wait().
+ */
+typedef struct _tube_uring_event
+{
+  /** What happened */
+  tube_uring_kind kind;
+  /** The file descriptor it happened on */
+  int fd;
+  /** For RECV: msg_name and msg_control point at the received data */
+  struct msghdr hdr;
+  /** For RECV: the datagram */
+  const uint8_t* data;
+  /** For RECV: length of data */
+  size_t len;
+} tube_uring_event;
+
+/**
+ * Does the running kernel support everything this engine needs?  The
+ * answer is cached after the first call.
+ *
+ * \return true if tube_uring_create() can be expected to work.
+ */
+bool
+tube_uring_available(void);
+
+/**
+ * Create an io_uring instance with its buffer ring and send slots.
+ *
+ * \param[in]  entries Submission queue size.  Also the number of sends that
+ *                     can be in flight at once.
+ * \param[out] ring    The new instance
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned
+ * \return     true: ring created.  false: see err.
+ */
+bool
+tube_uring_create(unsigned int entries,
+                  tube_uring** ring,
+                  ls_err*      err);
+
+/**
+ * Tear down an io_uring instance.  Outstanding operations are cancelled.
+ *
+ * \param[in] ring The instance to destroy.  NULL is a no-op.
+ */
+void
+tube_uring_destroy(tube_uring* ring);
+
+/**
+ * Keep a multishot recvmsg armed on a datagram socket.  The operation is
+ * re-armed automatically whenever the kernel ends it.
+ *
+ * \param[in]  ring The io_uring instance
+ * \param[in]  fd   The socket to receive on
+ * \param[out] err  If non-NULL on input, contains error if false is returned
+ * \return     true: queued.  false: see err.
+ */
+bool
+tube_uring_watch_recv(tube_uring* ring,
+                      int         fd,
+                      ls_err*     err);
+
+/**
+ * Keep a multishot poll armed on a file descriptor, producing a
+ * TUBE_URING_READABLE event whenever it becomes readable.
+ *
+ * \param[in]  ring The io_uring instance
+ * \param[in]  fd   The file descriptor to poll
+ * \param[out] err  If non-NULL on input, contains error if false is returned
+ * \return     true: queued.  false: see err.
+ */
+bool
+tube_uring_watch_poll(tube_uring* ring,
+                      int         fd,
+                      ls_err*     err);
+
+/**
+ * Copy a message into a free send slot and queue a sendmsg for it.  The
+ * message goes out with the next tube_uring_submit() or
+ * tube_uring_submit_wait().
+ *
+ * \param[in]  ring The io_uring instance
+ * \param[in]  fd   The socket to send on
+ * \param[in]  msg  The message.  Not referenced after return.
+ * \param[out] err  If non-NULL on input, contains error if false is returned.
+ *                  LS_ERR_OVERFLOW if all slots are busy or the message is
+ *                  too large for a slot; the caller should send it directly.
+ * \return     true: queued.  false: see err.
+ */
+bool
+tube_uring_queue_sendmsg(tube_uring*          ring,
+                         int                  fd,
+                         const struct msghdr* msg,
+                         ls_err*              err);
+
+/**
+ * Hand everything queued to the kernel without waiting.
+ *
+ * \param[in]  ring The io_uring instance
+ * \param[out] err  If non-NULL on input, contains error if false is returned
+ * \return     true: submitted.  false: see err.
+ */
+bool
+tube_uring_submit(tube_uring* ring,
+                  ls_err*     err);
+
+/**
+ * Hand everything queued to the kernel, then wait for at least one
+ * completion.  Timeouts and signals are not errors.
+ *
+ * \param[in]  ring    The io_uring instance
+ * \param[in]  timeout Longest time to wait.  NULL waits forever.
+ * \param[out] err     If non-NULL on input, contains error if false is
+ *                     returned
+ * \return     true: done waiting.  false: see err.
+ */
+bool
+tube_uring_submit_wait(tube_uring*            ring,
+                       const struct timespec* timeout,
+                       ls_err*                err);
+
+/**
+ * Get the next interesting completion.  Send completions are consumed
+ * silently, and the buffer from the previous RECV event is given back to
+ * the kernel.
+ *
+ * \param[in]  ring The io_uring instance
+ * \param[out] ev   Where to put the completion
+ * \return     true: ev is filled in.  false: nothing left to look at.
+ */
+bool
+tube_uring_next(tube_uring*       ring,
+                tube_uring_event* ev);
+
+#endif
@@ -40,6 +40,21 @@ typedef struct _fn_ptr_wrapper
 
 static log_t g_audit;
 
+/* walk an event's bindings in order */
+static ls_event_binding_t*
+_first_binding(ls_event* evt)
+{
+  return evt->bindings ? &evt->bindings->entries[0] : NULL;
+}
+
+static ls_event_binding_t*
+_next_binding(ls_event*           evt,
+              ls_event_binding_t* b)
+{
+  size_t i = b - evt->bindings->entries + 1;
+  return (i < evt->bindings->count) ? &evt->bindings->entries[i] : NULL;
+}
+
 static const char*
 log_event_message(const char* cb,
                   ls_event*   notifier,
@@ -544,6 +559,17 @@ async_callback(ls_event_data* evt,
   ++*call_count;
 }
 
+static void
+nested_count_callback(ls_event_data* evt,
+                      void*          arg)
+{
+  ls_event* inner = arg;
+  uint32_t* count = evt->data;
+
+  ++*count;
+  ASSERT_TRUE( ls_event_trigger(inner, count, NULL, NULL, NULL) );
+}
+
 CTEST_DATA(event) {
   void* placeholder;
 };
@@ -657,6 +683,25 @@ CTEST2(event, create)
   ASSERT_TRUE(evt2 != evt3);
 }
 
+CTEST2(event, ids)
+{
+  ls_event* evt1, * evt2, * evt3;
+
+  UNUSED_PARAM(data);
+  evt1 = ls_event_dispatcher_get_event(g_dispatcher, "mockEvent1");
+  evt2 = ls_event_dispatcher_get_event(g_dispatcher, "mockEvent2");
+  ASSERT_EQUAL(ls_event_get_id(evt1), 0);
+  ASSERT_EQUAL(ls_event_get_id(evt2), 1);
+  ASSERT_TRUE(ls_event_dispatcher_get_event_by_id(g_dispatcher, 0) == evt1);
+  ASSERT_TRUE(ls_event_dispatcher_get_event_by_id(g_dispatcher, 1) == evt2);
+  ASSERT_NULL( ls_event_dispatcher_get_event_by_id(g_dispatcher, 2) );
+
+  ASSERT_TRUE( ls_event_dispatcher_create_event(g_dispatcher, "eventTheThird",
+                                                &evt3, NULL) );
+  ASSERT_EQUAL(ls_event_get_id(evt3), 2);
+  ASSERT_TRUE(ls_event_dispatcher_get_event_by_id(g_dispatcher, 2) == evt3);
+}
+
 CTEST2(event, bindings)
 {
   UNUSED_PARAM(data);
@@ -672,68 +717,68 @@ CTEST2(event, bindings)
   ls_event_unbind(evt1, mock_evt1_callback1);
 
   ASSERT_TRUE( ls_event_bind(evt1, mock_evt1_callback1, NULL, &err) );
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_NULL(b->arg);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ls_event_unbind(evt1, mock_evt1_callback1);
   ASSERT_NULL(evt1->bindings);
 
   arg1 = "first bound argument";
   ASSERT_TRUE( ls_event_bind(evt1, mock_evt1_callback1, arg1, &err) );
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_TRUE(b->arg == arg1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_TRUE( ls_event_bind(evt1, mock_evt1_callback2, NULL, &err) );
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_TRUE(b->arg == arg1);
-  ASSERT_NOT_NULL(b->next);
-  b = b->next;
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback2);
   ASSERT_NULL(b->arg);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ls_event_unbind(evt1, mock_evt1_callback2);
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_TRUE(b->arg == arg1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   arg2 = "second bound argument";
   ASSERT_TRUE( ls_event_bind(evt1, mock_evt1_callback2, arg2, &err) );
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_TRUE(b->arg == arg1);
-  ASSERT_NOT_NULL(b->next);
-  b = b->next;
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback2);
   ASSERT_TRUE(b->arg == arg2);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   /* reregister; should not change position */
   ASSERT_TRUE( ls_event_bind(evt1, mock_evt1_callback1, NULL, &err) );
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
   ASSERT_NULL(b->arg);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback2);
   ASSERT_TRUE(b->arg == arg2);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ls_event_unbind(evt1, mock_evt1_callback1);
   ls_event_unbind(evt1, mock_evt1_callback2);
@@ -1035,13 +1080,13 @@ CTEST2(event, trigger_event_unbind)
               log_event_message("mock_evt1_callback1", evt1,
                                 NULL, NULL) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ls_event_unbind(evt1, mock_evt1_callback1);
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NULL(b);
 
 }
@@ -1086,7 +1131,7 @@ CTEST2(event, trigger_event_multiple_unbind)
 
   ASSERT_NULL(item->next);
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NULL(b);
 
 }
@@ -1165,13 +1210,13 @@ CTEST2(event, trigger_nested_unbind)
   ls_event_unbind(evt1, nesting_callbackA);
   ls_event_unbind(evt1, nesting_callbackB);
 
-  b = evt2->bindings;
+  b = _first_binding(evt2);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == nesting_callbackC);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt2, b) );
 
   ls_event_unbind(evt2, nesting_callbackC);
-  b = evt2->bindings;
+  b = _first_binding(evt2);
   ASSERT_NULL(b);
 
 }
@@ -1210,20 +1255,20 @@ CTEST2(event, trigger_event_unbind_middle)
 
   ASSERT_NULL(item->next);
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback2);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ls_event_unbind(evt1, mock_evt1_callback1);
   ls_event_unbind(evt1, mock_evt1_callback2);
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NULL(b);
 
 }
@@ -1265,27 +1310,27 @@ CTEST2(event, trigger_event_unbind_rebind)
 
   ASSERT_NULL(item->next);
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_unbind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_rebind1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
 
   ls_event_unbind(evt1, mock_evt_unbind1_callback1);
   ls_event_unbind(evt1, mock_evt_rebind1_callback1);
   ls_event_unbind(evt1, mock_evt1_callback1);
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NULL(b);
 
 }
@@ -1304,27 +1349,27 @@ CTEST2(event, trigger_event_simple_defer_bind)
 
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_EQUAL(g_audit.count, 3);
   item = g_audit.items;
@@ -1358,25 +1403,25 @@ CTEST2(event, trigger_event_multiple_defer_bind)
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback2);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback2);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_EQUAL(g_audit.count, 6);
   item = g_audit.items;
@@ -1422,20 +1467,20 @@ CTEST2(event, trigger_event_defer_bind_rebind)
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_rebind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_EQUAL(g_audit.count, 5);
   item = g_audit.items;
@@ -1476,15 +1521,15 @@ CTEST2(event, trigger_event_defer_bind_unbind)
 
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_unbind1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_EQUAL(g_audit.count, 2);
   item = g_audit.items;
@@ -1515,25 +1560,25 @@ CTEST2(event, trigger_event_defer_bind_unbind_rebind)
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
   ASSERT_TRUE( ls_event_trigger(evt1, NULL, NULL, NULL, &err) );
 
-  b = evt1->bindings;
+  b = _first_binding(evt1);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_bind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_unbind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt_rebind1_callback1);
-  ASSERT_NOT_NULL(b->next);
+  ASSERT_NOT_NULL( _next_binding(evt1, b) );
 
-  b = b->next;
+  b = _next_binding(evt1, b);
   ASSERT_NOT_NULL(b);
   ASSERT_TRUE(b->cb == mock_evt1_callback1);
-  ASSERT_NULL(b->next);
+  ASSERT_NULL( _next_binding(evt1, b) );
 
   ASSERT_EQUAL(g_audit.count, 7);
   item = g_audit.items;
@@ -1606,6 +1651,37 @@ CTEST2(event, trigger_prepare_unprepare)
   ls_data_set_memory_funcs(NULL, NULL, NULL);
 }
 
+CTEST2(event, trigger_reuse)
+{
+  ls_event* evt1;
+  ls_event* evt2;
+  uint32_t  count = 0;
+  int       mallocs;
+  int       i;
+
+  UNUSED_PARAM(data);
+  evt1 = ls_event_dispatcher_get_event(g_dispatcher, "mockEvent1");
+  evt2 = ls_event_dispatcher_get_event(g_dispatcher, "mockEvent2");
+  ASSERT_TRUE( ls_event_bind(evt1, nested_count_callback, evt2, NULL) );
+  ASSERT_TRUE( ls_event_bind(evt2, async_callback, NULL, NULL) );
+
+  ls_data_set_memory_funcs(_counting_malloc, _counting_realloc, _counting_free);
+  /* the first nested trigger needs a moment; after that they're reused, */
+  /* and the outer one never needs one */
+  ASSERT_TRUE( ls_event_trigger(evt1, &count, NULL, NULL, NULL) );
+  mallocs = _mallocCnt;
+  for (i = 0; i < 10; i++)
+  {
+    ASSERT_TRUE( ls_event_trigger(evt1, &count, NULL, NULL, NULL) );
+  }
+  ASSERT_EQUAL(_mallocCnt, mallocs);
+  ASSERT_EQUAL(count, 22);
+  ls_data_set_memory_funcs(NULL, NULL, NULL);
+
+  ls_event_unbind(evt1, nested_count_callback);
+  ls_event_unbind(evt2, async_callback);
+}
+
 CTEST2(event, trigger_deferred_destroy)
 {
   ls_event*            evt        = NULL;
@@ -3,8 +3,11 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include "ls_log.h"
+#include "ls_timer.h"
 #include "test_utils.h"
 
 #undef LS_ERROR
@@ -352,6 +355,215 @@ CTEST2(ls_log, set_level)
   ASSERT_EQUAL(_log_offset, 0);
 }
 
+static int _limited_evals = 0;
+
+static int
+_limited_arg(int i)
+{
+  _limited_evals++;
+  return i;
+}
+
+static void
+_log_limited(uint64_t now,
+             int      count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    LS_LOG_LIMITED(now, LS_LOG_WARN, "limited %d", _limited_arg(i) );
+  }
+}
+
+CTEST2(ls_log, limited)
+{
+  uint64_t now = 1000 * LS_NS_PER_SEC;
+  UNUSED_PARAM(data);
+
+  ls_log_set_level(LS_LOG_WARN);
+  ls_log_set_limit(10, 3);
+
+  /* the burst, without even looking at the rest */
+  _log_offset = 0;
+  _log_limited(now, 10);
+  ASSERT_EQUAL(_limited_evals, 3);
+  ASSERT_NOT_NULL( strstr(_log_output, "limited 2") );
+  ASSERT_NULL( strstr(_log_output, "limited 3") );
+  ASSERT_NULL( strstr(_log_output, "suppressed") );
+
+  /* the next one says what was missed */
+  _log_offset = 0;
+  _log_limited(now + 100 * LS_NS_PER_MS, 2);
+  ASSERT_EQUAL(_limited_evals, 4);
+  ASSERT_NOT_NULL( strstr(_log_output, "7 similar messages suppressed") );
+  ASSERT_NOT_NULL( strstr(_log_output, "limited 0") );
+
+  /* and so does a flush, once */
+  _log_offset = 0;
+  ls_log_limit_flush();
+  ASSERT_NOT_NULL( strstr(_log_output, "1 similar messages suppressed") );
+  _log_offset = 0;
+  ls_log_limit_flush();
+  ASSERT_EQUAL(_log_offset, 0);
+
+  /* below the level doesn't count */
+  ls_log_set_level(LS_LOG_ERROR);
+  _log_limited(now + 100 * LS_NS_PER_MS, 5);
+  ls_log_limit_flush();
+  ASSERT_EQUAL(_log_offset,    0);
+  ASSERT_EQUAL(_limited_evals, 4);
+
+  /* no limit at all */
+  ls_log_set_level(LS_LOG_WARN);
+  ls_log_set_limit(0, 1);
+  _log_offset = 0;
+  _log_limited(now, 5);
+  ASSERT_EQUAL(_limited_evals, 9);
+
+  ls_log_set_limit(10, 10);
+}
+
+CTEST2(ls_log, async)
+{
+  char   buf[16];
+  char   expected[256];
+  char   longstr[400];
+  ls_err err;
+  int    ndc;
+  UNUSED_PARAM(data);
+
+  ls_log_set_level(LS_LOG_INFO);
+  ASSERT_TRUE( ls_log_async_start(0, &err) );
+  ASSERT_TRUE( ls_log_async_start(0, &err) );
+
+  /* every kind of argument, formatted on the other side */
+  _log_offset = 0;
+  strcpy(buf, "copied");
+  ls_log(LS_LOG_WARN, "int %d %5.2f %c %lx %zu %lld %s|%*.*s| %%",
+         -42, 3.14159, 'x', 0xabcUL, (size_t)7, -1LL, buf, 6, 2, "abcdef");
+  /* it's been copied, so this doesn't change what's logged */
+  strcpy(buf, "changed");
+  ls_log_async_stop();
+  _normalizeLogOutput();
+  snprintf(expected, sizeof(expected),
+           "[\x1b[33mWARN    \x1b[0m]: int %d %5.2f %c %lx %zu %lld %s|%*.*s| %%",
+           -42, 3.14159, 'x', 0xabcUL, (size_t)7, -1LL, "copied", 6, 2,
+           "abcdef");
+  ASSERT_STR(_log_output, expected);
+
+  /* the NDC and the reason come along too */
+  ASSERT_TRUE( ls_log_async_start(4, &err) );
+  _log_offset = 0;
+  ndc         = ls_log_push_ndc("ctx=%d", 9);
+  err.message = "broken";
+  ls_log_err(LS_LOG_ERROR, &err, "failed %s", "here");
+  ls_log(LS_LOG_DEBUG, "too verbose");
+  ls_log_pop_ndc(ndc);
+  ls_log_async_stop();
+  ASSERT_NOT_NULL( strstr(_log_output, "; ctx=9} reason(broken): failed here\n") );
+  ASSERT_NULL( strstr(_log_output, "too verbose") );
+
+  /* too much to carry gets cut short */
+  ASSERT_TRUE( ls_log_async_start(4, &err) );
+  _log_offset = 0;
+  memset(longstr, 'a', sizeof(longstr) - 1);
+  longstr[sizeof(longstr) - 1] = '\0';
+  ls_log(LS_LOG_INFO, "%s %d", longstr, 5);
+  ls_log(LS_LOG_INFO, "count%n", &ndc);
+  ls_log_async_stop();
+  ASSERT_NOT_NULL( strstr(_log_output, "aaa...\n") );
+  ASSERT_NULL( strstr(_log_output, " 5") );
+  ASSERT_NOT_NULL( strstr(_log_output, "count...\n") );
+  ASSERT_TRUE(strlen(_log_output) < sizeof(longstr) );
+
+  /* and then it's synchronous again */
+  _log_offset = 0;
+  ls_log(LS_LOG_INFO, "sync");
+  ASSERT_NOT_NULL( strstr(_log_output, "sync") );
+}
+
+static int _hold = 0;
+static int _held = 0;
+
+static int
+_holding_vfprintf(FILE*       stream,
+                  const char* format,
+                  va_list     ap)
+{
+  __atomic_store_n(&_held, 1, __ATOMIC_RELEASE);
+  while ( __atomic_load_n(&_hold, __ATOMIC_ACQUIRE) )
+  {
+    sched_yield();
+  }
+  return _myvfprintf(stream, format, ap);
+}
+
+CTEST2(ls_log, async_drops)
+{
+  ls_err err;
+  int    i;
+  UNUSED_PARAM(data);
+
+  ls_log_set_level(LS_LOG_INFO);
+  ls_log_set_function(_holding_vfprintf);
+  ASSERT_TRUE( ls_log_async_start(2, &err) );
+  _log_offset = 0;
+  __atomic_store_n(&_hold, 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&_held, 0, __ATOMIC_RELEASE);
+
+  /* the writer gets stuck on the first, so only one more fits */
+  ls_log(LS_LOG_INFO, "first");
+  while ( !__atomic_load_n(&_held, __ATOMIC_ACQUIRE) )
+  {
+    sched_yield();
+  }
+  for (i = 0; i < 5; i++)
+  {
+    ls_log(LS_LOG_INFO, "more %d", i);
+  }
+  __atomic_store_n(&_hold, 0, __ATOMIC_RELEASE);
+  ls_log_async_stop();
+  ls_log_set_function(_myvfprintf);
+
+  ASSERT_NOT_NULL( strstr(_log_output, "first") );
+  ASSERT_NOT_NULL( strstr(_log_output, "more 0") );
+  ASSERT_NULL( strstr(_log_output, "more 1") );
+  ASSERT_NOT_NULL( strstr(_log_output, "4 log messages dropped") );
+}
+
+static void*
+_log_thread(void* arg)
+{
+  ls_log(LS_LOG_INFO, "from thread %d", *(int*)arg);
+  return NULL;
+}
+
+CTEST2(ls_log, async_threads)
+{
+  pthread_t threads[3];
+  int       ids[3];
+  ls_err    err;
+  int       i;
+  UNUSED_PARAM(data);
+
+  ls_log_set_level(LS_LOG_INFO);
+  ASSERT_TRUE( ls_log_async_start(0, &err) );
+  _log_offset = 0;
+  /* each gets a ring of its own, which outlives it until it's written */
+  for (i = 0; i < 3; i++)
+  {
+    ids[i] = i;
+    ASSERT_EQUAL(pthread_create(&threads[i], NULL, _log_thread, &ids[i]), 0);
+    ASSERT_EQUAL(pthread_join(threads[i], NULL), 0);
+  }
+  ls_log(LS_LOG_INFO, "from main");
+  ls_log_async_stop();
+  ASSERT_NOT_NULL( strstr(_log_output, "from thread 0") );
+  ASSERT_NOT_NULL( strstr(_log_output, "from thread 2") );
+  ASSERT_NOT_NULL( strstr(_log_output, "from main") );
+}
+
 CTEST2(ls_log, format_timeval)
 {
   UNUSED_PARAM(data);
@@ -312,6 +312,52 @@ CTEST(ls_pool, strdup_shorterpool)
   ls_pool_destroy(pool);
 }
 
+CTEST(ls_pool, reset)
+{
+  ls_pool*    pool;
+  ls_err      err;
+  void*       ptr;
+  _pool_page* page;
+
+  ASSERT_TRUE( ls_pool_create(1024, &pool, &err) );
+  ASSERT_TRUE( ls_pool_malloc(pool, 512, &ptr, &err) );
+  ASSERT_TRUE( ls_pool_malloc(pool, 615, &ptr, &err) );
+  ASSERT_TRUE( ls_pool_malloc(pool, 2048, &ptr, &err) );
+  ASSERT_TRUE( ls_pool_add_cleaner(pool, &test_cleaner, ptr, &err) );
+  expected = ptr;
+  ASSERT_EQUAL( pool->size,         4096);
+  ASSERT_EQUAL( 2,                  page_count(pool) );
+  ASSERT_EQUAL( 4,                  cleaner_count(pool) );
+
+  /* the big allocation and its cleaner go; the pages stay, empty */
+  ls_pool_reset(pool);
+  ASSERT_TRUE(cleaner_hit);
+  cleaner_hit = false;
+  expected    = NULL;
+  ASSERT_EQUAL( pool->size,         2048);
+  ASSERT_EQUAL( 2,                  page_count(pool) );
+  ASSERT_EQUAL( 2,                  cleaner_count(pool) );
+  ASSERT_EQUAL( get_page(pool, 0)->used, 0);
+  ASSERT_EQUAL( get_page(pool, 1)->used, 0);
+
+  /* both pages get used again before a new one is added */
+  _test_init_counting_memory_funcs();
+  ASSERT_TRUE( ls_pool_malloc(pool, 512, &ptr, &err) );
+  ASSERT_TRUE( ls_pool_malloc(pool, 615, &ptr, &err) );
+  ASSERT_EQUAL(_test_get_malloc_count(), 0);
+  ASSERT_EQUAL( 2,                  page_count(pool) );
+  page = get_page(pool, 0);
+  ASSERT_EQUAL( page->used,         615);
+  page = get_page(pool, 1);
+  ASSERT_EQUAL( page->used,         512);
+  ASSERT_TRUE( ls_pool_malloc(pool, 1000, &ptr, &err) );
+  ASSERT_EQUAL(_test_get_malloc_count(), 3);
+  ASSERT_EQUAL( 3,                  page_count(pool) );
+  _test_uninit_counting_memory_funcs();
+
+  ls_pool_destroy(pool);
+}
+
 #endif
 CTEST(ls_pool, calloc)
 {
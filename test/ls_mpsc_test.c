@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <pthread.h>
+
+#include "test_utils.h"
+#include "../src/ls_mpsc.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 10000
+
+typedef struct
+{
+  ls_mpsc_node link;
+  unsigned int producer;
+  unsigned int seq;
+} item;
+
+typedef struct
+{
+  ls_mpsc*     q;
+  item*        items;
+  unsigned int producer;
+  unsigned int wakes;
+} producer_ctx;
+
+static void*
+_produce(void* arg)
+{
+  producer_ctx* ctx = arg;
+  unsigned int  i;
+
+  for (i = 0; i < PER_PRODUCER; i++)
+  {
+    ctx->items[i].producer = ctx->producer;
+    ctx->items[i].seq      = i;
+    if ( ls_mpsc_push(ctx->q, &ctx->items[i].link) )
+    {
+      ctx->wakes++;
+    }
+  }
+  return NULL;
+}
+
+CTEST(ls_mpsc, order)
+{
+  ls_mpsc       q;
+  item          items[3];
+  ls_mpsc_node* n;
+  unsigned int  i;
+
+  ls_mpsc_init(&q);
+  ASSERT_TRUE( ls_mpsc_empty(&q) );
+  ASSERT_NULL( ls_mpsc_take(&q) );
+
+  /* only the first push into an empty queue says so */
+  ASSERT_TRUE( ls_mpsc_push(&q, &items[0].link) );
+  ASSERT_FALSE( ls_mpsc_empty(&q) );
+  ASSERT_FALSE( ls_mpsc_push(&q, &items[1].link) );
+  ASSERT_FALSE( ls_mpsc_push(&q, &items[2].link) );
+
+  n = ls_mpsc_take(&q);
+  ASSERT_TRUE( ls_mpsc_empty(&q) );
+  for (i = 0; i < 3; i++)
+  {
+    ASSERT_TRUE(n == &items[i].link);
+    n = n->next;
+  }
+  ASSERT_NULL(n);
+
+  ASSERT_TRUE( ls_mpsc_push(&q, &items[0].link) );
+  ASSERT_TRUE(ls_mpsc_take(&q) == &items[0].link);
+}
+
+CTEST(ls_mpsc, threads)
+{
+  static item   items[PRODUCERS][PER_PRODUCER];
+  ls_mpsc       q;
+  pthread_t     threads[PRODUCERS];
+  producer_ctx  ctx[PRODUCERS];
+  unsigned int  next[PRODUCERS] = {0};
+  unsigned int  wakes = 0;
+  unsigned int  takes = 0;
+  unsigned int  done  = 0;
+  unsigned int  i;
+  ls_mpsc_node* n;
+  item*         it;
+
+  ls_mpsc_init(&q);
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    ctx[i].q        = &q;
+    ctx[i].items    = items[i];
+    ctx[i].producer = i;
+    ctx[i].wakes    = 0;
+    ASSERT_EQUAL(pthread_create(&threads[i], NULL, _produce, &ctx[i]), 0);
+  }
+
+  /* consume while they're still pushing; each producer's items have to */
+  /* come out in the order it pushed them, with none lost */
+  while (done < PRODUCERS * PER_PRODUCER)
+  {
+    n = ls_mpsc_take(&q);
+    if (n)
+    {
+      takes++;
+    }
+    for (; n; n = n->next)
+    {
+      it = (item*)n;
+      ASSERT_EQUAL(it->seq, next[it->producer]);
+      next[it->producer]++;
+      done++;
+    }
+  }
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    ASSERT_EQUAL(pthread_join(threads[i], NULL), 0);
+    wakes += ctx[i].wakes;
+  }
+  ASSERT_TRUE( ls_mpsc_empty(&q) );
+  /* exactly one push saw each batch start empty */
+  ASSERT_EQUAL(wakes, takes);
+}
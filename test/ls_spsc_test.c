@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "test_utils.h"
+#include "../src/ls_spsc.h"
+
+#define ITEMS 100000
+
+CTEST(ls_spsc, create_oom)
+{
+  ls_spsc* ring = NULL;
+  OOM_SIMPLE_TEST( ls_spsc_create(sizeof(int), 4, &ring, &err) );
+  ls_spsc_destroy(ring);
+  ls_spsc_destroy(NULL);
+}
+
+CTEST(ls_spsc, order)
+{
+  ls_spsc* ring;
+  int*     slot;
+  int      i, round;
+  ls_err   err;
+
+  ASSERT_TRUE( ls_spsc_create(sizeof(int), 4, &ring, &err) );
+  ASSERT_NULL( ls_spsc_peek(ring) );
+
+  /* around a few times, filling it up each time */
+  for (round = 0; round < 3; round++)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      slot = ls_spsc_reserve(ring);
+      ASSERT_NOT_NULL(slot);
+      /* the same slot until it's pushed */
+      ASSERT_TRUE(ls_spsc_reserve(ring) == slot);
+      *slot = round * 4 + i;
+      ls_spsc_push(ring);
+    }
+    ASSERT_NULL( ls_spsc_reserve(ring) );
+
+    for (i = 0; i < 4; i++)
+    {
+      slot = ls_spsc_peek(ring);
+      ASSERT_NOT_NULL(slot);
+      ASSERT_EQUAL(*slot, round * 4 + i);
+      ls_spsc_pop(ring);
+      /* and there's room again */
+      ASSERT_NOT_NULL( ls_spsc_reserve(ring) );
+    }
+    ASSERT_NULL( ls_spsc_peek(ring) );
+  }
+  ls_spsc_destroy(ring);
+}
+
+static void*
+_produce(void* arg)
+{
+  ls_spsc* ring = arg;
+  int*     slot;
+  int      i;
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    while ( ( slot = ls_spsc_reserve(ring) ) == NULL )
+    {
+      sched_yield();
+    }
+    *slot = i;
+    ls_spsc_push(ring);
+  }
+  return NULL;
+}
+
+CTEST(ls_spsc, threads)
+{
+  ls_spsc*  ring;
+  pthread_t producer;
+  int*      slot;
+  int       i;
+  ls_err    err;
+
+  ASSERT_TRUE( ls_spsc_create(sizeof(int), 64, &ring, &err) );
+  ASSERT_EQUAL(pthread_create(&producer, NULL, _produce, ring), 0);
+
+  /* everything arrives, in order, with what was written into it */
+  for (i = 0; i < ITEMS; i++)
+  {
+    while ( ( slot = ls_spsc_peek(ring) ) == NULL )
+    {
+      sched_yield();
+    }
+    ASSERT_EQUAL(*slot, i);
+    ls_spsc_pop(ring);
+  }
+  ASSERT_EQUAL(pthread_join(producer, NULL), 0);
+  ASSERT_NULL( ls_spsc_peek(ring) );
+  ls_spsc_destroy(ring);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <stdlib.h>
+
+#include "test_utils.h"
+#include "ls_timer.h"
+#include "../src/ls_timer_heap.h"
+
+static const struct timeval origin = {1000, 0};
+
+static void
+timer_cb(ls_timer* tim)
+{
+  UNUSED_PARAM(tim);
+}
+
+static ls_timer*
+_push_ms(ls_timer_heap* h,
+         unsigned long  ms)
+{
+  ls_timer* tim;
+  ls_err    err;
+
+  ASSERT_TRUE( ls_timer_create_ms(&origin, ms, timer_cb, NULL, &tim, &err) );
+  ASSERT_TRUE( ls_timer_heap_push(h, tim, &err) );
+  return tim;
+}
+
+/* Pop everything, checking that it comes out in order */
+static void
+_drain(ls_timer_heap* h,
+       size_t         expected)
+{
+  ls_timer*      tim;
+  struct timeval last  = {0, 0};
+  size_t         count = 0;
+
+  while ( ( tim = ls_timer_heap_pop(h) ) != NULL )
+  {
+    ASSERT_FALSE( timercmp(ls_timer_get_time(tim), &last, <) );
+    last = *ls_timer_get_time(tim);
+    ls_timer_destroy(tim);
+    count++;
+  }
+  ASSERT_EQUAL(count, expected);
+}
+
+CTEST(ls_timer_heap, create_oom)
+{
+  ls_timer_heap* h = NULL;
+  OOM_SIMPLE_TEST( ls_timer_heap_create(&h, &err) );
+  ls_timer_heap_destroy(h);
+  ls_timer_heap_destroy(NULL);
+}
+
+CTEST(ls_timer_heap, push_pop)
+{
+  static const unsigned long ms[] = { 50, 10, 40, 10, 30, 20, 0, 60 };
+  ls_timer_heap*             h;
+  ls_err                     err;
+  unsigned int               i;
+
+  ASSERT_TRUE( ls_timer_heap_create(&h, &err) );
+  ASSERT_NULL( ls_timer_heap_top(h) );
+  ASSERT_NULL( ls_timer_heap_pop(h) );
+  for (i = 0; i < sizeof(ms) / sizeof(ms[0]); i++)
+  {
+    _push_ms(h, ms[i]);
+  }
+  ASSERT_EQUAL(ls_timer_heap_count(h), sizeof(ms) / sizeof(ms[0]) );
+  ASSERT_TRUE( timercmp(ls_timer_get_time( ls_timer_heap_top(h) ),
+                        &origin, ==) );
+  _drain( h, sizeof(ms) / sizeof(ms[0]) );
+  ASSERT_EQUAL(ls_timer_heap_count(h), 0);
+  ls_timer_heap_destroy(h);
+}
+
+CTEST(ls_timer_heap, remove_update)
+{
+  ls_timer_heap* h;
+  ls_timer*      tims[200];
+  ls_err         err;
+  struct timeval tv;
+  unsigned int   i;
+
+  srand(42);
+  ASSERT_TRUE( ls_timer_heap_create(&h, &err) );
+  for (i = 0; i < 200; i++)
+  {
+    tims[i] = _push_ms(h, rand() % 1000);
+  }
+
+  /* take out every third one, from wherever it ended up */
+  for (i = 0; i < 200; i += 3)
+  {
+    ASSERT_TRUE( ls_timer_heap_remove(h, tims[i]) );
+    ASSERT_FALSE( ls_timer_heap_remove(h, tims[i]) );
+    ASSERT_FALSE( ls_timer_heap_update(h, tims[i]) );
+    ls_timer_destroy(tims[i]);
+  }
+
+  /* move some earlier and some later */
+  for (i = 1; i < 200; i += 3)
+  {
+    tv = *ls_timer_get_time(tims[i]);
+    tv.tv_sec += (i % 2) ? 5 : -5;
+    ASSERT_TRUE( ls_timer_create(&tv, timer_cb, NULL, &tims[0], &err) );
+    ASSERT_TRUE( ls_timer_heap_push(h, tims[0], &err) );
+    ASSERT_TRUE( ls_timer_heap_remove(h, tims[i]) );
+    ls_timer_destroy(tims[i]);
+  }
+  tims[0] = ls_timer_heap_top(h);
+  ASSERT_TRUE( ls_timer_heap_update(h, tims[0]) );
+  ASSERT_TRUE(ls_timer_heap_top(h) == tims[0]);
+
+  _drain(h, 200 - 67);
+  ls_timer_heap_destroy(h);
+}
+
+CTEST(ls_timer_heap, push_oom)
+{
+  ls_timer_heap* h;
+  ls_timer*      tim;
+  ls_err         err;
+  unsigned int   i;
+
+  ASSERT_TRUE( ls_timer_heap_create(&h, &err) );
+  ASSERT_TRUE( ls_timer_create(&origin, timer_cb, NULL, &tim, &err) );
+
+  OOM_RECORD_ALLOCS( ls_timer_heap_push(h, tim, &err) );
+  OOM_TEST_INIT()
+  ls_timer_heap_remove(h, tim);
+  ls_timer_heap_destroy(h);
+  ASSERT_TRUE( ls_timer_heap_create(&h, NULL) );
+  OOM_TEST( &err, ls_timer_heap_push(h, tim, &err) );
+  /* a failed push leaves the timer out of the heap */
+  ASSERT_EQUAL(ls_timer_heap_count(h), 0);
+  ASSERT_FALSE( ls_timer_heap_remove(h, tim) );
+
+  ASSERT_TRUE( ls_timer_heap_push(h, tim, &err) );
+  /* grows past its first allocation */
+  for (i = 0; i < 100; i++)
+  {
+    _push_ms(h, i);
+  }
+  ls_timer_heap_destroy(h);
+}
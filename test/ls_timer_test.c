@@ -42,6 +42,20 @@ CTEST(ls_timer, basic)
   ls_timer_destroy(soon);
 }
 
+CTEST(ls_timer, ref)
+{
+  ls_timer* tim;
+  ls_err    err;
+
+  ASSERT_TRUE( ls_timer_create_ns(1, timer_cb, &err, &tim, &err) );
+  ls_timer_ref(tim);
+  /* still there after the first destroy */
+  ls_timer_destroy(tim);
+  ASSERT_TRUE(ls_timer_get_context(tim) == &err);
+  ASSERT_EQUAL(ls_timer_get_ns(tim), 1);
+  ls_timer_destroy(tim);
+}
+
 CTEST(ls_timer, alloc_fail)
 {
   struct timeval small = {100, 100};
@@ -58,3 +72,32 @@ CTEST(ls_timer, alloc_fail)
                                              &past,
                                              &err), true);
 }
+
+CTEST(ls_timer, ns)
+{
+  struct timeval tv = {3, 250000};
+  uint64_t       now;
+  uint64_t       later;
+  ls_timer*      tim;
+  ls_err         err;
+
+  ASSERT_EQUAL(ls_time_from_timeval(&tv), 3250000000ULL);
+  ls_time_to_timeval(5 * LS_NS_PER_SEC + 1500, &tv);
+  ASSERT_EQUAL(tv.tv_sec,  5);
+  ASSERT_EQUAL(tv.tv_usec, 1);
+
+  ASSERT_TRUE( ls_time_now_ns(&now, &err) );
+  ASSERT_TRUE( ls_time_now_ns(&later, &err) );
+  ASSERT_TRUE(later >= now);
+
+  ASSERT_TRUE( ls_timer_create_ns(now + LS_NS_PER_MS, timer_cb, NULL,
+                                  &tim, &err) );
+  ASSERT_EQUAL(ls_timer_get_ns(tim), now + LS_NS_PER_MS);
+  ASSERT_TRUE( ls_timer_greater_ns(tim, now) );
+  ASSERT_FALSE( ls_timer_greater_ns(tim, now + LS_NS_PER_MS) );
+  ls_time_to_timeval(now + LS_NS_PER_MS, &tv);
+  ASSERT_TRUE( timercmp(ls_timer_get_time(tim), &tv, ==) );
+  ls_timer_cancel(tim);
+  ASSERT_EQUAL(ls_timer_get_ns(tim), 0);
+  ls_timer_destroy(tim);
+}
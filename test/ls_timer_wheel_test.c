@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include "test_utils.h"
+#include "ls_timer.h"
+#include "../src/ls_timer_wheel.h"
+
+static const uint64_t origin = 1000 * LS_NS_PER_SEC;
+
+static void
+timer_cb(ls_timer* tim)
+{
+  UNUSED_PARAM(tim);
+}
+
+static ls_timer*
+_add_ms(ls_timer_wheel* w,
+        uint64_t        ms)
+{
+  ls_timer* tim;
+  ls_err    err;
+
+  ASSERT_TRUE( ls_timer_create_ns(origin + ms * LS_NS_PER_MS, timer_cb, NULL,
+                                  &tim, &err) );
+  ls_timer_wheel_add(w, tim);
+  return tim;
+}
+
+static uint64_t
+_at_ms(uint64_t ms)
+{
+  return origin + ms * LS_NS_PER_MS;
+}
+
+CTEST(ls_timer_wheel, create_oom)
+{
+  ls_timer_wheel* w = NULL;
+  OOM_SIMPLE_TEST( ls_timer_wheel_create(origin, &w, &err) );
+  ls_timer_wheel_destroy(w);
+  ls_timer_wheel_destroy(NULL);
+}
+
+CTEST(ls_timer_wheel, expire)
+{
+  ls_timer_wheel* w;
+  ls_timer*       a;
+  ls_timer*       b;
+  ls_err          err;
+  uint64_t        now;
+  uint64_t        next;
+
+  ASSERT_TRUE( ls_timer_wheel_create(origin, &w, &err) );
+  ASSERT_FALSE( ls_timer_wheel_next(w, &next) );
+  ASSERT_NULL( ls_timer_wheel_pop_due(w) );
+
+  a = _add_ms(w, 5);
+  b = _add_ms(w, 300);
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 2);
+
+  ASSERT_TRUE( ls_timer_wheel_next(w, &next) );
+  now = _at_ms(5);
+  ASSERT_EQUAL(next, now);
+
+  now = _at_ms(4);
+  ls_timer_wheel_advance(w, now);
+  ASSERT_NULL( ls_timer_wheel_pop_due(w) );
+
+  now = _at_ms(5);
+  ls_timer_wheel_advance(w, now);
+  ASSERT_TRUE(ls_timer_wheel_pop_due(w) == a);
+  ASSERT_NULL( ls_timer_wheel_pop_due(w) );
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 1);
+  ls_timer_destroy(a);
+
+  /* no further out than when the 300ms timer is due */
+  ASSERT_TRUE( ls_timer_wheel_next(w, &next) );
+  now = _at_ms(300);
+  ASSERT_TRUE(next <= now);
+
+  /* something already due goes straight on the due list */
+  a = _add_ms(w, 1);
+  ASSERT_TRUE( ls_timer_wheel_next(w, &next) );
+  ASSERT_EQUAL( next, ls_timer_get_ns(a) );
+  ASSERT_TRUE(ls_timer_wheel_pop_due(w) == a);
+  ls_timer_destroy(a);
+
+  /* sleeping way past everything fires it */
+  now = _at_ms(100000);
+  ls_timer_wheel_advance(w, now);
+  ASSERT_TRUE(ls_timer_wheel_pop_due(w) == b);
+  ls_timer_destroy(b);
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 0);
+  ASSERT_FALSE( ls_timer_wheel_next(w, &next) );
+  ls_timer_wheel_destroy(w);
+}
+
+CTEST(ls_timer_wheel, order)
+{
+  /* spread across all of the levels, and past the end */
+  static const uint64_t ms[] = { 3, 255, 256, 1000, 65535, 65536, 400000,
+                                 16777216, 100000000, 5000000000ULL };
+  ls_timer_wheel*       w;
+  ls_timer*             tim;
+  ls_err                err;
+  uint64_t              now;
+  uint64_t              next;
+  unsigned int          i;
+  unsigned int          fired  = 0;
+  unsigned int          wakeup = 0;
+
+  ASSERT_TRUE( ls_timer_wheel_create(origin, &w, &err) );
+  /* add them backwards, to make sure order comes from the wheel */
+  for (i = sizeof(ms) / sizeof(ms[0]); i > 0; i--)
+  {
+    _add_ms(w, ms[i - 1]);
+  }
+
+  /* sleep until told to, like the manager does */
+  while ( ls_timer_wheel_next(w, &next) )
+  {
+    ASSERT_TRUE(++wakeup < 1000);
+    now = next;
+    ls_timer_wheel_advance(w, now);
+    while ( ( tim = ls_timer_wheel_pop_due(w) ) != NULL )
+    {
+      /* on time to the tick, never early */
+      next = _at_ms(ms[fired++]);
+      ASSERT_EQUAL( ls_timer_get_ns(tim), next );
+      ASSERT_EQUAL(now, next);
+      ls_timer_destroy(tim);
+    }
+  }
+  ASSERT_EQUAL(fired, sizeof(ms) / sizeof(ms[0]) );
+  ls_timer_wheel_destroy(w);
+}
+
+CTEST(ls_timer_wheel, remove)
+{
+  ls_timer_wheel* w;
+  ls_timer*       tims[4];
+  ls_err          err;
+  uint64_t        now;
+  unsigned int    i;
+
+  ASSERT_TRUE( ls_timer_wheel_create(origin, &w, &err) );
+  for (i = 0; i < 4; i++)
+  {
+    tims[i] = _add_ms(w, 10);
+  }
+
+  /* out of a slot */
+  ASSERT_TRUE( ls_timer_wheel_remove(w, tims[1]) );
+  ASSERT_FALSE( ls_timer_wheel_remove(w, tims[1]) );
+  ls_timer_destroy(tims[1]);
+
+  /* off the due list, from wherever they are in it */
+  now = _at_ms(10);
+  ls_timer_wheel_advance(w, now);
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 3);
+  ASSERT_TRUE( ls_timer_wheel_remove(w, tims[2]) );
+  ASSERT_TRUE( ls_timer_wheel_remove(w, tims[0]) );
+  ASSERT_TRUE(ls_timer_wheel_pop_due(w) == tims[3]);
+  ASSERT_FALSE( ls_timer_wheel_remove(w, tims[3]) );
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 0);
+  ASSERT_NULL( ls_timer_wheel_pop_due(w) );
+
+  /* the due list still works after losing its tail */
+  tims[1] = _add_ms(w, 1);
+  ASSERT_TRUE(ls_timer_wheel_pop_due(w) == tims[1]);
+
+  for (i = 0; i < 4; i++)
+  {
+    ls_timer_destroy(tims[i]);
+  }
+  ls_timer_wheel_destroy(w);
+}
+
+CTEST(ls_timer_wheel, destroy_pending)
+{
+  ls_timer_wheel* w;
+  ls_err          err;
+  uint64_t        now;
+
+  ASSERT_TRUE( ls_timer_wheel_create(origin, &w, &err) );
+  _add_ms(w, 1);
+  _add_ms(w, 1000);
+  _add_ms(w, 100000000);
+  now = _at_ms(2);
+  ls_timer_wheel_advance(w, now);
+  ASSERT_EQUAL(ls_timer_wheel_count(w), 3);
+  ls_timer_wheel_destroy(w);
+}
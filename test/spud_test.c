@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "test_utils.h"
 #include "spud.h"
@@ -74,6 +76,68 @@ CTEST(spud, isIdEqual)
   ASSERT_FALSE( spud_is_id_equal(&msgB.tube_id, &msgC.tube_id) );
 }
 
+static int
+_id_cmp(const void* a,
+        const void* b)
+{
+  return memcmp( a, b, sizeof(spud_tube_id) );
+}
+
+CTEST(spud, createIds)
+{
+  /* more than one buffer's worth */
+  spud_tube_id ids[1500];
+  ls_err       err;
+  size_t       i;
+
+  ASSERT_TRUE( spud_create_ids(NULL, 0, &err) );
+  ASSERT_FALSE( spud_create_ids(NULL, 1, &err) );
+  ASSERT_EQUAL(err.code, LS_ERR_INVALID_ARG);
+
+  ASSERT_TRUE( spud_create_id(&ids[0], &err) );
+  ASSERT_TRUE( spud_create_ids(&ids[1], 999, &err) );
+  for (i = 1000; i < 1500; i++)
+  {
+    ASSERT_TRUE( spud_create_id(&ids[i], &err) );
+  }
+  qsort(ids, 1500, sizeof(ids[0]), _id_cmp);
+  for (i = 1; i < 1500; i++)
+  {
+    ASSERT_FALSE( spud_is_id_equal(&ids[i - 1], &ids[i]) );
+  }
+}
+
+CTEST(spud, createIdFork)
+{
+  spud_tube_id parent, child;
+  ls_err       err;
+  int          fds[2];
+  pid_t        pid;
+  int          status;
+
+  /* make sure there's something buffered to be inherited */
+  ASSERT_TRUE( spud_create_id(&parent, &err) );
+  ASSERT_EQUAL(pipe(fds), 0);
+  pid = fork();
+  ASSERT_TRUE(pid >= 0);
+  if (pid == 0)
+  {
+    if ( !spud_create_id(&child, NULL) ||
+         ( write( fds[1], &child, sizeof(child) ) != sizeof(child) ) )
+    {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  ASSERT_TRUE( spud_create_id(&parent, &err) );
+  ASSERT_EQUAL(read( fds[0], &child, sizeof(child) ), sizeof(child) );
+  ASSERT_EQUAL(waitpid(pid, &status, 0), pid);
+  ASSERT_EQUAL(status, 0);
+  close(fds[0]);
+  close(fds[1]);
+  ASSERT_FALSE( spud_is_id_equal(&parent, &child) );
+}
+
 CTEST(spud, parse)
 {
   spud_message msg;
@@ -93,3 +157,62 @@ CTEST(spud, parse)
   ASSERT_TRUE( spud_parse(buf, sizeof(buf), &msg, &err) );
   spud_unparse(&msg);
 }
+
+static void*
+_pool_calloc(size_t count,
+             size_t size,
+             void*  context)
+{
+  void* ptr;
+  if ( !ls_pool_calloc(context, count, size, &ptr, NULL) )
+  {
+    return NULL;
+  }
+  return ptr;
+}
+
+static void
+_pool_free(void* ptr,
+           void* context)
+{
+  UNUSED_PARAM(ptr);
+  UNUSED_PARAM(context);
+}
+
+CTEST(spud, parse_ctx)
+{
+  spud_message    msg;
+  ls_err          err;
+  ls_pool*        pool;
+  cn_cbor_context ctx;
+  uint32_t        mallocs;
+  int             i;
+  uint8_t         buf[] = { 0xd8, 0x00, 0x00, 0xd8,
+                            0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                            0x00,
+                            0xa1, 0x00,
+                            0x41, 0x61 };
+
+  ASSERT_TRUE( ls_pool_create(1024, &pool, &err) );
+  ctx.calloc_func = _pool_calloc;
+  ctx.free_func   = _pool_free;
+  ctx.context     = pool;
+
+  _test_init_counting_memory_funcs();
+  for (i = 0; i < 10; i++)
+  {
+    ASSERT_TRUE( spud_parse_ctx(buf, sizeof(buf), &msg, &ctx, &err) );
+    ASSERT_NOT_NULL(msg.cbor);
+    ASSERT_TRUE(msg.ctx == &ctx);
+    ASSERT_EQUAL(msg.cbor->type, CN_CBOR_MAP);
+    spud_unparse(&msg);
+    ls_pool_reset(pool);
+  }
+  mallocs = _test_get_malloc_count();
+  _test_uninit_counting_memory_funcs();
+  /* nothing beyond the page that was already there */
+  ASSERT_EQUAL(mallocs, 0);
+
+  ASSERT_FALSE( spud_parse_ctx(buf, 15, &msg, &ctx, &err) );
+  ls_pool_destroy(pool);
+}
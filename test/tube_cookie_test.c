@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "test_utils.h"
+#include "../src/tube_cookie.h"
+
+static const uint64_t origin = 1000 * LS_NS_PER_SEC;
+
+static void
+_peer4(struct sockaddr_in* sa,
+       uint32_t            addr,
+       uint16_t            port)
+{
+  memset( sa, 0, sizeof(*sa) );
+  sa->sin_family      = AF_INET;
+  sa->sin_port        = htons(port);
+  sa->sin_addr.s_addr = htonl(addr);
+}
+
+CTEST(tube_cookie, check)
+{
+  tube_cookie_key     key, other;
+  spud_tube_id        id, id2;
+  struct sockaddr_in  peer, peer2;
+  struct sockaddr_in6 peer6;
+  uint64_t            c;
+  ls_err              err;
+
+  ASSERT_TRUE( tube_cookie_key_init(&key, &err) );
+  ASSERT_TRUE( tube_cookie_key_init(&other, &err) );
+  ASSERT_TRUE( spud_create_id(&id, &err) );
+  ASSERT_TRUE( spud_create_id(&id2, &err) );
+  _peer4(&peer, 0x7f000001, 1402);
+
+  c = tube_cookie_make(&key, &id, (struct sockaddr*)&peer, origin);
+  ASSERT_TRUE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer,
+                                 origin, c) );
+
+  /* good until the end of the next slot */
+  ASSERT_TRUE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer,
+                                 origin + TUBE_COOKIE_SLOT_NS, c) );
+  ASSERT_FALSE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer,
+                                  origin + 2 * TUBE_COOKIE_SLOT_NS, c) );
+
+  /* only for that tube, from that address and port, with that key */
+  ASSERT_FALSE( tube_cookie_check(&key, &id2, (struct sockaddr*)&peer,
+                                  origin, c) );
+  _peer4(&peer2, 0x7f000002, 1402);
+  ASSERT_FALSE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer2,
+                                  origin, c) );
+  _peer4(&peer2, 0x7f000001, 1403);
+  ASSERT_FALSE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer2,
+                                  origin, c) );
+  ASSERT_FALSE( tube_cookie_check(&other, &id, (struct sockaddr*)&peer,
+                                  origin, c) );
+  ASSERT_FALSE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer,
+                                  origin, c ^ 1) );
+
+  memset( &peer6, 0, sizeof(peer6) );
+  peer6.sin6_family = AF_INET6;
+  peer6.sin6_port   = htons(1402);
+  peer6.sin6_addr   = in6addr_loopback;
+  c                 = tube_cookie_make(&key, &id, (struct sockaddr*)&peer6,
+                                       origin);
+  ASSERT_TRUE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer6,
+                                 origin, c) );
+  peer6.sin6_addr.s6_addr[0] = 0xfe;
+  ASSERT_FALSE( tube_cookie_check(&key, &id, (struct sockaddr*)&peer6,
+                                  origin, c) );
+}
+
+CTEST(tube_cookie, encode)
+{
+  uint8_t      buf[sizeof(spud_header) + TUBE_COOKIE_CBOR_SIZE];
+  spud_header  hdr;
+  spud_message msg;
+  uint64_t     c;
+  ls_err       err;
+
+  ASSERT_TRUE( spud_init(&hdr, NULL, &err) );
+  memcpy( buf, &hdr, sizeof(hdr) );
+  tube_cookie_encode( UINT64_C(0x0102030405060708), buf + sizeof(hdr) );
+  ASSERT_TRUE( spud_parse(buf, sizeof(buf), &msg, &err) );
+  ASSERT_TRUE( tube_cookie_decode(msg.cbor, &c) );
+  ASSERT_TRUE( c == UINT64_C(0x0102030405060708) );
+  spud_unparse(&msg);
+
+  /* not there */
+  ASSERT_FALSE( tube_cookie_decode(NULL, &c) );
+  buf[sizeof(hdr) + 2] = 'b';
+  ASSERT_TRUE( spud_parse(buf, sizeof(buf), &msg, &err) );
+  ASSERT_FALSE( tube_cookie_decode(msg.cbor, &c) );
+  spud_unparse(&msg);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "test_utils.h"
+#include "ls_timer.h"
+#include "../src/tube_limit.h"
+
+static const uint64_t origin = 1000 * LS_NS_PER_SEC;
+
+static void
+_src4(struct sockaddr_in* sa,
+      uint32_t            addr)
+{
+  memset( sa, 0, sizeof(*sa) );
+  sa->sin_family      = AF_INET;
+  sa->sin_port        = htons(1402);
+  sa->sin_addr.s_addr = htonl(addr);
+}
+
+CTEST(tube_limit, create_oom)
+{
+  tube_limit* lim = NULL;
+  OOM_SIMPLE_TEST( tube_limit_create(10, 10, &lim, &err) );
+  tube_limit_destroy(lim);
+  tube_limit_destroy(NULL);
+}
+
+CTEST(tube_limit, admit)
+{
+  tube_limit*        lim;
+  struct sockaddr_in src, other;
+  ls_err             err;
+  int                i;
+
+  ASSERT_TRUE( tube_limit_create(10, 5, &lim, &err) );
+  _src4(&src, 0x0a000001);
+
+  /* the burst, then nothing */
+  for (i = 0; i < 5; i++)
+  {
+    ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&src, origin) );
+  }
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&src, origin) );
+
+  /* the whole /24 shares */
+  _src4(&other, 0x0a0000fe);
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&other, origin) );
+  /* and the next one over doesn't */
+  _src4(&other, 0x0a000101);
+  ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&other, origin) );
+
+  /* one more token every 100ms */
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&src,
+                                 origin + 99 * LS_NS_PER_MS) );
+  ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&src,
+                                origin + 100 * LS_NS_PER_MS) );
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&src,
+                                 origin + 100 * LS_NS_PER_MS) );
+
+  /* and no more than the burst saved up, however long it's been */
+  for (i = 0; i < 5; i++)
+  {
+    ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&src,
+                                  origin + 60 * LS_NS_PER_SEC) );
+  }
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&src,
+                                 origin + 60 * LS_NS_PER_SEC) );
+  tube_limit_destroy(lim);
+}
+
+CTEST(tube_limit, ipv6)
+{
+  tube_limit*         lim;
+  struct sockaddr_in6 src, other;
+  struct sockaddr_in  src4;
+  ls_err              err;
+
+  ASSERT_TRUE( tube_limit_create(1, 1, &lim, &err) );
+  memset( &src, 0, sizeof(src) );
+  src.sin6_family = AF_INET6;
+  ASSERT_EQUAL(inet_pton(AF_INET6, "2001:db8::1", &src.sin6_addr), 1);
+  ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&src, origin) );
+
+  /* same /64 */
+  other = src;
+  ASSERT_EQUAL(inet_pton(AF_INET6, "2001:db8::ffff:2", &other.sin6_addr), 1);
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&other, origin) );
+  /* different /64 */
+  ASSERT_EQUAL(inet_pton(AF_INET6, "2001:db8:0:1::1", &other.sin6_addr), 1);
+  ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&other, origin) );
+
+  /* a mapped IPv4 address counts as itself */
+  _src4(&src4, 0xc0000201);
+  ASSERT_TRUE( tube_limit_admit(lim, (struct sockaddr*)&src4, origin) );
+  ASSERT_EQUAL(inet_pton(AF_INET6, "::ffff:192.0.2.99", &other.sin6_addr), 1);
+  ASSERT_FALSE( tube_limit_admit(lim, (struct sockaddr*)&other, origin) );
+  tube_limit_destroy(lim);
+}
@@ -0,0 +1,187 @@
+#ifdef __linux__
+/* needed for struct in6_pktinfo, via tube_manager_int.h */
+#define _GNU_SOURCE 1
+#endif
+
+#include <time.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "test_utils.h"
+#include "tube_manager_group.h"
+#include "ls_sockaddr.h"
+#include "../src/tube_manager_int.h"
+
+#define SHARDS 2
+
+static const uint8_t open_pkt[] = { 0xd8, 0x00, 0x00, 0xd8,
+                                    0x00, 0x00, 0x00, 0x00,
+                                    0x00, 0x00, 0x00, 0x00,
+                                    SPUD_OPEN };
+
+CTEST_DATA(tube_manager_group)
+{
+  tube_manager_group* grp;
+  ls_err              err;
+};
+
+CTEST_SETUP(tube_manager_group)
+{
+  ASSERT_TRUE( tube_manager_group_create(SHARDS, 0, TUBE_IO_DEFAULT,
+                                         &data->grp, &data->err) );
+}
+
+CTEST_TEARDOWN(tube_manager_group)
+{
+  tube_manager_group_destroy(data->grp);
+}
+
+CTEST(tube_manager_group, create_invalid)
+{
+  tube_manager_group* grp;
+  ls_err              err;
+  ASSERT_FALSE( tube_manager_group_create(0, 0, TUBE_IO_DEFAULT, &grp,
+                                          &err) );
+  ASSERT_EQUAL(err.code, LS_ERR_INVALID_ARG);
+}
+
+CTEST(tube_manager_group, create_oom)
+{
+  tube_manager_group* grp = NULL;
+  OOM_SIMPLE_TEST( tube_manager_group_create(SHARDS, 3, TUBE_IO_SELECT, &grp,
+                                             &err) );
+  tube_manager_group_destroy(grp);
+}
+
+static void
+_noop_cb(ls_event_data* evt,
+         void*          arg)
+{
+  UNUSED_PARAM(evt);
+  UNUSED_PARAM(arg);
+}
+
+CTEST2(tube_manager_group, accessors)
+{
+  unsigned int i;
+
+  ASSERT_EQUAL(tube_manager_group_count(data->grp), SHARDS);
+  for (i = 0; i < SHARDS; i++)
+  {
+    ASSERT_NOT_NULL( tube_manager_group_get(data->grp, i) );
+  }
+  ASSERT_TRUE( tube_manager_group_get(data->grp, 0) !=
+               tube_manager_group_get(data->grp, 1) );
+  ASSERT_EQUAL(tube_manager_group_size(data->grp), 0);
+  ASSERT_TRUE( tube_manager_group_bind_event(data->grp, EV_DATA_NAME,
+                                             _noop_cb, &data->err) );
+  ASSERT_FALSE( tube_manager_group_bind_event(data->grp, "bogus",
+                                              _noop_cb, &data->err) );
+}
+
+static uint32_t
+_id_shard_value(spud_tube_id* id)
+{
+  uint32_t v;
+  memcpy(&v, &id->octet[4], sizeof(v));
+  return ntohl(v);
+}
+
+CTEST2(tube_manager_group, open_tube_steering)
+{
+  struct sockaddr_in dest;
+  tube*              t;
+  spud_tube_id*      id;
+  unsigned int       i;
+
+  ASSERT_TRUE( ls_sockaddr_get_remote_ip_addr("127.0.0.1",
+                                              "1402",
+                                              (struct sockaddr*)&dest,
+                                              sizeof(dest),
+                                              &data->err) );
+  ASSERT_TRUE( tube_manager_group_socket(data->grp, 0, &data->err) );
+
+  /* round-robin, and each ID steers back to the shard that opened it */
+  for (i = 0; i < 2 * SHARDS; i++)
+  {
+    ASSERT_TRUE( tube_manager_group_open_tube(data->grp,
+                                              (struct sockaddr*)&dest,
+                                              &t, &data->err) );
+    tube_get_id(t, &id);
+    ASSERT_EQUAL(_id_shard_value(id) % SHARDS, i % SHARDS);
+    ASSERT_TRUE(tube_get_manager(t) == tube_manager_group_get(data->grp,
+                                                               i % SHARDS));
+  }
+  ASSERT_EQUAL(tube_manager_group_size(data->grp), 2 * SHARDS);
+}
+
+static int
+_check_shard(void*               user,
+             const spud_tube_id* tube_id,
+             tube*               t)
+{
+  tube_manager* mgr = user;
+  UNUSED_PARAM(t);
+  ASSERT_EQUAL(_id_shard_value( (spud_tube_id*)tube_id ) % mgr->shards,
+               mgr->shard);
+  return 1;
+}
+
+CTEST2(tube_manager_group, steer_incoming)
+{
+  struct sockaddr_storage addr;
+  socklen_t               len = sizeof(addr);
+  struct timespec         ms  = {0, 1000000};
+  uint8_t                 pkt[sizeof(open_pkt)];
+  unsigned int            i;
+  int                     sock;
+  tube_manager*           mgr;
+  tube*                   t;
+
+  ASSERT_TRUE( tube_manager_group_socket(data->grp, 0, &data->err) );
+  for (i = 0; i < SHARDS; i++)
+  {
+    tube_manager_set_policy_responder(tube_manager_group_get(data->grp, i),
+                                      true);
+  }
+
+  mgr = tube_manager_group_get(data->grp, 0);
+  ASSERT_EQUAL(getsockname(mgr->sock4, (struct sockaddr*)&addr, &len), 0);
+  ( (struct sockaddr_in*)&addr )->sin_addr.s_addr = htonl(0x7f000001);
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_TRUE(sock >= 0);
+
+  ASSERT_TRUE( tube_manager_group_start(data->grp, &data->err) );
+  /* the shards' tubes are theirs now */
+  ASSERT_FALSE( tube_manager_group_open_tube(data->grp,
+                                             (struct sockaddr*)&addr,
+                                             &t, &data->err) );
+  ASSERT_EQUAL(data->err.code, LS_ERR_INVALID_STATE);
+
+  /* eight tubes, with the low bits of the steering word covering each */
+  /* shard a few times */
+  memcpy( pkt, open_pkt, sizeof(pkt) );
+  for (i = 0; i < 8; i++)
+  {
+    pkt[4]  = 0x42;
+    pkt[11] = (uint8_t)i;
+    ASSERT_EQUAL(sendto( sock, pkt, sizeof(pkt), 0,
+                         (struct sockaddr*)&addr, len ),
+                 (ssize_t)sizeof(pkt) );
+  }
+  close(sock);
+
+  for (i = 0; (i < 2000) && (tube_manager_group_size(data->grp) < 8); i++)
+  {
+    nanosleep(&ms, NULL);
+  }
+  ASSERT_TRUE( tube_manager_group_stop(data->grp, &data->err) );
+  ASSERT_EQUAL(tube_manager_group_size(data->grp), 8);
+
+  for (i = 0; i < SHARDS; i++)
+  {
+    mgr = tube_manager_group_get(data->grp, i);
+    ASSERT_EQUAL(tube_manager_size(mgr), 8 / SHARDS);
+    tube_manager_foreach(mgr, _check_shard, mgr);
+  }
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2015 SPUDlib authors.  See LICENSE file.
+ */
+
+#include <string.h>
+
+#include "../src/tube_table.h"
+#include "test_utils.h"
+#include "tube.h"
+
+#define NUM_TUBES 1000
+
+CTEST_DATA(tube_table)
+{
+  tube_table* tbl;
+  tube*       tubes[NUM_TUBES];
+  ls_err      err;
+};
+
+/* IDs that differ only in their low bits, so they'd collide under a poor */
+/* hash */
+static void
+_make_id(unsigned int  i,
+         spud_tube_id* id)
+{
+  memset( id, 0, sizeof(*id) );
+  id->octet[6] = (uint8_t)(i >> 8);
+  id->octet[7] = (uint8_t)i;
+}
+
+CTEST_SETUP(tube_table)
+{
+  spud_tube_id id;
+  unsigned int i;
+
+  ASSERT_TRUE( tube_table_create(0, &data->tbl, &data->err) );
+  for (i = 0; i < NUM_TUBES; i++)
+  {
+    ASSERT_TRUE( tube_create(&data->tubes[i], &data->err) );
+    _make_id(i, &id);
+    tube_set_info(data->tubes[i], -1, NULL, &id);
+  }
+}
+
+CTEST_TEARDOWN(tube_table)
+{
+  unsigned int i;
+
+  tube_table_destroy(data->tbl);
+  for (i = 0; i < NUM_TUBES; i++)
+  {
+    tube_destroy(data->tubes[i]);
+  }
+}
+
+static void
+_put_all(tube_table* tbl,
+         tube**      tubes)
+{
+  spud_tube_id* id;
+  tube*         old;
+  unsigned int  i;
+
+  for (i = 0; i < NUM_TUBES; i++)
+  {
+    tube_get_id(tubes[i], &id);
+    ASSERT_TRUE( tube_table_put(tbl, id, tubes[i], &old, NULL) );
+    ASSERT_NULL(old);
+  }
+}
+
+CTEST(tube_table, create_oom)
+{
+  tube_table* tbl = NULL;
+  OOM_SIMPLE_TEST( tube_table_create(100, &tbl, &err) );
+  tube_table_destroy(tbl);
+  tube_table_destroy(NULL);
+}
+
+CTEST2(tube_table, put_get)
+{
+  spud_tube_id  id;
+  spud_tube_id* tid;
+  tube*         old;
+  unsigned int  i;
+
+  _make_id(0, &id);
+  ASSERT_EQUAL(tube_table_count(data->tbl), 0);
+  ASSERT_NULL( tube_table_get(data->tbl, &id) );
+
+  _put_all(data->tbl, data->tubes);
+  ASSERT_EQUAL(tube_table_count(data->tbl), NUM_TUBES);
+  for (i = 0; i < NUM_TUBES; i++)
+  {
+    tube_get_id(data->tubes[i], &tid);
+    ASSERT_TRUE(tube_table_get(data->tbl, tid) == data->tubes[i]);
+  }
+  _make_id(NUM_TUBES, &id);
+  ASSERT_NULL( tube_table_get(data->tbl, &id) );
+
+  /* replace */
+  tube_get_id(data->tubes[1], &tid);
+  ASSERT_TRUE( tube_table_put(data->tbl, tid, data->tubes[0], &old, NULL) );
+  ASSERT_TRUE(old == data->tubes[1]);
+  ASSERT_TRUE(tube_table_get(data->tbl, tid) == data->tubes[0]);
+  ASSERT_EQUAL(tube_table_count(data->tbl), NUM_TUBES);
+}
+
+CTEST2(tube_table, remove)
+{
+  spud_tube_id* tid;
+  unsigned int  i;
+
+  _put_all(data->tbl, data->tubes);
+  for (i = 0; i < NUM_TUBES; i += 2)
+  {
+    tube_get_id(data->tubes[i], &tid);
+    ASSERT_TRUE(tube_table_remove(data->tbl, tid) == data->tubes[i]);
+    ASSERT_NULL( tube_table_remove(data->tbl, tid) );
+  }
+  ASSERT_EQUAL(tube_table_count(data->tbl), NUM_TUBES / 2);
+
+  /* everything left over is still reachable after the shifting */
+  for (i = 0; i < NUM_TUBES; i++)
+  {
+    tube_get_id(data->tubes[i], &tid);
+    if (i % 2)
+    {
+      ASSERT_TRUE(tube_table_get(data->tbl, tid) == data->tubes[i]);
+    }
+    else
+    {
+      ASSERT_NULL( tube_table_get(data->tbl, tid) );
+    }
+  }
+}
+
+static int
+_count_walk(void*               user_data,
+            const spud_tube_id* id,
+            tube*               t)
+{
+  spud_tube_id* tid;
+  int*          count = user_data;
+
+  tube_get_id(t, &tid);
+  ASSERT_TRUE( spud_is_id_equal(tid, id) );
+  (*count)++;
+  return 1;
+}
+
+static int
+_stop_walk(void*               user_data,
+           const spud_tube_id* id,
+           tube*               t)
+{
+  UNUSED_PARAM(user_data);
+  UNUSED_PARAM(id);
+  UNUSED_PARAM(t);
+  return 0;
+}
+
+static int
+_remove_walk(void*               user_data,
+             const spud_tube_id* id,
+             tube*               t)
+{
+  tube_table* tbl = user_data;
+
+  ASSERT_TRUE(tube_table_remove(tbl, id) == t);
+  return 1;
+}
+
+CTEST2(tube_table, walk)
+{
+  int count = 0;
+
+  ASSERT_EQUAL(tube_table_walk(data->tbl, _count_walk, &count), 0);
+  _put_all(data->tbl, data->tubes);
+  ASSERT_EQUAL(tube_table_walk(data->tbl, _count_walk, &count), NUM_TUBES);
+  ASSERT_EQUAL(count,                                           NUM_TUBES);
+  ASSERT_EQUAL(tube_table_walk(data->tbl, _stop_walk, NULL),    1);
+
+  /* removing the current tube while walking visits every tube once */
+  ASSERT_EQUAL(tube_table_walk(data->tbl, _remove_walk, data->tbl),
+               NUM_TUBES);
+  ASSERT_EQUAL(tube_table_count(data->tbl), 0);
+}
+
+/* fill to just under the first resize */
+static void
+_fill_small(tube_table* tbl,
+            tube**      tubes)
+{
+  spud_tube_id* tid;
+  unsigned int  i;
+
+  for (i = 0; i < 14; i++)
+  {
+    tube_get_id(tubes[i], &tid);
+    ASSERT_TRUE( tube_table_put(tbl, tid, tubes[i], NULL, NULL) );
+  }
+}
+
+CTEST2(tube_table, put_oom)
+{
+  spud_tube_id* tid;
+  ls_err        err;
+  unsigned int  i;
+
+  _fill_small(data->tbl, data->tubes);
+  tube_get_id(data->tubes[14], &tid);
+  OOM_RECORD_ALLOCS( tube_table_put(data->tbl, tid, data->tubes[14], NULL,
+                                    &err) );
+  OOM_TEST_INIT()
+  tube_table_destroy(data->tbl);
+  ASSERT_TRUE( tube_table_create(0, &data->tbl, NULL) );
+  _fill_small(data->tbl, data->tubes);
+  OOM_TEST( &err, tube_table_put(data->tbl, tid, data->tubes[14], NULL,
+                                 &err) );
+
+  /* a failed grow leaves the table as it was */
+  ASSERT_EQUAL(tube_table_count(data->tbl), 14);
+  for (i = 0; i < 14; i++)
+  {
+    tube_get_id(data->tubes[i], &tid);
+    ASSERT_TRUE(tube_table_get(data->tbl, tid) == data->tubes[i]);
+  }
+}
+
+/* Undo the mixing in _home() for a zero seed, so a test can pick which slot */
+/* an ID lands in. */
+static uint64_t
+_inverse(uint64_t c)
+{
+  uint64_t x = c;
+  int      i;
+
+  /* Newton's method; each round doubles the bits that are right */
+  for (i = 0; i < 5; i++)
+  {
+    x *= 2 - c * x;
+  }
+  return x;
+}
+
+static void
+_home_id(uint64_t      h,
+         spud_tube_id* id)
+{
+  h ^= h >> 33;
+  h *= _inverse(0xc4ceb9fe1a85ec53ULL);
+  h ^= h >> 33;
+  h *= _inverse(0xff51afd7ed558ccdULL);
+  h ^= h >> 33;
+  memset( id, 0, sizeof(*id) );
+  memcpy( id->octet, &h, sizeof(h) );
+}
+
+#define NUM_COLLIDE 257
+
+CTEST(tube_table, collide)
+{
+  static char   fake[NUM_COLLIDE];
+  tube_table*   tbl;
+  spud_tube_id  id;
+  struct _tube* old;
+  ls_err        err;
+  size_t        home;
+  unsigned int  i;
+
+  ASSERT_TRUE( tube_table_create(300, &tbl, &err) );
+  ASSERT_EQUAL(tbl->mask, 511);
+  tbl->seed = 0;
+
+  /* a full-length run from slot 0, then two from the last slot; the */
+  /* second of those pushes a slot-0 entry too far, which has to grow */
+  /* the table without losing it */
+  for (i = 0; i < NUM_COLLIDE; i++)
+  {
+    home = (i < NUM_COLLIDE - 2) ? 0 : 511;
+    _home_id( ( (uint64_t)(i + 1) << 20 ) | home, &id );
+    ASSERT_TRUE( tube_table_put(tbl, &id, (struct _tube*)&fake[i], &old,
+                                &err) );
+    ASSERT_NULL(old);
+  }
+  ASSERT_EQUAL(tube_table_count(tbl), NUM_COLLIDE);
+  ASSERT_TRUE(tbl->mask > 511);
+  for (i = 0; i < NUM_COLLIDE; i++)
+  {
+    home = (i < NUM_COLLIDE - 2) ? 0 : 511;
+    _home_id( ( (uint64_t)(i + 1) << 20 ) | home, &id );
+    ASSERT_TRUE(tube_table_get(tbl, &id) == (struct _tube*)&fake[i]);
+  }
+  tube_table_destroy(tbl);
+}